@@ -0,0 +1,602 @@
+#include "TransferScheduler.h"
+#include "LZ4Block.h"
+#include "SHA256.h"
+
+using namespace std;
+
+namespace {
+	ofBuffer packBits(const std::vector<bool> &bits) {
+		ofBuffer ret;
+		ret.allocate((bits.size()+7)/8);
+		std::fill(ret.begin(), ret.end(), 0);
+		for(std::size_t i = 0; i < bits.size(); ++i) {
+			if(bits[i]) {
+				ret.getData()[i/8] |= 1<<(i%8);
+			}
+		}
+		return ret;
+	}
+	std::vector<bool> unpackBits(const ofBuffer &buffer, std::size_t size) {
+		std::vector<bool> ret(size, false);
+		for(std::size_t i = 0; i < size && i/8 < buffer.size(); ++i) {
+			ret[i] = (buffer.getData()[i/8] & (1<<(i%8))) != 0;
+		}
+		return ret;
+	}
+}
+
+int TransferScheduler::Source::getWindow(uint64_t chunk_size) const
+{
+	// keep about 100ms worth of data in flight for each peer
+	return ofClamp(rate*0.1f/chunk_size, 1, 8);
+}
+
+TransferScheduler::RecvFile::RecvFile(std::string name, uint64_t size, uint64_t chunk_size)
+:name(name)
+,received_size(0)
+,chunk_size(chunk_size)
+{
+	buffer.allocate(size);
+	std::size_t num = (size+chunk_size-1)/chunk_size;
+	chunks.resize(num, MISSING);
+	requested_at.resize(num, 0);
+	requested_from.resize(num);
+	piece_size.resize(num, 0);
+	pieces.resize(num);
+}
+
+void TransferScheduler::RecvFile::resetPieces(std::size_t index, uint64_t size)
+{
+	piece_size[index] = size;
+	pieces[index].assign((getChunkLength(index)+size-1)/size, false);
+}
+
+TransferScheduler::~TransferScheduler()
+{
+	if(node_) {
+		ofRemoveListener(ofEvents().update, this, &TransferScheduler::update);
+		ofRemoveListener(node_->unhandledMessageReceived, this, &TransferScheduler::messageReceived);
+	}
+}
+
+void TransferScheduler::setup(ofxSearchNetworkNode &node, uint64_t chunk_size)
+{
+	if(node_) {
+		ofRemoveListener(ofEvents().update, this, &TransferScheduler::update);
+		ofRemoveListener(node_->unhandledMessageReceived, this, &TransferScheduler::messageReceived);
+	}
+	node_ = &node;
+	chunk_size_ = chunk_size;
+	ofAddListener(ofEvents().update, this, &TransferScheduler::update);
+	ofAddListener(node_->unhandledMessageReceived, this, &TransferScheduler::messageReceived);
+}
+
+void TransferScheduler::start(uint32_t identifier, int priority)
+{
+	auto it = files_.find(identifier);
+	if(it == end(files_) || it->second.isReceiving() || it->second.isCompleted()) {
+		return;
+	}
+	auto &file = it->second;
+	file.state = RecvFile::QUEUED;
+	file.priority = priority;
+	file.started_at = ofGetElapsedTimef();
+	queued_at_[identifier] = queue_order_++;
+	updateQueueState();
+}
+
+void TransferScheduler::cancel(uint32_t identifier)
+{
+	auto it = files_.find(identifier);
+	if(it == end(files_) || !it->second.isReceiving()) {
+		return;
+	}
+	auto &file = it->second;
+	file.state = RecvFile::IDLE;
+	if(file.is_pushed) {
+		// otherwise the pusher keeps repairing the file for us
+		sendAborted(file.pushed_from, identifier);
+		file.is_pushed = false;
+		file.pushed_from.clear();
+	}
+	for(std::size_t i = 0; i < file.chunks.size(); ++i) {
+		if(file.chunks[i] == RecvFile::REQUESTED) {
+			file.chunks[i] = RecvFile::MISSING;
+		}
+	}
+	for(auto &source : file.sources) {
+		source.second.inflight = 0;
+	}
+	updateQueueState();
+}
+
+void TransferScheduler::setPriority(uint32_t identifier, int priority)
+{
+	auto it = files_.find(identifier);
+	if(it != end(files_)) {
+		it->second.priority = priority;
+	}
+}
+
+const TransferScheduler::RecvFile* TransferScheduler::getFile(uint32_t identifier) const
+{
+	auto it = files_.find(identifier);
+	return it != end(files_) ? &it->second : nullptr;
+}
+
+uint64_t TransferScheduler::getPieceSize(const std::string &ip) const
+{
+	return max<uint64_t>(node_->getMaxDatagramSize(ip), DATA_MESSAGE_OVERHEAD*2)-DATA_MESSAGE_OVERHEAD;
+}
+
+std::string TransferScheduler::makeDigest(const ofBuffer &buffer)
+{
+	return SHA256::digest(buffer.getData(), buffer.size());
+}
+
+uint32_t TransferScheduler::makeIdentifier(const std::string &digest)
+{
+	uint32_t ret = 0;
+	memcpy(&ret, digest.data(), min(sizeof(ret), digest.size()));
+	return ret;
+}
+
+vector<uint32_t> TransferScheduler::getScheduleOrder() const
+{
+	// higher priority first, then smaller files, then first come first served
+	vector<uint32_t> ret;
+	for(auto &f : files_) {
+		if(f.second.isReceiving() && !f.second.is_pushed) {
+			ret.push_back(f.first);
+		}
+	}
+	sort(begin(ret), end(ret), [this](uint32_t a, uint32_t b) {
+		const RecvFile &fa = files_.at(a), &fb = files_.at(b);
+		if(fa.priority != fb.priority) {
+			return fa.priority > fb.priority;
+		}
+		if(fa.buffer.size() != fb.buffer.size()) {
+			return fa.buffer.size() < fb.buffer.size();
+		}
+		return queued_at_.at(a) < queued_at_.at(b);
+	});
+	return ret;
+}
+
+bool TransferScheduler::consumeTokens(const std::string &ip, uint64_t size)
+{
+	bool peer_limited = limits_.max_bytes_per_sec_per_peer > 0;
+	bool total_limited = limits_.max_bytes_per_sec > 0;
+	if((peer_limited && peer_tokens_[ip] <= 0) || (total_limited && total_tokens_ <= 0)) {
+		return false;
+	}
+	if(peer_limited) {
+		peer_tokens_[ip] -= size;
+	}
+	if(total_limited) {
+		total_tokens_ -= size;
+	}
+	return true;
+}
+
+void TransferScheduler::update(ofEventArgs&)
+{
+	float now = ofGetElapsedTimef();
+	float frame_time = ofGetLastFrameTime();
+	// refill at most half a second worth of burst
+	if(limits_.max_bytes_per_sec_per_peer > 0) {
+		for(auto &node : node_->getNodes()) {
+			float &tokens = peer_tokens_[node.first];
+			tokens = min(tokens+limits_.max_bytes_per_sec_per_peer*frame_time, limits_.max_bytes_per_sec_per_peer*0.5f);
+		}
+	}
+	if(limits_.max_bytes_per_sec > 0) {
+		total_tokens_ = min(total_tokens_+limits_.max_bytes_per_sec*frame_time, limits_.max_bytes_per_sec*0.5f);
+	}
+
+	map<string, int> peer_inflight;
+	for(auto &f : files_) {
+		auto &file = f.second;
+		if(!file.isReceiving() || file.isCompleted()) {
+			continue;
+		}
+		for(std::size_t i = 0; i < file.chunks.size(); ++i) {
+			if(file.chunks[i] == RecvFile::REQUESTED && now-file.requested_at[i] > request_timeout_) {
+				file.chunks[i] = RecvFile::MISSING;
+				auto source = file.sources.find(file.requested_from[i]);
+				if(source != end(file.sources)) {
+					source->second.inflight = max(0, source->second.inflight-1);
+					source->second.rate *= 0.5f;
+				}
+			}
+		}
+		for(auto &source : file.sources) {
+			peer_inflight[source.first] += source.second.inflight;
+		}
+	}
+
+	bool changed = false;
+	int active = 0;
+	for(auto identifier : getScheduleOrder()) {
+		auto &file = files_.at(identifier);
+		bool can_be_active = limits_.max_active_transfers <= 0 || active < limits_.max_active_transfers;
+		auto state = can_be_active ? RecvFile::ACTIVE : RecvFile::QUEUED;
+		if(file.state != state) {
+			file.state = state;
+			changed = true;
+		}
+		if(can_be_active) {
+			++active;
+			scheduleRequests(identifier, file, peer_inflight);
+		}
+	}
+	if(changed || queue_dirty_) {
+		updateQueueState();
+	}
+
+	if(swarm_mode_) {
+		have_timer_ += frame_time;
+		if(have_timer_ >= have_interval_) {
+			have_timer_ = 0;
+			for(auto &f : files_) {
+				if(f.second.isReceiving() && !f.second.isCompleted()) {
+					sendHave(f.first);
+				}
+			}
+		}
+	}
+}
+
+void TransferScheduler::scheduleRequests(uint32_t identifier, RecvFile &file, map<string, int> &peer_inflight)
+{
+	const auto &members = node_->getNodes();
+	vector<pair<const string*, Source*>> sources;
+	for(auto &s : file.sources) {
+		auto member = members.find(s.first);
+		if(member == end(members) || member->second.lost) {
+			continue;
+		}
+		sources.emplace_back(&s.first, &s.second);
+	}
+	if(sources.empty()) {
+		return;
+	}
+	// fastest peers pick first
+	sort(begin(sources), end(sources), [](const pair<const string*, Source*> &a, const pair<const string*, Source*> &b) {
+		return a.second->rate > b.second->rate;
+	});
+	if(!swarm_mode_) {
+		sources.resize(1);
+	}
+	// rarest chunks first
+	vector<int> availability(file.chunks.size(), 0);
+	for(auto &s : sources) {
+		for(std::size_t i = 0; i < availability.size(); ++i) {
+			if(s.second->hasChunk(i)) {
+				++availability[i];
+			}
+		}
+	}
+	float now = ofGetElapsedTimef();
+	for(auto &s : sources) {
+		const string &ip = *s.first;
+		Source &source = *s.second;
+		int &inflight = peer_inflight[ip];
+		while(source.inflight < source.getWindow(file.chunk_size)
+			  && (limits_.max_requests_per_peer <= 0 || inflight < limits_.max_requests_per_peer)) {
+			std::size_t pick = file.chunks.size();
+			for(std::size_t i = 0; i < file.chunks.size(); ++i) {
+				if(file.chunks[i] != RecvFile::MISSING || !source.hasChunk(i)) {
+					continue;
+				}
+				if(pick == file.chunks.size() || availability[i] < availability[pick]) {
+					pick = i;
+				}
+			}
+			if(pick == file.chunks.size() || !consumeTokens(ip, file.getChunkLength(pick))) {
+				break;
+			}
+			file.chunks[pick] = RecvFile::REQUESTED;
+			file.requested_at[pick] = now;
+			file.requested_from[pick] = ip;
+			// pieces received before a timeout are kept, unless they don't fit in a datagram to this peer
+			uint64_t piece_size = getPieceSize(ip);
+			if(file.piece_size[pick] == 0 || file.piece_size[pick] > piece_size) {
+				file.resetPieces(pick, piece_size);
+			}
+			++source.inflight;
+			++inflight;
+			requestMissingPieces(ip, identifier, file, pick);
+		}
+	}
+}
+
+void TransferScheduler::chunkCompleted(const std::string &ip, uint32_t identifier, RecvFile &file, std::size_t index)
+{
+	auto source = file.sources.find(ip);
+	if(source != end(file.sources) && file.chunks[index] == RecvFile::REQUESTED && file.requested_from[index] == ip) {
+		source->second.inflight = max(0, source->second.inflight-1);
+		float elapsed = max(0.001f, ofGetElapsedTimef()-file.requested_at[index]);
+		float rate = file.getChunkLength(index)/elapsed;
+		source->second.rate = source->second.rate == 0 ? rate : ofLerp(source->second.rate, rate, 0.2f);
+	}
+	file.chunks[index] = RecvFile::DONE;
+	file.received_size += file.getChunkLength(index);
+	queue_dirty_ = true;
+	if(!file.isCompleted()) {
+		return;
+	}
+	if(!file.digest.empty() && makeDigest(file.buffer) != file.digest) {
+		// some piece was wrong. all chunks are fetched again, keeping their piece sizes
+		ofLogWarning("TransferScheduler") << file.name << " doesn't match its digest, receiving again";
+		for(std::size_t i = 0; i < file.chunks.size(); ++i) {
+			file.chunks[i] = RecvFile::MISSING;
+			file.pieces[i].assign(file.pieces[i].size(), false);
+		}
+		file.received_size = 0;
+		return;
+	}
+	file.state = RecvFile::COMPLETED;
+	for(auto &source : file.sources) {
+		if(source.second.have.empty()) {
+			sendCompleted(source.first, identifier);
+		}
+	}
+	updateQueueState();
+	FileEvent event{ip, identifier};
+	ofNotifyEvent(fileCompleted, event, this);
+}
+
+void TransferScheduler::updateQueueState()
+{
+	QueueState state;
+	for(auto &f : files_) {
+		auto &file = f.second;
+		switch(file.state) {
+			case RecvFile::QUEUED: ++state.queued; break;
+			case RecvFile::ACTIVE: ++state.active; break;
+			case RecvFile::COMPLETED: ++state.completed; break;
+			default: continue;
+		}
+		state.bytes_received += file.received_size;
+		state.bytes_total += file.buffer.size();
+	}
+	queue_state_ = state;
+	queue_dirty_ = false;
+	ofNotifyEvent(queueChanged, queue_state_, this);
+}
+
+void TransferScheduler::sendRequest(const std::string &ip, uint32_t identifier, uint64_t position, uint64_t size, int codec, uint64_t piece_size)
+{
+	ofxOscMessage msg;
+	msg.setAddress("/file/request");
+	msg.addInt32Arg(identifier);
+	msg.addInt64Arg(position);
+	msg.addInt64Arg(size);
+	msg.addInt32Arg(codec);
+	msg.addInt64Arg(piece_size);
+	node_->sendMessage(ip, msg);
+}
+
+void TransferScheduler::requestMissingPieces(const std::string &ip, uint32_t identifier, const RecvFile &file, std::size_t index)
+{
+	// a request for each run of missing pieces
+	const auto &pieces = file.pieces[index];
+	uint64_t piece_size = file.piece_size[index];
+	uint64_t chunk_position = index*file.chunk_size;
+	for(std::size_t i = 0; i < pieces.size();) {
+		if(pieces[i]) {
+			++i;
+			continue;
+		}
+		std::size_t first = i;
+		while(i < pieces.size() && !pieces[i]) {
+			++i;
+		}
+		uint64_t offset = first*piece_size;
+		uint64_t size = min<uint64_t>(i*piece_size, file.getChunkLength(index))-offset;
+		sendRequest(ip, identifier, chunk_position+offset, size, file.codec, piece_size);
+	}
+}
+
+void TransferScheduler::sendCompleted(const std::string &ip, uint32_t identifier)
+{
+	ofxOscMessage msg;
+	msg.setAddress("/file/completed");
+	msg.addInt32Arg(identifier);
+	node_->sendReliable(ip, msg);
+}
+
+void TransferScheduler::sendAborted(const std::string &ip, uint32_t identifier)
+{
+	ofxOscMessage msg;
+	msg.setAddress("/file/aborted");
+	msg.addInt32Arg(identifier);
+	node_->sendReliable(ip, msg);
+}
+
+void TransferScheduler::sendHave(uint32_t identifier)
+{
+	auto it = files_.find(identifier);
+	if(it == end(files_)) { return; }
+	auto &file = it->second;
+	std::vector<bool> have(file.chunks.size());
+	for(std::size_t i = 0; i < have.size(); ++i) {
+		have[i] = file.chunks[i] == RecvFile::DONE;
+	}
+	ofxOscMessage msg;
+	msg.setAddress("/file/have");
+	msg.addInt32Arg(identifier);
+	msg.addInt64Arg(file.chunk_size);
+	msg.addBlobArg(packBits(have));
+	node_->sendMessage(msg);
+}
+
+void TransferScheduler::sendNack(const std::string &ip, uint32_t identifier)
+{
+	auto it = files_.find(identifier);
+	if(it == end(files_)) { return; }
+	auto &file = it->second;
+	ofxOscMessage msg;
+	msg.setAddress("/file/nack");
+	msg.addInt32Arg(identifier);
+	// missing chunks as (first, count) ranges, as many as fit in a datagram.
+	// the rest is reported after the next round of repairs
+	// two int64 and at most 4 more bytes of padded type tags
+	const std::size_t range_size = 2*8+4;
+	std::size_t max_size = node_->getMaxDatagramSize(ip);
+	for(std::size_t i = 0; i < file.chunks.size() && ofxSearchNetworkNode::getMessageSize(msg)+range_size <= max_size;) {
+		if(file.chunks[i] == RecvFile::DONE) {
+			++i;
+			continue;
+		}
+		std::size_t first = i;
+		while(i < file.chunks.size() && file.chunks[i] != RecvFile::DONE) {
+			++i;
+		}
+		msg.addInt64Arg(first);
+		msg.addInt64Arg(i-first);
+	}
+	node_->sendMessage(ip, msg);
+}
+
+void TransferScheduler::messageReceived(ofxOscMessage &msg)
+{
+	const std::string &address = msg.getAddress();
+	if(address == "/file/info" || address == "/file/push") {
+		const std::string &ip = msg.getRemoteHost();
+		bool is_push = address == "/file/push";
+		if(msg.getNumArgs() < 3 || msg.getArgType(0) != OFXOSC_TYPE_INT32 || msg.getArgType(1) != OFXOSC_TYPE_INT64 || msg.getArgType(2) != OFXOSC_TYPE_STRING
+		   || (msg.getNumArgs() > 3 && msg.getArgType(3) != OFXOSC_TYPE_INT64)
+		   || (msg.getNumArgs() > 4 && msg.getArgType(4) != OFXOSC_TYPE_INT32)
+		   || (is_push && msg.getNumArgs() > 5 && msg.getArgType(5) != OFXOSC_TYPE_INT64)) {
+			ofLogWarning("TransferScheduler") << "received broken packet from " << ip;
+			return;
+		}
+		auto identifier = msg.getArgAsInt32(0);
+		uint64_t size = msg.getArgAsInt64(1);
+		uint64_t chunk_size = msg.getNumArgs() > 3 ? msg.getArgAsInt64(3) : chunk_size_;
+		if(chunk_size == 0) {
+			ofLogWarning("TransferScheduler") << "received broken packet from " << ip;
+			return;
+		}
+		if(limits_.max_file_size > 0 && size > limits_.max_file_size) {
+			ofLogWarning("TransferScheduler") << msg.getArgAsString(2) << " offered from " << ip << " is too large (" << size << " bytes)";
+			return;
+		}
+		RecvFile file(msg.getArgAsString(2), size, min<uint64_t>(chunk_size, chunk_size_));
+		int offered_codec = msg.getNumArgs() > 4 ? msg.getArgAsInt32(4) : CODEC_NONE;
+		file.codec = compression_ ? (offered_codec & CODEC_LZ4) : CODEC_NONE;
+		std::size_t digest_index = is_push ? 6 : 5;
+		if(msg.getNumArgs() > digest_index && msg.getArgType(digest_index) == OFXOSC_TYPE_BLOB) {
+			const ofBuffer &digest = msg.getArgAsBlob(digest_index);
+			file.digest.assign(digest.getData(), digest.size());
+			if(file.digest.size() != SHA256::DIGEST_SIZE || makeIdentifier(file.digest) != (uint32_t)identifier) {
+				return;
+			}
+		}
+		auto found = files_.find(identifier);
+		if(found != end(files_) && !file.digest.empty() && !found->second.digest.empty() && found->second.digest != file.digest) {
+			ofLogWarning("TransferScheduler") << "another file with the same identifier offered from " << ip;
+			return;
+		}
+		auto result = files_.insert(std::make_pair(identifier, file));
+		if(!result.second && result.first->second.state == RecvFile::IDLE) {
+			auto sources = std::move(result.first->second.sources);
+			result.first->second = file;
+			result.first->second.sources = std::move(sources);
+		}
+		auto &recv = result.first->second;
+		recv.sources[ip].have.clear();
+		if(is_push && !recv.isCompleted()) {
+			uint64_t piece_size = msg.getNumArgs() > 5 ? msg.getArgAsInt64(5) : recv.chunk_size;
+			for(std::size_t i = 0; i < recv.chunks.size(); ++i) {
+				if(recv.chunks[i] != RecvFile::DONE) {
+					recv.resetPieces(i, max<uint64_t>(piece_size, 1));
+				}
+			}
+			recv.state = RecvFile::ACTIVE;
+			recv.is_pushed = true;
+			recv.pushed_from = ip;
+			recv.started_at = ofGetElapsedTimef();
+			updateQueueState();
+		}
+		FileEvent event{ip, (uint32_t)identifier};
+		ofNotifyEvent(fileOffered, event, this);
+	}
+	else if(address == "/file/push/end") {
+		std::string ip = msg.getRemoteHost();
+		uint32_t identifier = msg.getArgAsInt32(0);
+		auto it = files_.find(identifier);
+		if(it == end(files_)) { return; }
+		if(it->second.isCompleted()) {
+			sendCompleted(ip, identifier);
+		}
+		else if(it->second.isReceiving()) {
+			sendNack(ip, identifier);
+		}
+	}
+	else if(address == "/file/have") {
+		std::string ip = msg.getRemoteHost();
+		if(!swarm_mode_ || node_->isSelfIp(ip)) { return; }
+		uint32_t identifier = msg.getArgAsInt32(0);
+		auto it = files_.find(identifier);
+		if(it == end(files_)) { return; }
+		auto &file = it->second;
+		if(file.chunk_size != msg.getArgAsInt64(1)) { return; }
+		auto source = file.sources.find(ip);
+		if(source != end(file.sources) && source->second.have.empty()) {
+			// peers offering the whole file keep their full availability
+			return;
+		}
+		file.sources[ip].have = unpackBits(msg.getArgAsBlob(2), file.chunks.size());
+	}
+	else if(address == "/file/aborted") {
+		std::string ip = msg.getRemoteIp();
+		uint32_t identifier = msg.getArgAsInt32(0);
+		auto it = files_.find(identifier);
+		if(it == end(files_)) { return; }
+		it->second.sources.erase(ip);
+		if(it->second.sources.empty() && !it->second.isCompleted()) {
+			files_.erase(it);
+			updateQueueState();
+		}
+		FileEvent event{ip, identifier};
+		ofNotifyEvent(fileAborted, event, this);
+	}
+	else if(address == "/file/data") {
+		std::string ip = msg.getRemoteHost();
+		uint32_t identifier = msg.getArgAsInt32(0);
+		uint64_t position = msg.getArgAsInt64(1);
+		ofBuffer data = msg.getArgAsBlob(2);
+		int codec = msg.getNumArgs() > 4 ? msg.getArgAsInt32(3) : CODEC_NONE;
+		auto it = files_.find(identifier);
+		if(it == end(files_)) { return; }
+		auto &info = it->second;
+		if(!info.isReceiving()) { return; }
+		std::size_t index = position/info.chunk_size;
+		if(index >= info.chunks.size() || info.chunks[index] == RecvFile::DONE) { return; }
+		uint64_t offset = position-index*info.chunk_size;
+		uint64_t piece_size = info.piece_size[index];
+		if(piece_size == 0 || offset%piece_size != 0) { return; }
+		std::size_t piece = offset/piece_size;
+		if(piece >= info.pieces[index].size() || info.pieces[index][piece]) { return; }
+		auto size = min(piece_size, info.getChunkLength(index)-offset);
+		if(codec == CODEC_LZ4) {
+			if(msg.getArgAsInt64(4) != size || LZ4Block::decompress(data.getData(), data.size(), info.buffer.getData()+position, size) != size) {
+				return;
+			}
+		}
+		else if(data.size() == size) {
+			memcpy(info.buffer.getData()+position, data.getData(), size);
+		}
+		else {
+			return;
+		}
+		auto &pieces = info.pieces[index];
+		pieces[piece] = true;
+		if(all_of(begin(pieces), end(pieces), [](bool b) { return b; })) {
+			chunkCompleted(ip, identifier, info, index);
+		}
+	}
+}
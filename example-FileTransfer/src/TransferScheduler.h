@@ -0,0 +1,148 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxSearchNetworkNode.h"
+
+// owns every incoming transfer across all peers.
+// requests are issued from the update event within global and per-peer limits,
+// and changes are reported through events.
+class TransferScheduler
+{
+public:
+	// codecs offered in /file/info and chosen per piece.
+	// every piece is compressed on its own so it can be re-sent or served by any peer.
+	enum Codec {
+		CODEC_NONE = 0,
+		CODEC_LZ4 = 1,
+	};
+	// a peer offering (a part of) a file.
+	// have is empty if the peer has the whole file.
+	struct Source {
+		std::vector<bool> have;
+		float rate=0;
+		int inflight=0;
+		bool hasChunk(std::size_t index) const {
+			return have.empty() || (index < have.size() && have[index]);
+		}
+		int getWindow(uint64_t chunk_size) const;
+	};
+	struct RecvFile {
+		enum State { IDLE, QUEUED, ACTIVE, COMPLETED };
+		enum ChunkState : uint8_t { MISSING, REQUESTED, DONE };
+		State state=IDLE;
+		bool is_pushed=false;
+		// told with /file/aborted when a pushed file is cancelled
+		std::string pushed_from;
+		int priority=0;
+		bool isCompleted() const {
+			return received_size == buffer.size();
+		}
+		bool isReceiving() const {
+			return state == QUEUED || state == ACTIVE;
+		}
+		std::string name;
+		// SHA-256 of the whole file, checked on completion. empty if the sender didn't send one
+		std::string digest;
+		ofBuffer buffer;
+		uint64_t received_size;
+		uint64_t chunk_size;
+		int codec=CODEC_NONE;
+		float started_at=0;
+		std::vector<ChunkState> chunks;
+		// a chunk arrives as datagram sized pieces
+		std::vector<uint64_t> piece_size;
+		std::vector<std::vector<bool>> pieces;
+		void resetPieces(std::size_t index, uint64_t size);
+		std::vector<float> requested_at;
+		std::vector<std::string> requested_from;
+		std::map<std::string, Source> sources;
+		RecvFile(std::string name, uint64_t size, uint64_t chunk_size);
+		uint64_t getChunkLength(std::size_t index) const {
+			return std::min<uint64_t>(chunk_size, buffer.size()-index*chunk_size);
+		}
+	};
+	// 0 means unlimited
+	struct Limits {
+		int max_active_transfers=4;
+		int max_requests_per_peer=8;
+		float max_bytes_per_sec_per_peer=0;
+		float max_bytes_per_sec=0;
+		// offers of larger files are ignored, as they are received in memory
+		uint64_t max_file_size=1024*1024*1024;
+	};
+	struct QueueState {
+		int queued=0;
+		int active=0;
+		int completed=0;
+		uint64_t bytes_received=0;
+		uint64_t bytes_total=0;
+	};
+	struct FileEvent {
+		std::string ip;
+		uint32_t identifier;
+	};
+
+	virtual ~TransferScheduler();
+	void setup(ofxSearchNetworkNode &node, uint64_t chunk_size);
+	void setLimits(const Limits &limits) { limits_ = limits; }
+	const Limits& getLimits() const { return limits_; }
+	void setSwarmMode(bool swarm) { swarm_mode_ = swarm; }
+	bool isSwarmMode() const { return swarm_mode_; }
+	void setCompression(bool compression) { compression_ = compression; }
+
+	void start(uint32_t identifier, int priority=0);
+	void cancel(uint32_t identifier);
+	void setPriority(uint32_t identifier, int priority);
+
+	const std::map<uint32_t, RecvFile>& getFiles() const { return files_; }
+	const RecvFile* getFile(uint32_t identifier) const;
+	const QueueState& getQueueState() const { return queue_state_; }
+	uint64_t getPieceSize(const std::string &ip) const;
+
+	// files are identified by the SHA-256 of their content.
+	// messages carry the first 4 bytes as the identifier and /file/info and /file/push the whole digest.
+	static std::string makeDigest(const ofBuffer &buffer);
+	static uint32_t makeIdentifier(const std::string &digest);
+
+	ofEvent<const FileEvent> fileOffered;
+	ofEvent<const FileEvent> fileAborted;
+	ofEvent<const FileEvent> fileCompleted;
+	ofEvent<const QueueState> queueChanged;
+
+	// room for the address, arguments and bundle header of /file/data
+	static const uint64_t DATA_MESSAGE_OVERHEAD=128;
+private:
+	ofxSearchNetworkNode *node_=nullptr;
+	uint64_t chunk_size_;
+	Limits limits_;
+	bool swarm_mode_=true;
+	bool compression_=true;
+	float have_interval_=1;
+	float have_timer_=0;
+	float request_timeout_=1;
+	std::map<uint32_t, RecvFile> files_;
+	uint32_t queue_order_=0;
+	std::map<uint32_t, uint32_t> queued_at_;
+
+	// token buckets in bytes, refilled every update
+	std::map<std::string, float> peer_tokens_;
+	float total_tokens_=0;
+	bool consumeTokens(const std::string &ip, uint64_t size);
+
+	QueueState queue_state_;
+	bool queue_dirty_=false;
+	void updateQueueState();
+
+	void update(ofEventArgs&);
+	void messageReceived(ofxOscMessage &msg);
+	std::vector<uint32_t> getScheduleOrder() const;
+	void scheduleRequests(uint32_t identifier, RecvFile &file, std::map<std::string, int> &peer_inflight);
+	void chunkCompleted(const std::string &ip, uint32_t identifier, RecvFile &file, std::size_t index);
+
+	void sendRequest(const std::string &ip, uint32_t identifier, uint64_t position, uint64_t size, int codec, uint64_t piece_size);
+	void requestMissingPieces(const std::string &ip, uint32_t identifier, const RecvFile &file, std::size_t index);
+	void sendCompleted(const std::string &ip, uint32_t identifier);
+	void sendAborted(const std::string &ip, uint32_t identifier);
+	void sendHave(uint32_t identifier);
+	void sendNack(const std::string &ip, uint32_t identifier);
+};
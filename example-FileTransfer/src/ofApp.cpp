@@ -1,23 +1,67 @@
 #include "ofApp.h"
+#include "LZ4Block.h"
 
 using namespace std;
 
 //--------------------------------------------------------------
 void ofApp::setup(){
 	ofAddListener(node_.unhandledMessageReceived, this, &ofApp::messageReceived);
+	ofAddListener(node_.nodeDisconnected, this, &ofApp::nodeGone);
+	ofAddListener(node_.nodeLost, this, &ofApp::nodeGone);
 	node_.setAllowLoopback(true);
 	node_.setup(9000);
 	node_.request();
 	
 	SEND_MAXSIZE = 
-	RECV_MAXSIZE = osc::UdpSocket::GetUdpBufferSize() - 128;
+	RECV_MAXSIZE = 64*1024;
+	
+	scheduler_.setup(node_, RECV_MAXSIZE);
+	ofAddListener(scheduler_.fileOffered, this, &ofApp::fileOffered);
+	ofAddListener(scheduler_.fileAborted, this, &ofApp::fileAborted);
+	ofAddListener(scheduler_.queueChanged, this, &ofApp::queueChanged);
 
 	gui_.setup();
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
+	for(auto it = begin(pushes_); it != end(pushes_);) {
+		if(it->second.receivers.empty()) {
+			uint32_t identifier = it->first;
+			auto file = send_files_.find(identifier);
+			if(file != end(send_files_)) {
+				file->second.close();
+			}
+			it = pushes_.erase(it);
+			releaseSendFile(identifier);
+			continue;
+		}
+		updatePush(it->first, it->second);
+		++it;
+	}
+}
 
+void ofApp::updatePush(uint32_t identifier, Push &push)
+{
+	int budget = push_chunks_per_frame_;
+	auto send_chunk = [&](std::size_t index) {
+		sendPieces(node_.getTargetIp(), identifier, index*RECV_MAXSIZE, RECV_MAXSIZE, compression_?TransferScheduler::CODEC_LZ4:TransferScheduler::CODEC_NONE, push.piece_size);
+		--budget;
+	};
+	while(budget > 0 && !push.repair.empty()) {
+		send_chunk(*begin(push.repair));
+		push.repair.erase(begin(push.repair));
+	}
+	while(budget > 0 && push.next_chunk < push.num_chunks) {
+		send_chunk(push.next_chunk++);
+	}
+	if(push.next_chunk == push.num_chunks && push.repair.empty()) {
+		push.end_timer += ofGetLastFrameTime();
+		if(push.end_timer >= push_end_interval_) {
+			push.end_timer = 0;
+			sendPushEnd(identifier);
+		}
+	}
 }
 
 //--------------------------------------------------------------
@@ -25,6 +69,37 @@ void ofApp::draw(){
 	gui_.begin();
 	
 	if(ImGui::Begin("Hosts")) {
+		if(ImGui::Checkbox("swarm mode", &swarm_mode_)) {
+			scheduler_.setSwarmMode(swarm_mode_);
+		}
+		if(ImGui::TreeNode("limits")) {
+			bool changed = false;
+			changed |= ImGui::InputInt("active transfers", &limits_.max_active_transfers);
+			changed |= ImGui::InputInt("requests per peer", &limits_.max_requests_per_peer);
+			changed |= ImGui::InputFloat("bytes/sec per peer", &limits_.max_bytes_per_sec_per_peer);
+			changed |= ImGui::InputFloat("bytes/sec", &limits_.max_bytes_per_sec);
+			if(changed) {
+				scheduler_.setLimits(limits_);
+			}
+			ImGui::TreePop();
+		}
+		ImGui::Text("%d active, %d queued, %d completed (%llu/%llu)", queue_state_.active, queue_state_.queued, queue_state_.completed, queue_state_.bytes_received, queue_state_.bytes_total);
+		ImGui::Checkbox("push dropped files to everyone", &push_to_all_);
+		if(ImGui::Checkbox("compression", &compression_)) {
+			scheduler_.setCompression(compression_);
+		}
+		if(ImGui::SliderFloat("simulated loss", &simulated_loss_, 0, 0.5f)) {
+			node_.setSimulatedPacketLoss(simulated_loss_);
+		}
+		for(auto &push : pushes_) {
+			ImGui::Text("pushing %u : %lu/%lu chunks, %lu receivers left", push.first, push.second.next_chunk, push.second.num_chunks, push.second.receivers.size());
+		}
+		if(push_to_all_ && ImGui::IsWindowHovered()) {
+			for(auto &path : drag_files_) {
+				pushFile(path);
+			}
+			drag_files_.clear();
+		}
 		const auto &members = node_.getNodes();
 		for(const auto &member : members) {
 			if(member.second.lost) {
@@ -39,34 +114,40 @@ void ofApp::draw(){
 			if(box_info.is_open) {
 				if(ImGui::Begin(name.c_str(), &box_info.is_open)) {
 					if(ImGui::CollapsingHeader("Received Files")) {
-						for(auto &info : box_info.recv_files) {
-							ImGui::PushID(&info);
-							ImGui::Text("%s", info.second.name.c_str()); ImGui::SameLine();
-							if(info.second.isCompleted()) {
-								if(!info.second.complete_msg_sent) {
-									sendCompleted(ip, info.first);
-									info.second.complete_msg_sent = true;
-								}
+						for(auto identifier : box_info.recv_files) {
+							auto *info = scheduler_.getFile(identifier);
+							if(!info) {
+								continue;
+							}
+							ImGui::PushID(identifier);
+							ImGui::Text("%s", info->name.c_str()); ImGui::SameLine();
+							if(info->isCompleted()) {
 								if(ImGui::Button("save")) {
-									auto result = ofSystemSaveDialog(info.second.name, "");
+									auto result = ofSystemSaveDialog(info->name, "");
 									if(result.bSuccess) {
-										ofBufferToFile(result.getPath(), info.second.buffer);
+										ofBufferToFile(result.getPath(), info->buffer);
 									}
 								}
 							}
-							else if(info.second.is_receiving) {
+							else if(info->isReceiving()) {
 								if(ImGui::Button("cancel")) {
-									info.second.is_receiving = false;
+									scheduler_.cancel(identifier);
 								}
 								else {
-									ImGui::Text("%llu/%ld", info.second.received_size, info.second.buffer.size());
-									sendRequest(ip, info.first, info.second.received_size);
+									int priority = info->priority;
+									ImGui::SameLine();
+									ImGui::PushItemWidth(80);
+									if(ImGui::InputInt("priority", &priority)) {
+										scheduler_.setPriority(identifier, priority);
+									}
+									ImGui::PopItemWidth();
+									float elapsed = max(0.001f, ofGetElapsedTimef()-info->started_at);
+									ImGui::Text("%s %llu/%ld from %lu peers (%.1f KB/s)", info->state == TransferScheduler::RecvFile::QUEUED ? "queued" : "active", info->received_size, info->buffer.size(), info->sources.size(), info->received_size/elapsed/1024);
 								}
 							}
 							else {
 								if(ImGui::Button("download")) {
-									info.second.is_receiving = true;
-									info.second.complete_msg_sent = false;
+									scheduler_.start(identifier);
 								}
 							}
 							ImGui::PopID();
@@ -75,17 +156,30 @@ void ofApp::draw(){
 					if(ImGui::CollapsingHeader("Send Files")) {
 						for(auto it = std::begin(box_info.send_files); it != std::end(box_info.send_files);) {
 							bool rem = false;
-							auto &info = it->second;
+							auto identifier = *it;
+							auto file = send_files_.find(identifier);
+							if(file == end(send_files_)) {
+								it = box_info.send_files.erase(it);
+								continue;
+							}
+							auto &info = file->second;
+							ImGui::PushID(identifier);
 							if(ImGui::Button("resend")) {
 								notifyFileIsReady(ip, info.path);
 							} ImGui::SameLine();
 							if(ImGui::Button("abort")) {
 								rem = true;
-								sendAborted(ip, it->first);
+								sendAborted(ip, identifier);
+								auto push = pushes_.find(identifier);
+								if(push != end(pushes_)) {
+									push->second.receivers.erase(ip);
+								}
 							} ImGui::SameLine();
 							ImGui::Text("%s(%s)", ofFilePath::getFileName(info.path).c_str(), info.path.c_str());
+							ImGui::PopID();
 							if(rem) {
 								it = box_info.send_files.erase(it);
+								releaseSendFile(identifier);
 							}
 							else {
 								++it;
@@ -112,60 +206,153 @@ void ofApp::draw(){
 }
 
 
-namespace {
-	uint32_t crc_table[256];
-	bool crc_table_created=false;
-	void createCRC32Table() {
-		for (uint32_t i = 0; i < 256; i++) {
-			uint32_t c = i;
-			for (int j = 0; j < 8; j++) {
-				c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
-			}
-			crc_table[i] = c;
-		}
-		crc_table_created = true;
-	};
-	uint32_t crc32(const char *buf, size_t len) {
-		if(!crc_table_created) { createCRC32Table(); }
-		uint32_t c = 0xFFFFFFFF;
-		for (size_t i = 0; i < len; i++) {
-			c = crc_table[(c ^ buf[i]) & 0xFF] ^ (c >> 8);
-		}
-		return c ^ 0xFFFFFFFF;
-	};
-	uint32_t crc32(const std::string &str) {
-		return crc32(str.c_str(), str.length());
-	}
-}
-
 void ofApp::notifyFileIsReady(const std::string &ip, const std::string &filepath)
 {
-	SendFile info(ip, filepath);
 	ofFile file(filepath);
 	if(!file.exists()) {
 		return;
 	}
 	auto it = boxes_.find(ip);
 	if(it == end(boxes_)) { return; }
-	auto &send_files = it->second.send_files;
-	uint32_t hash = crc32(ip+filepath);
-	send_files.insert(std::make_pair(hash, info));
+	// content addressed, so peers offering the same file advertise the same identifier
+	std::string digest = TransferScheduler::makeDigest(ofBufferFromFile(filepath, true));
+	uint32_t hash = TransferScheduler::makeIdentifier(digest);
+	send_files_.insert(std::make_pair(hash, SendFile(filepath)));
+	it->second.send_files.insert(hash);
 	ofxOscMessage msg;
 	msg.setAddress("/file/info");
 	msg.addInt32Arg(hash);
 	msg.addInt64Arg(file.getSize());
 	msg.addStringArg(ofFilePath::getFileName(filepath));
-	node_.sendMessage(ip, msg);
+	msg.addInt64Arg(RECV_MAXSIZE);
+	msg.addInt32Arg(TransferScheduler::CODEC_LZ4);
+	msg.addBlobArg(ofBuffer(digest.data(), digest.size()));
+	node_.sendReliable(ip, msg);
+}
+
+void ofApp::pushFile(const std::string &filepath)
+{
+	ofFile file(filepath);
+	if(!file.exists()) {
+		return;
+	}
+	std::string digest = TransferScheduler::makeDigest(ofBufferFromFile(filepath, true));
+	uint32_t hash = TransferScheduler::makeIdentifier(digest);
+	send_files_.insert(std::make_pair(hash, SendFile(filepath)));
+	Push push;
+	push.size = file.getSize();
+	push.num_chunks = (push.size+RECV_MAXSIZE-1)/RECV_MAXSIZE;
+	push.piece_size = RECV_MAXSIZE;
+	for(auto &node : node_.getNodes()) {
+		if(node.second.lost || node_.isSelfIp(node.first)) {
+			continue;
+		}
+		push.receivers.insert(node.first);
+		push.piece_size = min(push.piece_size, scheduler_.getPieceSize(node.first));
+	}
+	ofxOscMessage msg;
+	msg.setAddress("/file/push");
+	msg.addInt32Arg(hash);
+	msg.addInt64Arg(push.size);
+	msg.addStringArg(ofFilePath::getFileName(filepath));
+	msg.addInt64Arg(RECV_MAXSIZE);
+	msg.addInt32Arg(TransferScheduler::CODEC_LZ4);
+	msg.addInt64Arg(push.piece_size);
+	msg.addBlobArg(ofBuffer(digest.data(), digest.size()));
+	for(auto &ip : push.receivers) {
+		boxes_[ip].send_files.insert(hash);
+		node_.sendReliable(ip, msg);
+	}
+	pushes_[hash] = push;
+}
+
+void ofApp::sendPushEnd(unsigned int identifier)
+{
+	auto it = pushes_.find(identifier);
+	if(it == end(pushes_)) { return; }
+	ofxOscMessage msg;
+	msg.setAddress("/file/push/end");
+	msg.addInt32Arg(identifier);
+	// repeated every push_end_interval_ until all receivers complete, so a lost one costs nothing
+	for(auto &ip : it->second.receivers) {
+		node_.sendMessage(ip, msg);
+	}
+}
+
+ofBuffer ofApp::readChunk(unsigned int identifier, uint64_t position, uint64_t maxsize)
+{
+	ofBuffer buffer;
+	auto it = send_files_.find(identifier);
+	if(it != end(send_files_)) {
+		auto &info = it->second;
+		if(!info.isOpen()) {
+			info.open();
+		}
+		if(position >= info.file.getSize()) { return buffer; }
+		uint64_t size = min<uint64_t>(maxsize, info.file.getSize()-position);
+		info.file.seekg(position, ios_base::beg);
+		buffer.allocate(size);
+		info.file.read(buffer.getData(), buffer.size());
+	}
+	else if(swarm_mode_) {
+		// serve chunks of a file we are still receiving
+		auto *file = scheduler_.getFile(identifier);
+		if(!file) { return buffer; }
+		std::size_t index = position/file->chunk_size;
+		if(index >= file->chunks.size() || file->chunks[index] != TransferScheduler::RecvFile::DONE) { return buffer; }
+		uint64_t size = min<uint64_t>(maxsize, file->chunk_size*(index+1)-position);
+		size = min<uint64_t>(size, file->buffer.size()-position);
+		buffer.set(file->buffer.getData()+position, size);
+	}
+	return buffer;
 }
 
-void ofApp::sendRequest(const std::string &ip, unsigned int identifier, uint64_t position)
+ofxOscMessage ofApp::createDataMessage(unsigned int identifier, uint64_t position, const ofBuffer &data, int codec)
 {
 	ofxOscMessage msg;
-	msg.setAddress("/file/request");
+	msg.setAddress("/file/data");
 	msg.addInt32Arg(identifier);
 	msg.addInt64Arg(position);
-	msg.addInt64Arg(RECV_MAXSIZE);
-	node_.sendMessage(ip, msg);
+	if((codec & TransferScheduler::CODEC_LZ4) != 0) {
+		// sample a few chunks and keep compressing only while it pays off.
+		// once disabled, every 64th chunk is sampled again.
+		auto &stats = compression_stats_[identifier];
+		if(stats.enabled || ++stats.skipped % 64 == 0) {
+			ofBuffer packed;
+			packed.allocate(LZ4Block::compressBound(data.size()));
+			std::size_t size = LZ4Block::compress(data.getData(), data.size(), packed.getData(), packed.size());
+			stats.raw += data.size();
+			stats.packed += size != 0 ? size : data.size();
+			if(++stats.samples >= 4) {
+				stats.enabled = stats.packed < stats.raw*0.9;
+				stats.raw = stats.packed = 0;
+				stats.samples = 0;
+			}
+			if(size != 0 && size < data.size()) {
+				packed.resize(size);
+				msg.addBlobArg(packed);
+				msg.addInt32Arg(TransferScheduler::CODEC_LZ4);
+				msg.addInt64Arg(data.size());
+				return msg;
+			}
+		}
+	}
+	msg.addBlobArg(data);
+	return msg;
+}
+
+void ofApp::sendPieces(const std::vector<std::string> &ip, unsigned int identifier, uint64_t position, uint64_t size, int codec, uint64_t piece_size)
+{
+	for(uint64_t offset = 0; offset < size; offset += piece_size) {
+		ofBuffer buffer = readChunk(identifier, position+offset, min(piece_size, size-offset));
+		if(buffer.size() == 0) {
+			return;
+		}
+		ofxOscMessage msg = createDataMessage(identifier, position+offset, buffer, codec);
+		for(auto &i : ip) {
+			node_.sendMessage(i, msg);
+		}
+	}
 }
 
 void ofApp::sendAborted(const std::string &ip, unsigned int identifier)
@@ -173,96 +360,91 @@ void ofApp::sendAborted(const std::string &ip, unsigned int identifier)
 	ofxOscMessage msg;
 	msg.setAddress("/file/aborted");
 	msg.addInt32Arg(identifier);
-	node_.sendMessage(ip, msg);
+	node_.sendReliable(ip, msg);
 }
-void ofApp::sendCompleted(const std::string &ip, unsigned int identifier)
+void ofApp::releaseSendFile(unsigned int identifier)
 {
-	ofxOscMessage msg;
-	msg.setAddress("/file/completed");
-	msg.addInt32Arg(identifier);
-	node_.sendMessage(ip, msg);
+	// /file/request is served from send_files_, so an aborted file must not stay there
+	if(pushes_.count(identifier) > 0) {
+		return;
+	}
+	for(auto &box : boxes_) {
+		if(box.second.send_files.count(identifier) > 0) {
+			return;
+		}
+	}
+	send_files_.erase(identifier);
+	compression_stats_.erase(identifier);
+}
+void ofApp::fileOffered(const TransferScheduler::FileEvent &event)
+{
+	boxes_[event.ip].recv_files.insert(event.identifier);
+}
+
+void ofApp::fileAborted(const TransferScheduler::FileEvent &event)
+{
+	auto it = boxes_.find(event.ip);
+	if(it == end(boxes_)) { return; }
+	it->second.recv_files.erase(event.identifier);
+}
+
+void ofApp::queueChanged(const TransferScheduler::QueueState &state)
+{
+	queue_state_ = state;
+}
+
+void ofApp::nodeGone(const std::pair<std::string, ofxSearchNetworkNode::Node> &node)
+{
+	// pushes with no receivers left are closed in update
+	for(auto &push : pushes_) {
+		push.second.receivers.erase(node.first);
+	}
 }
 
 void ofApp::messageReceived(ofxOscMessage &msg)
 {
 	const std::string &address = msg.getAddress();
-	if(address == "/file/info") {
-		const std::string &ip = msg.getRemoteHost();
-		auto &box = boxes_[ip];
-		RecvFile file(msg.getArgAsString(2), msg.getArgAsInt64(1));
-		auto identifier = msg.getArgAsInt32(0);
-		auto result = box.recv_files.insert(std::make_pair(identifier, file));
-		if(!result.second) {
-			result.first->second = file;
+	if(address == "/file/nack") {
+		uint32_t identifier = msg.getArgAsInt32(0);
+		auto it = pushes_.find(identifier);
+		if(it == end(pushes_)) { return; }
+		auto &push = it->second;
+		for(std::size_t i = 1; i+1 < msg.getNumArgs(); i += 2) {
+			uint64_t first = msg.getArgAsInt64(i);
+			uint64_t count = msg.getArgAsInt64(i+1);
+			for(uint64_t c = first; c < first+count && c < push.num_chunks; ++c) {
+				push.repair.insert(c);
+			}
 		}
 	}
 	else if(address == "/file/request"){
 		std::string ip = msg.getRemoteHost();
-		auto it = boxes_.find(ip);
-		if(it == end(boxes_)) { return; }
-		auto &send_files = it->second.send_files;
 		uint32_t identifier = msg.getArgAsInt32(0);
-		auto it2 = send_files.find(identifier);
-		if(it2 == end(send_files)) {
-			return;
-		}
-		auto &info = it2->second;
-		if(!info.isOpen()) {
-			info.open();
-		}
 		uint64_t position = msg.getArgAsInt64(1);
 		uint64_t maxsize = min<uint64_t>(msg.getArgAsInt64(2), SEND_MAXSIZE);
-		uint64_t size = min<uint64_t>(maxsize, info.file.getSize()-position);
-		ofBuffer buffer;
-		info.file.seekg(position, ios_base::beg);
-		buffer.allocate(size);
-		info.file.read(buffer.getData(), buffer.size());
-		ofxOscMessage msg;
-		msg.setAddress("/file/data");
-		msg.addInt32Arg(identifier);
-		msg.addInt64Arg(position);
-		msg.addBlobArg(buffer);
-		node_.sendMessage(info.destination, msg);
+		int codec = msg.getNumArgs() > 3 ? msg.getArgAsInt32(3) : TransferScheduler::CODEC_NONE;
+		uint64_t piece_size = msg.getNumArgs() > 4 ? msg.getArgAsInt64(4) : maxsize;
+		sendPieces({ip}, identifier, position, maxsize, codec, max<uint64_t>(piece_size, 1));
 	}
 	else if(address == "/file/aborted") {
-		std::string ip = msg.getRemoteIp();
-		uint32_t identifier = msg.getArgAsInt32(0);
-		auto it = boxes_.find(ip);
-		if(it == end(boxes_)) { return; }
-		auto it2 = it->second.recv_files.find(identifier);
-		if(it2 == end(it->second.recv_files)) { return; }
-		it->second.recv_files.erase(it2);
-	}
-	else if(address == "/file/data") {
-		std::string ip = msg.getRemoteHost();
-		uint32_t identifier = msg.getArgAsInt32(0);
-		uint64_t position = msg.getArgAsInt64(1);
-		const ofBuffer &data = msg.getArgAsBlob(2);
-		auto it = boxes_.find(ip);
-		if(it == end(boxes_)) { return; }
-		auto it2 = it->second.recv_files.find(identifier);
-		if(it2 == end(it->second.recv_files)) { return; }
-		auto &info = it2->second;
-		if(!info.is_receiving) { return; }
-		if(info.isCompleted()) { return; }
-		auto *ptr = info.buffer.getData();
-		auto size = data.size();
-		assert(position+size <= info.buffer.size());
-		memcpy(ptr+position, data.getData(), size);
-		info.received_size = position+size;
+		// a receiver cancelled a file we are pushing
+		auto push = pushes_.find(msg.getArgAsInt32(0));
+		if(push != end(pushes_)) {
+			push->second.receivers.erase(msg.getRemoteHost());
+		}
 	}
 	else if(address == "/file/completed") {
-		std::string ip = msg.getRemoteIp();
-		auto it = boxes_.find(ip);
-		if(it == end(boxes_)) { return; }
-		auto &send_files = it->second.send_files;
 		uint32_t identifier = msg.getArgAsInt32(0);
-		auto it2 = send_files.find(identifier);
-		if(it2 == end(send_files)) {
+		auto push = pushes_.find(identifier);
+		if(push != end(pushes_)) {
+			push->second.receivers.erase(msg.getRemoteHost());
+			return;
+		}
+		auto it = send_files_.find(identifier);
+		if(it == end(send_files_)) {
 			return;
 		}
-		auto &info = it2->second;
-		info.close();
+		it->second.close();
 	}
 }
 //--------------------------------------------------------------
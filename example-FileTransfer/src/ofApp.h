@@ -3,6 +3,7 @@
 #include "ofMain.h"
 #include "ofxSearchNetworkNode.h"
 #include "ofxImGui.h"
+#include "TransferScheduler.h"
 
 class ofApp : public ofBaseApp{
 	
@@ -25,43 +26,78 @@ public:
 private:
 	ofxSearchNetworkNode node_;
 	ofxImGui::Gui gui_;
+	TransferScheduler scheduler_;
 	void messageReceived(ofxOscMessage &msg);
+	void fileOffered(const TransferScheduler::FileEvent &event);
+	void fileAborted(const TransferScheduler::FileEvent &event);
+	void queueChanged(const TransferScheduler::QueueState &state);
+	void nodeGone(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+	TransferScheduler::QueueState queue_state_;
 	void notifyFileIsReady(const std::string &ip, const std::string &filepath);
-	void sendRequest(const std::string &ip, unsigned int identifier, uint64_t position);
+	void sendPieces(const std::vector<std::string> &ip, unsigned int identifier, uint64_t position, uint64_t size, int codec, uint64_t piece_size);
 	void sendAborted(const std::string &ip, unsigned int identifier);
-	void sendCompleted(const std::string &ip, unsigned int identifier);
-
-	struct RecvFile {
-		bool is_receiving=false;
-		bool complete_msg_sent=false;
-		bool isCompleted() const {
-			return received_size == buffer.size();
-		}
-		std::string name;
-		ofBuffer buffer;
-		uint64_t received_size;
-		RecvFile(std::string name, uint64_t size):name(name),received_size(0) {
-			buffer.allocate(size);
-		}
+	// forgets a file no peer is offered or pushed anymore
+	void releaseSendFile(unsigned int identifier);
+	void pushFile(const std::string &filepath);
+	void sendPushEnd(unsigned int identifier);
+	ofBuffer readChunk(unsigned int identifier, uint64_t position, uint64_t size);
+	ofxOscMessage createDataMessage(unsigned int identifier, uint64_t position, const ofBuffer &data, int codec);
+	
+	bool compression_=true;
+	struct CompressionStats {
+		uint64_t raw=0;
+		uint64_t packed=0;
+		int samples=0;
+		int skipped=0;
+		bool enabled=true;
 	};
+	std::map<uint32_t, CompressionStats> compression_stats_;
+
 	struct SendFile {
-		std::string destination;
 		std::string path;
 		ofFile file;
-		SendFile(std::string d, std::string p):destination(d),path(p){}
+		SendFile(std::string p):path(p){}
 		void open() { file.open(path); }
 		void close() { file.close(); }
 		bool isOpen() const { return file.is_open(); }
 	};
 	struct FileBox {
 		bool is_open;
-		std::map<uint32_t, SendFile> send_files;
-		std::map<uint32_t, RecvFile> recv_files;
+		std::set<uint32_t> send_files;
+		std::set<uint32_t> recv_files;
 	};
 	std::map<std::string, FileBox> boxes_;
+	// files are identified by the SHA-256 of their content,
+	// so the same file offered by several peers shares one entry.
+	std::map<uint32_t, SendFile> send_files_;
+	
+	// in swarm mode chunks are requested from every peer offering the file
+	// and partially received files are served to others.
+	bool swarm_mode_=true;
+	TransferScheduler::Limits limits_;
+	
+	// one-to-many distribution.
+	// chunks are sent once to the broadcast addresses and receivers report missing ones with /file/nack.
+	struct Push {
+		uint64_t size;
+		std::size_t num_chunks;
+		std::size_t next_chunk=0;
+		uint64_t piece_size;
+		std::set<std::size_t> repair;
+		std::set<std::string> receivers;
+		float end_timer=0;
+	};
+	std::map<uint32_t, Push> pushes_;
+	bool push_to_all_=false;
+	int push_chunks_per_frame_=8;
+	float push_end_interval_=0.5f;
+	void updatePush(uint32_t identifier, Push &push);
 	
 	std::vector<std::string> drag_files_;
 	
+	// size of a chunk, the unit of scheduling.
+	// chunks are sent in pieces that fit in a datagram for each peer.
 	uint64_t SEND_MAXSIZE;
 	uint64_t RECV_MAXSIZE;
+	float simulated_loss_=0;
 };
@@ -6,6 +6,7 @@ void ofApp::setup(){
 	node_.setAllowLoopback(true);
 	node_.setup(9000);
 	node_.request();
+	log_.setup(node_);
 	
 	gui_.setup();
 }
@@ -35,7 +36,7 @@ void ofApp::draw(){
 		if(ImGui::Button("Leave")) {
 			node_.disconnect();
 		}
-		ImGui::InputInt("Log length", &log_length_);
+		ImGui::Text("%d/%d lines in the log", (int)log_.size(), (int)log_.getSettings().capacity);
 	}
 	ImGui::End();
 	
@@ -52,18 +53,21 @@ void ofApp::draw(){
 			ofxOscMessage msg;
 			msg.setAddress("/message");
 			msg.addStringArg(message);
-			node_.sendMessage(msg);
+			node_.sendReliable(msg);
 			message[0] = 0;
 		}
-		for(auto &l : log_) {
-			std::string name = "unknown";
-			const auto &member = members.find(l.ip);
-			if(member != end(members)) {
-				name = member->second.name;
+		// only the visible lines are drawn, newest first
+		if(ImGui::BeginChild("log")) {
+			ImGuiListClipper clipper;
+			clipper.Begin((int)log_.size());
+			while(clipper.Step()) {
+				for(int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+					auto line = log_.get(log_.size()-1-i);
+					ImGui::Text("%s(%s):%s", log_.getSenderName(line.sender).c_str(), log_.getSenderIp(line.sender).c_str(), line.text);
+				}
 			}
-			ImGui::Text("%s(%s):%s", name.c_str(), l.ip.c_str(), l.message.c_str());
 		}
-		
+		ImGui::EndChild();
 	}
 	ImGui::End();
 	
@@ -72,13 +76,10 @@ void ofApp::draw(){
 
 void ofApp::messageReceived(ofxOscMessage &msg)
 {
-	while(log_.size() > log_length_) {
-		log_.pop_back();
+	if(msg.getAddress() != "/message") {
+		return;
 	}
-	MessageLog log;
-	log.ip = msg.getRemoteIp();
-	log.message = msg.getArgAsString(0);
-	log_.emplace_front(log);
+	log_.add(msg.getRemoteIp(), msg.getArgAsString(0));
 }
 
 //--------------------------------------------------------------
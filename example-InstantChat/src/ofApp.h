@@ -2,6 +2,7 @@
 
 #include "ofMain.h"
 #include "ofxSearchNetworkNode.h"
+#include "ofxSNNMessageLog.h"
 #include "ofxImGui.h"
 
 class ofApp : public ofBaseApp{
@@ -25,12 +26,7 @@ public:
 private:
 	ofxSearchNetworkNode node_;
 	ofxImGui::Gui gui_;
-	struct MessageLog {
-		std::string ip;
-		std::string message;
-	};
-	std::deque<MessageLog> log_;
-	int log_length_=30;
+	ofxSNNMessageLog log_;
 	
 	void messageReceived(ofxOscMessage &msg);
 };
@@ -10,15 +10,58 @@ void ofApp::setup(){
 	
 	my_value_.setNode(node_);
 	my_value_.setup(10000, "my value");
+	my_value_.setInterpolation(0.1f);
+	room_value_.setNode(node_);
+	room_value_.setOwnerMode(true);
+	room_value_.setup(10000, "room value");
+
+	shape_.setName("shape");
+	shape_.add(shape_size_.set("size", 20));
+	shape_.add(shape_position_.set("position", ofVec2f(ofRandomWidth(), ofRandomHeight())));
+	shape_.add(shape_color_.set("color", ofFloatColor(ofRandom(1), ofRandom(1), ofRandom(1))));
+	shape_sync_.setup(node_, shape_);
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
+	float time = ofGetElapsedTimef();
+	for(std::size_t i = 0; i < benchmark_values_.size(); ++i) {
+		benchmark_values_[i]->set(sin(time*(1+i%7)+i)*0.5f+0.5f);
+	}
+	stats_timer_ += ofGetLastFrameTime();
+	auto engine = ofxSNNParamSyncEngine::find(node_, 10000);
+	if(engine && stats_timer_ >= 1) {
+		auto &stats = engine->getStats();
+		stats_per_sec_.messages_sent = (stats.messages_sent - last_stats_.messages_sent)/stats_timer_;
+		stats_per_sec_.bundles_sent = (stats.bundles_sent - last_stats_.bundles_sent)/stats_timer_;
+		stats_per_sec_.bytes_sent = (stats.bytes_sent - last_stats_.bytes_sent)/stats_timer_;
+		last_stats_ = stats;
+		stats_timer_ = 0;
+	}
+}
 
+void ofApp::addBenchmarkParams(std::size_t num_params)
+{
+	for(std::size_t i = 0; i < num_params; ++i) {
+		benchmark_values_.emplace_back(new ofxSNNParamSync<float>());
+		auto &value = *benchmark_values_.back();
+		value.setNode(node_);
+		value.setup(10000, "benchmark/"+ofToString(benchmark_values_.size()));
+		value.setEpsilon(0.01f);
+		value.setMinInterval(1/20.f);
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
+	for(const auto &member : node_.getNodes()) {
+		const ofParameterGroup *shape = shape_sync_.getRemote(member.first);
+		if(shape) {
+			ofSetColor(shape->getFloatColor("color"));
+			ofDrawCircle(shape->getVec2f("position"), shape->getFloat("size"));
+		}
+	}
+	
 	gui_.begin();
 	
 	if(ImGui::Begin("Settings")) {
@@ -41,6 +84,30 @@ void ofApp::draw(){
 		if(ImGui::SliderFloat("my value", &value, 0, 1)) {
 			my_value_.set(value);
 		}
+		float room_value = room_value_.get();
+		if(ImGui::SliderFloat("room value", &room_value, 0, 1)) {
+			room_value_.set(room_value);
+		}
+		ImGui::Text("owner: %s", room_value_.isOwner() ? "me" : room_value_.getOwner().c_str());
+		ImGui::Separator();
+		float size = shape_size_;
+		if(ImGui::SliderFloat("shape size", &size, 1, 100)) {
+			shape_size_ = size;
+		}
+		ofVec2f position = shape_position_;
+		if(ImGui::SliderFloat2("shape position", &position.x, 0, ofGetWidth())) {
+			shape_position_ = position;
+		}
+		ofFloatColor color = shape_color_;
+		if(ImGui::ColorEdit4("shape color", &color.r)) {
+			shape_color_ = color;
+		}
+		ImGui::Separator();
+		if(ImGui::Button("add 1000 moving values")) {
+			addBenchmarkParams(1000);
+		}
+		ImGui::Text("%d values to %d peers", (int)benchmark_values_.size()+1, (int)node_.getNodes().size());
+		ImGui::Text("%llu messages/s in %llu datagrams/s, %llu bytes/s", (unsigned long long)stats_per_sec_.messages_sent, (unsigned long long)stats_per_sec_.bundles_sent, (unsigned long long)stats_per_sec_.bytes_sent);
 	}
 	ImGui::End();
 	
@@ -50,6 +117,7 @@ void ofApp::draw(){
 			for(const auto &member : members) {
 				ImGui::Text("%s(%s)", member.second.name.c_str(), member.first.c_str());
 				ImGui::SliderFloat("value", &my_value_.getRemote(member.first), 0, 1);
+				ImGui::ProgressBar(my_value_.sampleRemote(member.first), ImVec2(-1,0), "smoothed");
 			}
 			ImGui::TreePop();
 		}
@@ -3,6 +3,7 @@
 #include "ofMain.h"
 #include "ofxSearchNetworkNode.h"
 #include "ofxSNNParamSync.h"
+#include "ofxSNNParamGroupSync.h"
 #include "ofxImGui.h"
 
 class ofApp : public ofBaseApp{
@@ -27,4 +28,19 @@ private:
 	ofxSearchNetworkNode node_;
 	ofxImGui::Gui gui_;
 	ofxSNNParamSync<float> my_value_;
+	// one value for the whole room, resolved by the owner
+	ofxSNNParamSync<float> room_value_;
+
+	// a whole group shared at once
+	ofParameterGroup shape_;
+	ofParameter<float> shape_size_;
+	ofParameter<ofVec2f> shape_position_;
+	ofParameter<ofFloatColor> shape_color_;
+	ofxSNNParamGroupSync shape_sync_;
+
+	// many values moving at once, to see what goes on the wire
+	std::vector<std::unique_ptr<ofxSNNParamSync<float>>> benchmark_values_;
+	void addBenchmarkParams(std::size_t num_params);
+	ofxSNNParamSyncEngine::Stats last_stats_, stats_per_sec_;
+	float stats_timer_=0;
 };
@@ -2,11 +2,16 @@
 
 //--------------------------------------------------------------
 void ofApp::setup(){	
-	ofAddListener(node_.unhandledMessageReceived, this, &ofApp::messageReceived);
 	node_.setAllowLoopback(true);
 	node_.setup(9000);
 	node_.request();
 	
+	ofxSNNAudioStream::Settings settings;
+	settings.num_channels = 1;
+	settings.sample_rate = 44100;
+	settings.frames_per_packet = 256;
+	audio_.setup(node_, settings);
+	
 	gui_.setup();
 	
 	ofBackground(ofColor::black);
@@ -16,40 +21,17 @@ void ofApp::setup(){
 
 //--------------------------------------------------------------
 void ofApp::update(){
-	ofSoundBuffer buf;
-	{
-		unique_lock<mutex> lock(audio_mutex_);
-		buf = last_buffer_;
-		
-		int send_size = 256;
-		int buffers = 2;
-		while(buffer_to_send_.size() >= send_size*buffers) {
-			ofxOscMessage msg;
-			msg.setAddress("/audio");
-			auto &data = buffer_to_send_.getBuffer();
-			ofBuffer blob;
-			blob.append(reinterpret_cast<char*>(data.data()), send_size*sizeof(float));
-			data.erase(begin(data), begin(data)+send_size);
-			
-			msg.addInt32Arg(send_size);
-			msg.addInt32Arg(buffer_to_send_.getNumChannels());
-			msg.addInt32Arg(buffer_to_send_.getSampleRate());
-			msg.addBlobArg(blob);
-			
-			unique_lock<mutex> lock(node_mutex_);
-			node_.sendMessage(msg);
-		}
-	}
+	audio_.getMonitor(last_buffer_, 256);
 	
 	waveform_.clear();
-	for(size_t i = 0; i < buf.getNumFrames(); i++) {
-		float sample = buf.getSample(i, 0);
-		float x = ofMap(i, 0, buf.getNumFrames(), 0, ofGetWidth());
+	for(size_t i = 0; i < last_buffer_.getNumFrames(); i++) {
+		float sample = last_buffer_.getSample(i, 0);
+		float x = ofMap(i, 0, last_buffer_.getNumFrames(), 0, ofGetWidth());
 		float y = ofMap(sample, -1, 1, 0, ofGetHeight());
 		waveform_.addVertex(x, y);
 	}
 	
-	rms_ = buf.getRMSAmplitude();
+	rms_ = last_buffer_.getRMSAmplitude();
 }
 
 //--------------------------------------------------------------
@@ -73,11 +55,9 @@ void ofApp::draw(){
 			node_.setGroup(ofSplitString(buf,","), false);
 		}
 		if(ImGui::Button("Enter")) {
-			unique_lock<mutex> lock(node_mutex_);
 			node_.request();
 		} ImGui::SameLine();
 		if(ImGui::Button("Leave")) {
-			unique_lock<mutex> lock(node_mutex_);
 			node_.disconnect();
 		}
 	}
@@ -97,45 +77,13 @@ void ofApp::draw(){
 	gui_.end();
 }
 
-void ofApp::messageReceived(ofxOscMessage &msg)
-{
-	int frames = msg.getArgAsInt32(0);
-	int channels = msg.getArgAsInt32(1);
-	int sample_rate = msg.getArgAsInt32(2);
-	ofBuffer incoming = std::move(msg.getArgAsBlob(3));
-	float *data = reinterpret_cast<float*>(incoming.getData());
-	
-	ofSoundBuffer buf;
-	buf.copyFrom(data, frames, channels, sample_rate);
-	
-	unique_lock<mutex> lock(audio_mutex_);
-	buffer_[msg.getRemoteIp()].append(buf);
-}
-
 void ofApp::audioIn(ofSoundBuffer &buffer)
 {
-	if(buffer.trimSilence()) {
-		unique_lock<mutex> lock(audio_mutex_);
-		buffer_to_send_.append(buffer);
-	}
+	audio_.audioIn(buffer);
 }
 void ofApp::audioOut(ofSoundBuffer &buffer)
 {
-	buffer.set(0);
-	unique_lock<mutex> lock(audio_mutex_);
-	for(auto &b : buffer_) {
-		auto &buf = b.second;
-		if(buf.getNumFrames() < buffer.getNumFrames()) {
-			continue;
-		}
-		int frames_to_copy = buffer.getNumFrames();
-		int channels = buffer.getNumChannels();
-		buf.addTo(buffer, frames_to_copy, channels, 0);
-		auto &data = buf.getBuffer();
-		data.erase(begin(data), begin(data)+buffer.size());
-	}
-	
-	last_buffer_ = buffer;
+	audio_.audioOut(buffer);
 }
 
 //--------------------------------------------------------------
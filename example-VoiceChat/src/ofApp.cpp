@@ -2,11 +2,17 @@
 
 //--------------------------------------------------------------
 void ofApp::setup(){
-	ofAddListener(node_.unhandledMessageReceived, this, &ofApp::messageReceived);
 	node_.setAllowLoopback(true);
 	node_.setup(9000);
 	node_.request();
 	
+	ofxSNNAudioStream::Settings settings;
+	settings.num_channels = 1;
+	settings.sample_rate = 44100;
+	settings.frames_per_packet = 256;
+	settings.send_thread = true;
+	audio_.setup(node_, settings);
+	
 	gui_.setup();
 	
 	ofBackground(ofColor::black);
@@ -16,40 +22,17 @@ void ofApp::setup(){
 
 //--------------------------------------------------------------
 void ofApp::update(){
-	ofSoundBuffer buf;
-	{
-		unique_lock<mutex> lock(audio_mutex_);
-		buf = last_buffer_;
-
-		int send_size = 256;
-		int buffers = 2;
-		while(buffer_to_send_.size() >= send_size*buffers) {
-			ofxOscMessage msg;
-			msg.setAddress("/audio");
-			auto &data = buffer_to_send_.getBuffer();
-			ofBuffer blob;
-			blob.append(reinterpret_cast<char*>(data.data()), send_size*sizeof(float));
-			data.erase(begin(data), begin(data)+send_size);
-			
-			msg.addInt32Arg(send_size);
-			msg.addInt32Arg(buffer_to_send_.getNumChannels());
-			msg.addInt32Arg(buffer_to_send_.getSampleRate());
-			msg.addBlobArg(blob);
-			
-			unique_lock<mutex> lock(node_mutex_);
-			node_.sendMessage(msg);
-		}
-	}
+	audio_.getMonitor(last_buffer_, 256);
 
 	waveform_.clear();
-	for(size_t i = 0; i < buf.getNumFrames(); i++) {
-		float sample = buf.getSample(i, 0);
-		float x = ofMap(i, 0, buf.getNumFrames(), 0, ofGetWidth());
+	for(size_t i = 0; i < last_buffer_.getNumFrames(); i++) {
+		float sample = last_buffer_.getSample(i, 0);
+		float x = ofMap(i, 0, last_buffer_.getNumFrames(), 0, ofGetWidth());
 		float y = ofMap(sample, -1, 1, 0, ofGetHeight());
 		waveform_.addVertex(x, y);
 	}
 	
-	rms_ = buf.getRMSAmplitude();
+	rms_ = last_buffer_.getRMSAmplitude();
 
 }
 
@@ -74,13 +57,29 @@ void ofApp::draw(){
 			node_.setGroup(ofSplitString(buf,","), false);
 		}
 		if(ImGui::Button("Enter")) {
-			unique_lock<mutex> lock(node_mutex_);
 			node_.request();
 		} ImGui::SameLine();
 		if(ImGui::Button("Leave")) {
-			unique_lock<mutex> lock(node_mutex_);
 			node_.disconnect();
 		}
+		int codec = audio_.getCodec();
+		if(ImGui::RadioButton("float32", codec == ofxSNNAudioCodec::FLOAT32)) {
+			audio_.setCodec(ofxSNNAudioCodec::FLOAT32);
+		} ImGui::SameLine();
+		if(ImGui::RadioButton("int16", codec == ofxSNNAudioCodec::INT16)) {
+			audio_.setCodec(ofxSNNAudioCodec::INT16);
+		} ImGui::SameLine();
+		if(ImGui::RadioButton("mu-law", codec == ofxSNNAudioCodec::MULAW)) {
+			audio_.setCodec(ofxSNNAudioCodec::MULAW);
+		}
+		bool vad = audio_.isVoiceActivityDetection();
+		if(ImGui::Checkbox("voice activity detection", &vad)) {
+			audio_.setVoiceActivityDetection(vad);
+		}
+		int max_talkers = audio_.getSettings().max_talkers;
+		if(ImGui::SliderInt("max talkers", &max_talkers, 0, 16)) {
+			audio_.setMaxTalkers(max_talkers);
+		}
 	}
 	ImGui::End();
 	
@@ -92,50 +91,35 @@ void ofApp::draw(){
 			}
 			ImGui::TreePop();
 		}
+		auto stats = audio_.getStats();
+		ImGui::Text("%s %.0fdB, suppressed %llu", stats.is_talking ? "talking" : "quiet", stats.level, (unsigned long long)stats.packets_suppressed);
+		if(ImGui::TreeNode("Stats", "Stats(sending %.1fKB/s, input overruns %llu)", stats.bytes_per_sec/1024, (unsigned long long)stats.input_overruns)) {
+			for(const auto &ip : audio_.getPeers()) {
+				auto peer = audio_.getPeerStats(ip);
+				ImGui::Text("%s %.0fdB%s %.1fKB/s (codec %d)", ip.c_str(), peer.level, peer.is_selected ? "" : "(muted)", peer.bytes_per_sec/1024, peer.codec);
+				float gain = audio_.getGain(ip);
+				if(ImGui::SliderFloat(("gain##"+ip).c_str(), &gain, 0, 2)) {
+					audio_.setGain(ip, gain);
+				}
+				ImGui::Text("  delay %.0fms (target %.0fms), jitter %.1fms", peer.delay*1000, peer.target_delay*1000, peer.jitter*1000);
+				ImGui::Text("  concealed %.1f%%, late %llu, dropped %llu, underruns %llu", peer.getConcealmentRate()*100, (unsigned long long)peer.late, (unsigned long long)peer.dropped, (unsigned long long)peer.underruns);
+				ImGui::Text("  clock drift %.0fppm, correction %.0fppm", peer.drift_ppm, peer.correction_ppm);
+			}
+			ImGui::TreePop();
+		}
 	}
 	ImGui::End();
 	
 	gui_.end();
 }
 
-void ofApp::messageReceived(ofxOscMessage &msg)
-{
-	int frames = msg.getArgAsInt32(0);
-	int channels = msg.getArgAsInt32(1);
-	int sample_rate = msg.getArgAsInt32(2);
-	ofBuffer incoming = std::move(msg.getArgAsBlob(3));
-	float *data = reinterpret_cast<float*>(incoming.getData());
-	
-	ofSoundBuffer buf;
-	buf.copyFrom(data, frames, channels, sample_rate);
-	
-	unique_lock<mutex> lock(audio_mutex_);
-	buffer_[msg.getRemoteIp()].append(buf);
-}
-
 void ofApp::audioIn(ofSoundBuffer &buffer)
 {
-	if(buffer.trimSilence()) {
-		unique_lock<mutex> lock(audio_mutex_);
-		buffer_to_send_.append(buffer);
-	}
+	audio_.audioIn(buffer);
 }
 void ofApp::audioOut(ofSoundBuffer &buffer)
 {
-	unique_lock<mutex> lock(audio_mutex_);
-	for(auto &b : buffer_) {
-		auto &buf = b.second;
-		if(buf.getNumFrames() < buffer.getNumFrames()) {
-			continue;
-		}
-		int frames_to_copy = buffer.getNumFrames();
-		int channels = buffer.getNumChannels();
-		buf.addTo(buffer, frames_to_copy, channels, 0);
-		auto &data = buf.getBuffer();
-		data.erase(begin(data), begin(data)+buffer.size());
-	}
-	
-	last_buffer_ = buffer;
+	audio_.audioOut(buffer);
 }
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
@@ -2,6 +2,7 @@
 
 #include "ofMain.h"
 #include "ofxSearchNetworkNode.h"
+#include "ofxSNNAudioStream.h"
 #include "ofxImGui.h"
 
 class ofApp : public ofBaseApp{
@@ -25,16 +26,14 @@ public:
 private:
 	ofxSearchNetworkNode node_;
 	ofxImGui::Gui gui_;
+	// destroyed after the sound stream stops calling it
+	ofxSNNAudioStream audio_;
 	ofSoundStream stream_;
-	std::map<std::string, ofSoundBuffer> buffer_;
-	
-	void messageReceived(ofxOscMessage &msg);
 	
 	void audioIn(ofSoundBuffer &buffer);
 	void audioOut(ofSoundBuffer &buffer);
 	
-	mutex audio_mutex_, node_mutex_;
-	ofSoundBuffer last_buffer_, buffer_to_send_;
+	ofSoundBuffer last_buffer_;
 	ofPolyline waveform_;
 	float rms_;
 };
@@ -4,46 +4,34 @@
 void ofApp::setup(){
 	ofBackground(255);
 	
-	ofAddListener(node_.nodeFound, this, &ofApp::newNodeFound);
-	ofAddListener(node_.unhandledMessageReceived, this, &ofApp::messageReceived);
 	node_.setAllowLoopback(true);
+	node_.setBatching(true);
 	node_.setup(9000);
 	node_.request();
+	board_.setup(node_);
+	board_.sync();
 	
 	gui_.setup();
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
-
+	board_.setStyle(pen_.getStyle());
+	stats_timer_ += ofGetLastFrameTime();
+	if(stats_timer_ >= 1) {
+		auto stats = node_.getSendStats();
+		send_stats_per_sec_.messages_sent = (stats.messages_sent - last_send_stats_.messages_sent)/stats_timer_;
+		send_stats_per_sec_.datagrams_sent = (stats.datagrams_sent - last_send_stats_.datagrams_sent)/stats_timer_;
+		last_send_stats_ = stats;
+		stats_timer_ = 0;
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
-	struct Stroke {
-		ofColor color;
-		float width;
-		ofVec2f point;
-	};
-	std::map<std::string, Stroke> strokes;
-	for(auto &msg : log_) {
-		Stroke stroke;
-		stroke.color = ofColor::fromHex(msg.getArgAsInt32(3));
-		stroke.width = msg.getArgAsFloat(2);
-		stroke.point = ofVec2f(msg.getArgAsFloat(0), msg.getArgAsFloat(1));
-		auto result = strokes.insert(std::make_pair(msg.getRemoteIp(), stroke));
-		if(!result.second) {
-			auto &prev_stroke = result.first->second;
-			if(msg.getAddress() != "/start") {
-				ofPushStyle();
-				ofSetColor(prev_stroke.color);
-				ofSetLineWidth(prev_stroke.width);
-				ofDrawLine(prev_stroke.point, stroke.point);
-				ofPopStyle();
-			}
-			prev_stroke = stroke;
-		}
-	}
+	board_.draw([](const ofVec3f &min, const ofVec3f &max) {
+		return max.x >= 0 && max.y >= 0 && min.x <= ofGetWidth() && min.y <= ofGetHeight();
+	});
 	
 	gui_.begin();
 	
@@ -59,103 +47,57 @@ void ofApp::draw(){
 		}
 		if(ImGui::Button("Enter")) {
 			node_.request();
+			board_.sync();
 		} ImGui::SameLine();
 		if(ImGui::Button("Leave")) {
 			node_.disconnect();
-			log_.clear();
-			bundle_length_ = 0;
+			board_.reset();
+		}
+		if(board_.isSyncing()) {
+			ImGui::Text("loading the board... %.0f%%", board_.getProgress()*100);
 		}
 		ImGui::ColorEdit3("color", &pen_.color.r);
 		ImGui::SliderFloat("width", &pen_.width, 1, 8);
 		if(ImGui::Button("clear")) {
-			clear();
+			board_.clear();
+		}
+		ImGui::Text("drag with the right button to erase.");
+		auto &stats = board_.getStream().getStats();
+		ImGui::Text("sent %llu points in %llu datagrams, %llu bytes", (unsigned long long)stats.points_sent, (unsigned long long)stats.datagrams_sent, (unsigned long long)stats.bytes_sent);
+		ImGui::Text("%d operations in the log", (int)board_.getLog().getNumOps());
+		bool batching = node_.isBatching();
+		if(ImGui::Checkbox("batch messages", &batching)) {
+			node_.setBatching(batching);
 		}
+		ImGui::Text("%llu messages/s in %llu datagrams/s", (unsigned long long)send_stats_per_sec_.messages_sent, (unsigned long long)send_stats_per_sec_.datagrams_sent);
 	}
 	ImGui::End();
 	
 	gui_.end();
 }
 
-void ofApp::messageReceived(ofxOscMessage &msg)
+ofxSNNStrokeStream::Style ofApp::Pen::getStyle() const
 {
-	const std::string address = msg.getAddress();
-	if(address == "/clear") {
-		log_.clear();
-		return;
-	}
-	if(address == "/bundle") {
-		int bundle_length = msg.getArgAsInt(0);
-		if(bundle_length_ < bundle_length) {
-			log_.clear();
-			is_through_bundle_ = false;
-		}
-		else {
-			is_through_bundle_ = true;
-		}
-		bundle_length_ = bundle_length;
-		return;
-	}
-	if(is_through_bundle_) {
-		if(--bundle_length_ <= 0) {
-			is_through_bundle_ = false;
-		}
-	}
-	else {
-		log_.emplace_back(msg);
-	}
+	ofxSNNStrokeStream::Style style;
+	style.width = width;
+	style.color = color;
+	return style;
 }
 
 void ofApp::startStroke(ofVec2f pos)
 {
-	ofxOscMessage msg;
-	msg.setAddress("/start");
-	msg.addFloatArg(pos.x);
-	msg.addFloatArg(pos.y);
-	msg.addFloatArg(pen_.width);
-	msg.addInt32Arg(pen_.color.getHex());
-	node_.sendMessage(msg);
+	board_.begin(pos, pen_.getStyle());
 	pen_.is_writing = true;
 }
 void ofApp::stroke(ofVec2f pos)
 {
-	ofxOscMessage msg;
-	msg.setAddress("/stroke");
-	msg.addFloatArg(pos.x);
-	msg.addFloatArg(pos.y);
-	msg.addFloatArg(pen_.width);
-	msg.addInt32Arg(pen_.color.getHex());
-	node_.sendMessage(msg);
+	board_.add(pos);
 }
 void ofApp::endStroke(ofVec2f pos)
 {
-	stroke(pos);
+	board_.end(pos);
 	pen_.is_writing = false;
 }
-void ofApp::clear()
-{
-	ofxOscMessage msg;
-	msg.setAddress("/clear");
-	node_.sendMessage(msg);
-}
-
-void ofApp::newNodeFound(const std::pair<std::string, ofxSearchNetworkNode::Node> &node)
-{
-	if(node_.isSelfIp(node.first)) {
-		return;
-	}
-	if(log_.empty()) {
-		return;
-	}
-	ofxOscBundle bundle;
-	ofxOscMessage first_msg;
-	first_msg.setAddress("/bundle");
-	first_msg.addIntArg(log_.size());
-	bundle.addMessage(first_msg);
-	for(auto &msg : log_) {
-		bundle.addMessage(msg);
-	}
-	node_.sendBundle(node.first, bundle);
-}
 
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
@@ -174,14 +116,23 @@ void ofApp::mouseMoved(int x, int y ){
 
 //--------------------------------------------------------------
 void ofApp::mouseDragged(int x, int y, int button){
-	if(pen_.is_writing) {
+	if(button == OF_MOUSE_BUTTON_RIGHT) {
+		board_.erase(ofVec2f(x,y), pen_.width);
+	}
+	else if(pen_.is_writing) {
 		stroke(ofVec2f(x,y));
 	}
 }
 
 //--------------------------------------------------------------
 void ofApp::mousePressed(int x, int y, int button){
-	if(!ImGui::GetIO().WantCaptureMouse) {
+	if(ImGui::GetIO().WantCaptureMouse) {
+		return;
+	}
+	if(button == OF_MOUSE_BUTTON_RIGHT) {
+		board_.erase(ofVec2f(x,y), pen_.width);
+	}
+	else {
 		startStroke(ofVec2f(x,y));
 	}
 }
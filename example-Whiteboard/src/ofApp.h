@@ -2,6 +2,7 @@
 
 #include "ofMain.h"
 #include "ofxSearchNetworkNode.h"
+#include "ofxSNNWhiteboard.h"
 #include "ofxImGui.h"
 
 class ofApp : public ofBaseApp{
@@ -24,22 +25,19 @@ public:
 	void gotMessage(ofMessage msg);
 private:
 	ofxSearchNetworkNode node_;
+	ofxSearchNetworkNode::SendStats last_send_stats_, send_stats_per_sec_;
+	float stats_timer_=0;
+	ofxSNNWhiteboard board_;
 	ofxImGui::Gui gui_;
 	struct Pen {
 		ofFloatColor color=ofColor::black;
 		float width=4;
 		bool is_writing=false;
+		ofxSNNStrokeStream::Style getStyle() const;
 	} pen_;
-
-	std::deque<ofxOscMessage> log_;
-	bool is_through_bundle_=false;
-	int bundle_length_=0;
-	void messageReceived(ofxOscMessage &msg);
-	void newNodeFound(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
 	
 	// create message
 	void startStroke(ofVec2f pos);
 	void stroke(ofVec2f pos);
 	void endStroke(ofVec2f pos);
-	void clear();
 };
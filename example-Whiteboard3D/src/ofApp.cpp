@@ -4,11 +4,13 @@
 void ofApp::setup(){
 	ofBackground(255);
 	
-	ofAddListener(node_.nodeFound, this, &ofApp::newNodeFound);
-	ofAddListener(node_.unhandledMessageReceived, this, &ofApp::messageReceived);
 	node_.setAllowLoopback(true);
 	node_.setup(9000);
 	node_.request();
+	ofxSNNWhiteboard::Settings settings;
+	settings.dimensions = 3;
+	board_.setup(node_, settings);
+	board_.sync();
 	
 	gui_.setup();
 }
@@ -21,39 +23,35 @@ void ofApp::update(){
 	else {
 		camera_.enableMouseInput();
 	}
+	board_.setStyle(pen_.getStyle());
 	if(pen_.is_writing) {
 		stroke(getCurrentWorldPosition());
 	}
+	if(is_erasing_) {
+		board_.erase(getCurrentWorldPosition(), pen_.width);
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
-	struct Stroke {
-		ofColor color;
-		float width;
-		ofVec3f point;
-	};
 	camera_.begin();
 	ofEnableDepthTest();
-	std::map<std::string, Stroke> strokes;
-	for(auto &msg : log_) {
-		Stroke stroke;
-		stroke.color = ofColor::fromHex(msg.getArgAsInt32(4));
-		stroke.width = msg.getArgAsFloat(3);
-		stroke.point = ofVec3f(msg.getArgAsFloat(0), msg.getArgAsFloat(1), msg.getArgAsFloat(2));
-		auto result = strokes.insert(std::make_pair(msg.getRemoteIp(), stroke));
-		if(!result.second) {
-			auto &prev_stroke = result.first->second;
-			if(msg.getAddress() != "/start") {
-				ofPushStyle();
-				ofSetColor(prev_stroke.color);
-				ofSetLineWidth(prev_stroke.width);
-				ofDrawLine(prev_stroke.point, stroke.point);
-				ofPopStyle();
+	// buffers entirely off screen are skipped. ones reaching behind the camera are always drawn
+	board_.draw([this](const ofVec3f &min, const ofVec3f &max) {
+		int outside[4] = {0,0,0,0};
+		for(int i = 0; i < 8; ++i) {
+			ofVec3f corner(i&1 ? max.x : min.x, i&2 ? max.y : min.y, i&4 ? max.z : min.z);
+			ofVec3f screen = camera_.worldToScreen(corner);
+			if(screen.z < -1 || screen.z > 1) {
+				return true;
 			}
-			prev_stroke = stroke;
+			outside[0] += screen.x < 0;
+			outside[1] += screen.x > ofGetWidth();
+			outside[2] += screen.y < 0;
+			outside[3] += screen.y > ofGetHeight();
 		}
-	}
+		return std::none_of(outside, outside+4, [](int count) { return count == 8; });
+	});
 	ofDisableDepthTest();
 	camera_.end();
 	
@@ -71,106 +69,84 @@ void ofApp::draw(){
 		}
 		if(ImGui::Button("Enter")) {
 			node_.request();
+			board_.sync();
 		} ImGui::SameLine();
 		if(ImGui::Button("Leave")) {
 			node_.disconnect();
-			log_.clear();
-			bundle_length_ = 0;
+			board_.reset();
+		}
+		if(board_.isSyncing()) {
+			ImGui::Text("loading the board... %.0f%%", board_.getProgress()*100);
 		}
 		ImGui::ColorEdit3("color", &pen_.color.r);
 		ImGui::SliderFloat("width", &pen_.width, 1, 8);
 		if(ImGui::Button("clear")) {
-			clear();
+			board_.clear();
 		}
+		auto &stats = board_.getStream().getStats();
+		ImGui::Text("sent %llu points in %llu datagrams, %llu bytes", (unsigned long long)stats.points_sent, (unsigned long long)stats.datagrams_sent, (unsigned long long)stats.bytes_sent);
+		ImGui::Text("%d operations in the log", (int)board_.getLog().getNumOps());
 		ImGui::Text("press space bar to draw line.");
+		ImGui::Text("hold e key to erase.");
+		ImGui::Separator();
+		ImGui::Text("%d points in %d buffers, %.2f ms/frame", (int)board_.getMesh().getNumVertices(), (int)board_.getMesh().getNumBlocks(), ofGetLastFrameTime()*1000);
+		auto &store = board_.getStore();
+		ImGui::Text("%d points kept, %.1f bytes/point", (int)store.getNumPoints(), store.getMemoryUsage()/(float)std::max<std::size_t>(store.getNumPoints(), 1));
+		if(ImGui::Button("add 100k points")) {
+			addBenchmarkStrokes(100, 1000);
+		} ImGui::SameLine();
+		if(ImGui::Button("add 1M points")) {
+			addBenchmarkStrokes(1000, 1000);
+		}
 	}
 	ImGui::End();
 	
 	gui_.end();
 }
 
-void ofApp::messageReceived(ofxOscMessage &msg)
+void ofApp::addBenchmarkStrokes(std::size_t num_strokes, std::size_t points_per_stroke)
 {
-	const std::string address = msg.getAddress();
-	if(address == "/clear") {
-		log_.clear();
-		return;
-	}
-	if(address == "/bundle") {
-		int bundle_length = msg.getArgAsInt(0);
-		if(bundle_length_ < bundle_length) {
-			log_.clear();
-			is_through_bundle_ = false;
-		}
-		else {
-			is_through_bundle_ = true;
-		}
-		bundle_length_ = bundle_length;
-		return;
-	}
-	if(is_through_bundle_) {
-		if(--bundle_length_ <= 0) {
-			is_through_bundle_ = false;
+	ofxSNNStrokeStream::Points points;
+	points.author = ofRandom(std::numeric_limits<int32_t>::max());
+	points.index = 0;
+	points.is_end = true;
+	points.points.resize(points_per_stroke);
+	for(std::size_t i = 0; i < num_strokes; ++i) {
+		points.stroke = i;
+		// a few styles, like people drawing would use
+		points.style.width = (int)ofRandom(1, 5);
+		points.style.color = ofColor::fromHsb((int)ofRandom(8)*32, 255, 255);
+		ofVec3f pos(ofRandom(-500, 500), ofRandom(-500, 500), ofRandom(-500, 500));
+		for(auto &p : points.points) {
+			pos += ofVec3f(ofRandom(-5, 5), ofRandom(-5, 5), ofRandom(-5, 5));
+			p = pos;
 		}
+		board_.addPoints(points);
 	}
-	else {
-		log_.emplace_back(msg);
-	}
+}
+
+ofxSNNStrokeStream::Style ofApp::Pen::getStyle() const
+{
+	ofxSNNStrokeStream::Style style;
+	style.width = width;
+	style.color = color;
+	return style;
 }
 
 void ofApp::startStroke(ofVec3f pos)
 {
-	ofxOscMessage msg;
-	msg.setAddress("/start");
-	msg.addFloatArg(pos.x);
-	msg.addFloatArg(pos.y);
-	msg.addFloatArg(pos.z);
-	msg.addFloatArg(pen_.width);
-	msg.addInt32Arg(pen_.color.getHex());
-	node_.sendMessage(msg);
+	board_.begin(pos, pen_.getStyle());
 	pen_.is_writing = true;
 }
 void ofApp::stroke(ofVec3f pos)
 {
-	ofxOscMessage msg;
-	msg.setAddress("/stroke");
-	msg.addFloatArg(pos.x);
-	msg.addFloatArg(pos.y);
-	msg.addFloatArg(pos.z);
-	msg.addFloatArg(pen_.width);
-	msg.addInt32Arg(pen_.color.getHex());
-	node_.sendMessage(msg);
+	board_.add(pos);
 }
 void ofApp::endStroke(ofVec3f pos)
 {
-	stroke(pos);
+	board_.end(pos);
 	pen_.is_writing = false;
 }
-void ofApp::clear()
-{
-	ofxOscMessage msg;
-	msg.setAddress("/clear");
-	node_.sendMessage(msg);
-}
-
-void ofApp::newNodeFound(const std::pair<std::string, ofxSearchNetworkNode::Node> &node)
-{
-	if(node_.isSelfIp(node.first)) {
-		return;
-	}
-	if(log_.empty()) {
-		return;
-	}
-	ofxOscBundle bundle;
-	ofxOscMessage first_msg;
-	first_msg.setAddress("/bundle");
-	first_msg.addIntArg(log_.size());
-	bundle.addMessage(first_msg);
-	for(auto &msg : log_) {
-		bundle.addMessage(msg);
-	}
-	node_.sendBundle(node.first, bundle);
-}
 
 ofVec3f ofApp::getCurrentWorldPosition()
 {
@@ -186,6 +162,9 @@ void ofApp::keyPressed(int key){
 				startStroke(getCurrentWorldPosition());
 			}
 			break;
+		case 'e':
+			is_erasing_ = true;
+			break;
 	}
 }
 
@@ -195,6 +174,9 @@ void ofApp::keyReleased(int key){
 		case ' ':
 			endStroke(getCurrentWorldPosition());
 			break;
+		case 'e':
+			is_erasing_ = false;
+			break;
 	}
 }
 
@@ -2,6 +2,7 @@
 
 #include "ofMain.h"
 #include "ofxSearchNetworkNode.h"
+#include "ofxSNNWhiteboard.h"
 #include "ofxImGui.h"
 
 class ofApp : public ofBaseApp{
@@ -24,24 +25,23 @@ public:
 	void gotMessage(ofMessage msg);
 private:
 	ofxSearchNetworkNode node_;
+	ofxSNNWhiteboard board_;
 	ofxImGui::Gui gui_;
 	struct Pen {
 		ofFloatColor color=ofColor::black;
 		float width=4;
 		bool is_writing=false;
+		ofxSNNStrokeStream::Style getStyle() const;
 	} pen_;
 	ofEasyCam camera_;
+	bool is_erasing_=false;
 	ofVec3f getCurrentWorldPosition();
 
-	std::deque<ofxOscMessage> log_;
-	bool is_through_bundle_=false;
-	int bundle_length_=0;
-	void messageReceived(ofxOscMessage &msg);
-	void newNodeFound(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+	// draws random strokes locally, to see how the frame time scales with the history
+	void addBenchmarkStrokes(std::size_t num_strokes, std::size_t points_per_stroke);
 	
 	// create message
 	void startStroke(ofVec3f pos);
 	void stroke(ofVec3f pos);
 	void endStroke(ofVec3f pos);
-	void clear();
 };
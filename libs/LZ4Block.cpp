@@ -0,0 +1,173 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "LZ4Block.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	const size_t MIN_MATCH = 4;
+	const size_t LAST_LITERALS = 5;
+	const size_t MF_LIMIT = 12;
+	const size_t MAX_OFFSET = 65535;
+	const int HASH_LOG = 12;
+	
+	uint32_t read32(const uint8_t *p) {
+		uint32_t ret;
+		memcpy(&ret, p, sizeof(ret));
+		return ret;
+	}
+	uint32_t hashSequence(uint32_t sequence) {
+		return (sequence * 2654435761U) >> (32-HASH_LOG);
+	}
+	bool writeLength(uint8_t *&op, const uint8_t *oend, size_t length) {
+		while(length >= 255) {
+			if(op >= oend) { return false; }
+			*op++ = 255;
+			length -= 255;
+		}
+		if(op >= oend) { return false; }
+		*op++ = (uint8_t)length;
+		return true;
+	}
+	bool writeSequence(uint8_t *&op, const uint8_t *oend, const uint8_t *literal, size_t literal_length, size_t offset, size_t match_length) {
+		if(op >= oend) { return false; }
+		uint8_t *token = op++;
+		*token = (uint8_t)(min<size_t>(literal_length, 15) << 4);
+		if(literal_length >= 15 && !writeLength(op, oend, literal_length-15)) {
+			return false;
+		}
+		if((size_t)(oend-op) < literal_length) { return false; }
+		memcpy(op, literal, literal_length);
+		op += literal_length;
+		if(match_length == 0) {
+			return true;
+		}
+		if(oend-op < 2) { return false; }
+		*op++ = (uint8_t)(offset & 0xFF);
+		*op++ = (uint8_t)(offset >> 8);
+		size_t ml = match_length-MIN_MATCH;
+		*token |= (uint8_t)min<size_t>(ml, 15);
+		if(ml >= 15 && !writeLength(op, oend, ml-15)) {
+			return false;
+		}
+		return true;
+	}
+}
+
+size_t LZ4Block::compressBound(size_t src_size)
+{
+	return src_size + src_size/255 + 16;
+}
+
+size_t LZ4Block::compress(const char *src, size_t src_size, char *dst, size_t dst_capacity)
+{
+	const uint8_t *ip = reinterpret_cast<const uint8_t*>(src);
+	const uint8_t *base = ip;
+	const uint8_t *iend = ip + src_size;
+	const uint8_t *anchor = ip;
+	uint8_t *op = reinterpret_cast<uint8_t*>(dst);
+	const uint8_t *oend = op + dst_capacity;
+	
+	if(src_size >= MF_LIMIT) {
+		vector<uint32_t> table(1<<HASH_LOG, 0);
+		const uint8_t *mflimit = iend - MF_LIMIT;
+		const uint8_t *matchlimit = iend - LAST_LITERALS;
+		++ip;
+		while(ip < mflimit) {
+			uint32_t h = hashSequence(read32(ip));
+			const uint8_t *ref = base + table[h];
+			table[h] = (uint32_t)(ip-base);
+			if(ref >= ip || (size_t)(ip-ref) > MAX_OFFSET || read32(ref) != read32(ip)) {
+				++ip;
+				continue;
+			}
+			// extend backwards over pending literals
+			while(ip > anchor && ref > base && ip[-1] == ref[-1]) {
+				--ip;
+				--ref;
+			}
+			const uint8_t *match_end = ip + MIN_MATCH;
+			const uint8_t *r = ref + MIN_MATCH;
+			while(match_end < matchlimit && *match_end == *r) {
+				++match_end;
+				++r;
+			}
+			if(!writeSequence(op, oend, anchor, ip-anchor, ip-ref, match_end-ip)) {
+				return 0;
+			}
+			ip = anchor = match_end;
+		}
+	}
+	if(!writeSequence(op, oend, anchor, iend-anchor, 0, 0)) {
+		return 0;
+	}
+	return op - reinterpret_cast<uint8_t*>(dst);
+}
+
+size_t LZ4Block::decompress(const char *src, size_t src_size, char *dst, size_t dst_capacity)
+{
+	const uint8_t *ip = reinterpret_cast<const uint8_t*>(src);
+	const uint8_t *iend = ip + src_size;
+	uint8_t *op = reinterpret_cast<uint8_t*>(dst);
+	uint8_t *ostart = op;
+	uint8_t *oend = op + dst_capacity;
+	auto read_length = [&ip, iend](size_t &length) {
+		uint8_t b;
+		do {
+			if(ip >= iend) { return false; }
+			b = *ip++;
+			length += b;
+		} while(b == 255);
+		return true;
+	};
+	while(ip < iend) {
+		uint8_t token = *ip++;
+		size_t literal_length = token >> 4;
+		if(literal_length == 15 && !read_length(literal_length)) {
+			return 0;
+		}
+		if((size_t)(iend-ip) < literal_length || (size_t)(oend-op) < literal_length) {
+			return 0;
+		}
+		memcpy(op, ip, literal_length);
+		ip += literal_length;
+		op += literal_length;
+		if(ip == iend) {
+			break;
+		}
+		if(iend-ip < 2) { return 0; }
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if(offset == 0 || offset > (size_t)(op-ostart)) {
+			return 0;
+		}
+		size_t match_length = token & 0x0F;
+		if(match_length == 15 && !read_length(match_length)) {
+			return 0;
+		}
+		match_length += MIN_MATCH;
+		if((size_t)(oend-op) < match_length) {
+			return 0;
+		}
+		// byte by byte, matches may overlap the output
+		const uint8_t *ref = op - offset;
+		for(size_t i = 0; i < match_length; ++i) {
+			op[i] = ref[i];
+		}
+		op += match_length;
+	}
+	return op - ostart;
+}
@@ -0,0 +1,26 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+// minimal compressor for the LZ4 block format.
+// every call produces an independent block, so chunks can be decoded in any order.
+namespace LZ4Block
+{
+	std::size_t compressBound(std::size_t src_size);
+	// returns compressed size, or 0 if dst is too small
+	std::size_t compress(const char *src, std::size_t src_size, char *dst, std::size_t dst_capacity);
+	// returns decompressed size, or 0 if src is malformed or dst is too small
+	std::size_t decompress(const char *src, std::size_t src_size, char *dst, std::size_t dst_capacity);
+};
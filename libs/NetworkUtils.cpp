@@ -20,6 +20,10 @@ using namespace std;
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <net/if.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cstring>
 
 string NetworkUtils::getHostName()
 {
@@ -37,6 +41,7 @@ vector<NetworkUtils::IPv4Interface> NetworkUtils::getIPv4Interface()
 		return {};
 	}
 	vector<IPv4Interface> ret;
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
 	for(ifa = ifas; ifa != nullptr; ifa=ifa->ifa_next) {
 		if (ifa->ifa_addr->sa_family == AF_INET) {
 			IPv4Interface result;
@@ -56,13 +61,47 @@ vector<NetworkUtils::IPv4Interface> NetworkUtils::getIPv4Interface()
 				result.broadcast_raw = 0;
 				result.broadcast = "";
 			}
+			struct ifreq ifr = {};
+			strncpy(ifr.ifr_name, ifa->ifa_name, IFNAMSIZ-1);
+			result.mtu = (fd >= 0 && ioctl(fd, SIOCGIFMTU, &ifr) == 0) ? ifr.ifr_mtu : 0;
 			ret.push_back(result);
 		}
 	}
+	if(fd >= 0) {
+		close(fd);
+	}
 	freeifaddrs(ifas);
 	return ret;
 }
 
+unsigned int NetworkUtils::getPathMTU(const string &ip)
+{
+#if defined(TARGET_LINUX)
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(fd < 0) {
+		return 0;
+	}
+	// don't fragment, so the kernel keeps track of the discovered path MTU
+	int discover = IP_PMTUDISC_DO;
+	setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &discover, sizeof(discover));
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(9);
+	int mtu = 0;
+	if(inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) == 1
+	   && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+		socklen_t length = sizeof(mtu);
+		if(getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &length) != 0) {
+			mtu = 0;
+		}
+	}
+	close(fd);
+	return mtu > 0 ? mtu : 0;
+#else
+	return 0;
+#endif
+}
+
 bool NetworkUtils::IPv4Interface::isInSameNetwork(const string &hint) const
 {
 	return (ip_raw&netmask_raw) == (inet_addr(hint.c_str())&netmask_raw);
@@ -111,6 +150,7 @@ vector<NetworkUtils::IPv4Interface> NetworkUtils::getIPv4Interface()
 		get_address(addr, result.ip_raw, result.ip);
 		get_address(mask, result.netmask_raw, result.netmask);
 		get_address(addr|~mask, result.broadcast_raw, result.broadcast);
+		result.mtu = if_info->Mtu;
 		ret.push_back(result);
 		if_info = if_info->Next;
 	}
@@ -120,8 +160,10 @@ bool NetworkUtils::IPv4Interface::isInSameNetwork(const string &hint) const
 {
 	return (ip_raw&netmask_raw) == (inet_addr(hint.c_str())&netmask_raw);
 }
+unsigned int NetworkUtils::getPathMTU(const string &ip) { return 0; }
 #else
 string NetworkUtils::getHostName(){ return ""; }
 vector<NetworkUtils::IPv4Interface> NetworkUtils::getIPv4Interface() { return {}; }
 bool NetworkUtils::IPv4Interface::isInSameNetwork(const string &hint) const { return false; }
+unsigned int NetworkUtils::getPathMTU(const string &ip) { return 0; }
 #endif
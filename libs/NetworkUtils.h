@@ -21,8 +21,11 @@ namespace NetworkUtils
 		std::string name;
 		std::string ip, netmask, broadcast;
 		unsigned int ip_raw, netmask_raw, broadcast_raw;
+		unsigned int mtu;
 		bool isInSameNetwork(const std::string &hint) const;
 	};
 	std::string getHostName();
 	std::vector<IPv4Interface> getIPv4Interface();
+	// path MTU to the host as known by the OS, or 0 if unavailable on this platform
+	unsigned int getPathMTU(const std::string &ip);
 };
@@ -0,0 +1,163 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNAudioCodec.h"
+#include <cstring>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OFX_SNN_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OFX_SNN_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+size_t ofxSNNAudioCodecFloat32::encode(const float *src, size_t num_samples, char *dst)
+{
+	memcpy(dst, src, num_samples*sizeof(float));
+	return num_samples*sizeof(float);
+}
+bool ofxSNNAudioCodecFloat32::decode(const char *src, size_t size, float *dst, size_t num_samples)
+{
+	if(size < num_samples*sizeof(float)) {
+		return false;
+	}
+	memcpy(dst, src, num_samples*sizeof(float));
+	return true;
+}
+
+void ofxSNNAudioCodecInt16::floatToInt16(const float *src, int16_t *dst, size_t num_samples)
+{
+	size_t i = 0;
+#if defined(OFX_SNN_SSE2)
+	const __m128 scale = _mm_set1_ps(32767.f);
+	for(; i+8 <= num_samples; i += 8) {
+		// cvtps rounds to nearest and packs saturates, so no clamping is needed
+		__m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src+i), scale));
+		__m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src+i+4), scale));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i), _mm_packs_epi32(lo, hi));
+	}
+#elif defined(OFX_SNN_NEON)
+	const float32x4_t scale = vdupq_n_f32(32767.f);
+	const float32x4_t half = vdupq_n_f32(0.5f);
+	for(; i+8 <= num_samples; i += 8) {
+		float32x4_t a = vmulq_f32(vld1q_f32(src+i), scale);
+		float32x4_t b = vmulq_f32(vld1q_f32(src+i+4), scale);
+		// round half away from zero, the conversion itself truncates
+		a = vaddq_f32(a, vbslq_f32(vcltq_f32(a, vdupq_n_f32(0)), vnegq_f32(half), half));
+		b = vaddq_f32(b, vbslq_f32(vcltq_f32(b, vdupq_n_f32(0)), vnegq_f32(half), half));
+		int16x4_t lo = vqmovn_s32(vcvtq_s32_f32(a));
+		int16x4_t hi = vqmovn_s32(vcvtq_s32_f32(b));
+		vst1q_s16(dst+i, vcombine_s16(lo, hi));
+	}
+#endif
+	for(; i < num_samples; ++i) {
+		float sample = max(-1.f, min(1.f, src[i]))*32767.f;
+		dst[i] = static_cast<int16_t>(sample < 0 ? sample-0.5f : sample+0.5f);
+	}
+}
+void ofxSNNAudioCodecInt16::int16ToFloat(const int16_t *src, float *dst, size_t num_samples)
+{
+	size_t i = 0;
+	const float scale = 1.f/32767.f;
+#if defined(OFX_SNN_SSE2)
+	const __m128 scale4 = _mm_set1_ps(scale);
+	for(; i+8 <= num_samples; i += 8) {
+		__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+		// sign extend by unpacking into the upper half and shifting back
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+		_mm_storeu_ps(dst+i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale4));
+		_mm_storeu_ps(dst+i+4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale4));
+	}
+#elif defined(OFX_SNN_NEON)
+	for(; i+8 <= num_samples; i += 8) {
+		int16x8_t in = vld1q_s16(src+i);
+		vst1q_f32(dst+i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), scale));
+		vst1q_f32(dst+i+4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), scale));
+	}
+#endif
+	for(; i < num_samples; ++i) {
+		dst[i] = src[i]*scale;
+	}
+}
+size_t ofxSNNAudioCodecInt16::encode(const float *src, size_t num_samples, char *dst)
+{
+	// every platform openFrameworks runs on is little endian, so the wire format is the memory layout
+	floatToInt16(src, reinterpret_cast<int16_t*>(dst), num_samples);
+	return num_samples*sizeof(int16_t);
+}
+bool ofxSNNAudioCodecInt16::decode(const char *src, size_t size, float *dst, size_t num_samples)
+{
+	if(size < num_samples*sizeof(int16_t)) {
+		return false;
+	}
+	int16ToFloat(reinterpret_cast<const int16_t*>(src), dst, num_samples);
+	return true;
+}
+
+namespace {
+	const int MULAW_BIAS = 0x84;
+	const int MULAW_CLIP = 32635;
+	uint8_t linearToMuLaw(int16_t pcm) {
+		int sign = (pcm >> 8) & 0x80;
+		int sample = sign ? -(int)pcm : pcm;
+		sample = min(sample, MULAW_CLIP) + MULAW_BIAS;
+		int exponent = 7;
+		for(int mask = 0x4000; (sample & mask) == 0 && exponent > 0; mask >>= 1) {
+			--exponent;
+		}
+		int mantissa = (sample >> (exponent+3)) & 0x0F;
+		return ~(sign | (exponent << 4) | mantissa);
+	}
+	struct MuLawTable {
+		float value[256];
+		MuLawTable() {
+			for(int i = 0; i < 256; ++i) {
+				int code = ~i & 0xFF;
+				int exponent = (code >> 4) & 0x07;
+				int mantissa = code & 0x0F;
+				int sample = (((mantissa << 3) + MULAW_BIAS) << exponent) - MULAW_BIAS;
+				value[i] = ((code & 0x80) ? -sample : sample)/32767.f;
+			}
+		}
+	};
+	const MuLawTable& getMuLawTable() {
+		static MuLawTable table;
+		return table;
+	}
+}
+size_t ofxSNNAudioCodecMuLaw::encode(const float *src, size_t num_samples, char *dst)
+{
+	int16_t pcm[256];
+	for(size_t i = 0; i < num_samples; i += 256) {
+		size_t count = min<size_t>(256, num_samples-i);
+		ofxSNNAudioCodecInt16::floatToInt16(src+i, pcm, count);
+		for(size_t j = 0; j < count; ++j) {
+			dst[i+j] = static_cast<char>(linearToMuLaw(pcm[j]));
+		}
+	}
+	return num_samples;
+}
+bool ofxSNNAudioCodecMuLaw::decode(const char *src, size_t size, float *dst, size_t num_samples)
+{
+	if(size < num_samples) {
+		return false;
+	}
+	const MuLawTable &table = getMuLawTable();
+	for(size_t i = 0; i < num_samples; ++i) {
+		dst[i] = table.value[static_cast<uint8_t>(src[i])];
+	}
+	return true;
+}
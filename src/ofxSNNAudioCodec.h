@@ -0,0 +1,77 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// encodes a packet of interleaved float samples for /audio.
+// the id travels with every packet so the receiver picks the matching decoder.
+// an instance is used for one stream only, so stateful codecs can keep their state in it.
+class ofxSNNAudioCodec
+{
+public:
+	enum Id {
+		FLOAT32 = 0,
+		INT16 = 1,
+		MULAW = 2,
+		// ids from here are free for user codecs
+		USER = 64,
+	};
+	virtual ~ofxSNNAudioCodec() {}
+	virtual int getId() const=0;
+	virtual std::string getName() const=0;
+	virtual std::size_t getMaxEncodedSize(std::size_t num_samples) const=0;
+	// returns the size written to dst
+	virtual std::size_t encode(const float *src, std::size_t num_samples, char *dst)=0;
+	// returns false if size doesn't hold num_samples
+	virtual bool decode(const char *src, std::size_t size, float *dst, std::size_t num_samples)=0;
+};
+
+// raw native floats, the format /audio always used
+class ofxSNNAudioCodecFloat32 : public ofxSNNAudioCodec
+{
+public:
+	int getId() const override { return FLOAT32; }
+	std::string getName() const override { return "float32"; }
+	std::size_t getMaxEncodedSize(std::size_t num_samples) const override { return num_samples*sizeof(float); }
+	std::size_t encode(const float *src, std::size_t num_samples, char *dst) override;
+	bool decode(const char *src, std::size_t size, float *dst, std::size_t num_samples) override;
+};
+
+// 16bit little endian PCM. half the size of float32 at no audible cost
+class ofxSNNAudioCodecInt16 : public ofxSNNAudioCodec
+{
+public:
+	int getId() const override { return INT16; }
+	std::string getName() const override { return "int16"; }
+	std::size_t getMaxEncodedSize(std::size_t num_samples) const override { return num_samples*sizeof(int16_t); }
+	std::size_t encode(const float *src, std::size_t num_samples, char *dst) override;
+	bool decode(const char *src, std::size_t size, float *dst, std::size_t num_samples) override;
+
+	// vectorized with SSE2 or NEON where available
+	static void floatToInt16(const float *src, int16_t *dst, std::size_t num_samples);
+	static void int16ToFloat(const int16_t *src, float *dst, std::size_t num_samples);
+};
+
+// G.711 mu-law, 8bit per sample. a quarter of float32, telephone quality
+class ofxSNNAudioCodecMuLaw : public ofxSNNAudioCodec
+{
+public:
+	int getId() const override { return MULAW; }
+	std::string getName() const override { return "mu-law"; }
+	std::size_t getMaxEncodedSize(std::size_t num_samples) const override { return num_samples; }
+	std::size_t encode(const float *src, std::size_t num_samples, char *dst) override;
+	bool decode(const char *src, std::size_t size, float *dst, std::size_t num_samples) override;
+};
@@ -0,0 +1,139 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNAudioMixer.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__AVX__)
+#define OFX_SNN_AVX
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OFX_SNN_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OFX_SNN_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+void ofxSNNAudioMixer::mixAdd(float *dst, const float *src, size_t num_samples, float gain)
+{
+	size_t i = 0;
+#if defined(OFX_SNN_AVX)
+	const __m256 gain8 = _mm256_set1_ps(gain);
+	for(; i+8 <= num_samples; i += 8) {
+		_mm256_storeu_ps(dst+i, _mm256_add_ps(_mm256_loadu_ps(dst+i), _mm256_mul_ps(_mm256_loadu_ps(src+i), gain8)));
+	}
+#endif
+#if defined(OFX_SNN_SSE)
+	const __m128 gain4 = _mm_set1_ps(gain);
+	for(; i+4 <= num_samples; i += 4) {
+		_mm_storeu_ps(dst+i, _mm_add_ps(_mm_loadu_ps(dst+i), _mm_mul_ps(_mm_loadu_ps(src+i), gain4)));
+	}
+#elif defined(OFX_SNN_NEON)
+	for(; i+4 <= num_samples; i += 4) {
+		vst1q_f32(dst+i, vmlaq_n_f32(vld1q_f32(dst+i), vld1q_f32(src+i), gain));
+	}
+#endif
+	for(; i < num_samples; ++i) {
+		dst[i] += src[i]*gain;
+	}
+}
+
+void ofxSNNAudioMixer::softClip(float *samples, size_t num_samples)
+{
+	// above the knee, the overshoot goes through a rational approximation of tanh, u(27+u^2)/(27+9u^2),
+	// which has unity slope at 0 and reaches 1 at u=3
+	const float knee = 0.5f;
+	const float range = 1-knee;
+	size_t i = 0;
+#if defined(OFX_SNN_SSE)
+	const __m128 sign_mask = _mm_set1_ps(-0.f);
+	const __m128 knee4 = _mm_set1_ps(knee), range4 = _mm_set1_ps(range), inv_range4 = _mm_set1_ps(1/range);
+	const __m128 zero = _mm_setzero_ps(), limit = _mm_set1_ps(3.f);
+	const __m128 c27 = _mm_set1_ps(27.f), c9 = _mm_set1_ps(9.f);
+	for(; i+4 <= num_samples; i += 4) {
+		__m128 x = _mm_loadu_ps(samples+i);
+		__m128 sign = _mm_and_ps(x, sign_mask);
+		__m128 a = _mm_andnot_ps(sign_mask, x);
+		__m128 u = _mm_min_ps(limit, _mm_mul_ps(_mm_max_ps(zero, _mm_sub_ps(a, knee4)), inv_range4));
+		__m128 u2 = _mm_mul_ps(u, u);
+		__m128 r = _mm_div_ps(_mm_mul_ps(u, _mm_add_ps(c27, u2)), _mm_add_ps(c27, _mm_mul_ps(c9, u2)));
+		__m128 y = _mm_add_ps(_mm_min_ps(a, knee4), _mm_mul_ps(range4, r));
+		_mm_storeu_ps(samples+i, _mm_or_ps(y, sign));
+	}
+#elif defined(OFX_SNN_NEON)
+	const float32x4_t knee4 = vdupq_n_f32(knee), zero = vdupq_n_f32(0), limit = vdupq_n_f32(3.f);
+	const float32x4_t c27 = vdupq_n_f32(27.f), c9 = vdupq_n_f32(9.f);
+	for(; i+4 <= num_samples; i += 4) {
+		float32x4_t x = vld1q_f32(samples+i);
+		float32x4_t a = vabsq_f32(x);
+		float32x4_t u = vminq_f32(limit, vmulq_n_f32(vmaxq_f32(zero, vsubq_f32(a, knee4)), 1/range));
+		float32x4_t u2 = vmulq_f32(u, u);
+		float32x4_t num = vmulq_f32(u, vaddq_f32(c27, u2));
+		float32x4_t den = vmlaq_f32(c27, c9, u2);
+		// reciprocal estimate refined twice is close enough to a division here
+		float32x4_t inv = vrecpeq_f32(den);
+		inv = vmulq_f32(vrecpsq_f32(den, inv), inv);
+		inv = vmulq_f32(vrecpsq_f32(den, inv), inv);
+		float32x4_t y = vmlaq_n_f32(vminq_f32(a, knee4), vmulq_f32(num, inv), range);
+		vst1q_f32(samples+i, vbslq_f32(vcltq_f32(x, zero), vnegq_f32(y), y));
+	}
+#endif
+	for(; i < num_samples; ++i) {
+		float a = abs(samples[i]);
+		float u = min(3.f, max(0.f, a-knee)/range);
+		float u2 = u*u;
+		float y = min(a, knee) + range*u*(27+u2)/(27+9*u2);
+		samples[i] = samples[i] < 0 ? -y : y;
+	}
+}
+
+void ofxSNNResampler::setup(int num_channels)
+{
+	num_channels_ = num_channels;
+	last_.assign(num_channels, 0);
+	reset();
+}
+void ofxSNNResampler::reset()
+{
+	position_ = 0;
+	has_last_ = false;
+}
+size_t ofxSNNResampler::process(const float *src, size_t num_frames, vector<float> &dst)
+{
+	if(num_frames == 0) {
+		return 0;
+	}
+	size_t channels = num_channels_;
+	size_t count = 0;
+	if(!has_last_) {
+		position_ = max(position_, 0.);
+	}
+	while(position_ < num_frames-1) {
+		long index = (long)floor(position_);
+		float t = position_-index;
+		const float *a = index < 0 ? last_.data() : src + index*channels;
+		const float *b = src + (index+1)*channels;
+		for(size_t c = 0; c < channels; ++c) {
+			dst.push_back(a[c] + (b[c]-a[c])*t);
+		}
+		++count;
+		position_ += ratio_;
+	}
+	position_ -= num_frames;
+	copy(src + (num_frames-1)*channels, src + num_frames*channels, last_.data());
+	has_last_ = true;
+	return count;
+}
@@ -0,0 +1,49 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// mixing kernels for the audio thread. vectorized with AVX, SSE or NEON where available.
+// none of them lock nor allocate.
+class ofxSNNAudioMixer
+{
+public:
+	// dst[i] += src[i]*gain
+	static void mixAdd(float *dst, const float *src, std::size_t num_samples, float gain);
+	// leaves samples below 0.5 untouched and saturates the rest smoothly, reaching +-1 at +-2
+	static void softClip(float *samples, std::size_t num_samples);
+};
+
+// converts the sample rate of a continuous stream by linear interpolation.
+// keeps the position between calls so packets join without clicks.
+class ofxSNNResampler
+{
+public:
+	void setup(int num_channels);
+	void reset();
+	// input frames per output frame
+	void setRatio(double ratio) { ratio_ = ratio; }
+	double getRatio() const { return ratio_; }
+	// appends the output to dst and returns the number of frames appended
+	std::size_t process(const float *src, std::size_t num_frames, std::vector<float> &dst);
+private:
+	int num_channels_=1;
+	double ratio_=1;
+	// position of the next output frame, relative to the first input frame of the next call.
+	// -1 means between the last frame of the previous call and the first one of the next
+	double position_=0;
+	bool has_last_=false;
+	std::vector<float> last_;
+};
@@ -0,0 +1,502 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNAudioStream.h"
+#include "ofLog.h"
+#include "ofUtils.h"
+#include <cmath>
+#include <limits>
+#include <chrono>
+
+using namespace std;
+
+namespace {
+	// dB bonus that keeps current talkers selected until someone is clearly louder
+	const float TALKER_HYSTERESIS = 3;
+	float getLevel(const float *samples, size_t num_samples) {
+		float sum = 0;
+		for(size_t i = 0; i < num_samples; ++i) {
+			sum += samples[i]*samples[i];
+		}
+		return 10*log10(sum/num_samples + 1e-12f);
+	}
+	// rises at once and falls slowly, so pauses between words don't lose the selection
+	float smoothLevel(float current, float level) {
+		return level > current ? level : current + (level-current)*0.1f;
+	}
+}
+
+ofxSNNAudioStream::~ofxSNNAudioStream()
+{
+	if(send_thread_.joinable()) {
+		is_sending_ = false;
+		send_thread_.join();
+	}
+	if(node_) {
+		ofRemoveListener(ofEvents().update, this, &ofxSNNAudioStream::update);
+		ofRemoveListener(node_->unhandledMessageReceived, this, &ofxSNNAudioStream::messageReceived);
+		ofRemoveListener(node_->nodeDisconnected, this, &ofxSNNAudioStream::nodeDisconnected);
+	}
+}
+void ofxSNNAudioStream::setup(ofxSearchNetworkNode &node, const Settings &settings)
+{
+	if(node_) {
+		ofLogWarning("ofxSNNAudioStream") << "setup can be called only once";
+		return;
+	}
+	node_ = &node;
+	settings_ = settings;
+	size_t ring_size = settings_.sample_rate*settings_.buffer_length*settings_.num_channels;
+	size_t block_size = settings_.max_block_frames*settings_.num_channels;
+	ofxSNNJitterBuffer::Settings jitter;
+	jitter.num_channels = settings_.num_channels;
+	jitter.sample_rate = settings_.sample_rate;
+	jitter.num_slots = settings_.sample_rate*settings_.buffer_length/settings_.frames_per_packet;
+	jitter.max_packet_frames = settings_.max_packet_frames;
+	jitter.min_delay = settings_.min_delay;
+	jitter.max_delay = settings_.max_delay;
+	peers_.resize(settings_.max_peers);
+	for(auto &peer : peers_) {
+		peer.reset(new Peer());
+		peer->jitter.setup(jitter);
+		peer->resampler.setup(settings_.num_channels);
+	}
+	send_ring_.allocate(ring_size);
+	segment_ring_.allocate(256);
+	monitor_ring_.allocate(block_size*2);
+	in_scratch_.resize(block_size);
+	out_scratch_.resize(block_size);
+	mix_scratch_.resize(block_size);
+	packet_scratch_.resize(settings_.frames_per_packet*settings_.num_channels);
+	addCodec(ofxSNNAudioCodec::FLOAT32, []() { return unique_ptr<ofxSNNAudioCodec>(new ofxSNNAudioCodecFloat32()); });
+	addCodec(ofxSNNAudioCodec::INT16, []() { return unique_ptr<ofxSNNAudioCodec>(new ofxSNNAudioCodecInt16()); });
+	addCodec(ofxSNNAudioCodec::MULAW, []() { return unique_ptr<ofxSNNAudioCodec>(new ofxSNNAudioCodecMuLaw()); });
+	setCodec(settings_.codec);
+	if(settings_.send_thread) {
+		is_sending_ = true;
+		send_thread_ = thread(&ofxSNNAudioStream::sendThread, this);
+	}
+	ofAddListener(ofEvents().update, this, &ofxSNNAudioStream::update);
+	ofAddListener(node_->unhandledMessageReceived, this, &ofxSNNAudioStream::messageReceived);
+	ofAddListener(node_->nodeDisconnected, this, &ofxSNNAudioStream::nodeDisconnected);
+}
+
+void ofxSNNAudioStream::setCodec(int id)
+{
+	auto found = codecs_.find(id);
+	if(found == end(codecs_)) {
+		ofLogWarning("ofxSNNAudioStream") << "unknown codec : " << id;
+		return;
+	}
+	// the sending side picks it up with the next packet
+	codec_.store(id, memory_order_relaxed);
+}
+
+void ofxSNNAudioStream::audioIn(const ofSoundBuffer &buffer)
+{
+	size_t frames = buffer.getNumFrames();
+	int64_t capture_frame = capture_frames_;
+	capture_frames_ += frames;
+	if(!detectVoice(buffer)) {
+		is_segment_open_ = false;
+		return;
+	}
+	size_t channels = settings_.num_channels;
+	if(send_ring_.getWriteAvailable() < frames*channels) {
+		input_overruns_.fetch_add(1, memory_order_relaxed);
+		is_segment_open_ = false;
+		return;
+	}
+	// tells update where in the capture clock the samples after a gap start
+	if(!is_segment_open_) {
+		Segment segment{samples_written_, capture_frame};
+		if(segment_ring_.write(&segment, 1) == 0) {
+			input_overruns_.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+		is_segment_open_ = true;
+	}
+	const auto &data = buffer.getBuffer();
+	size_t in_channels = buffer.getNumChannels();
+	size_t max_frames = in_scratch_.size()/channels;
+	for(size_t offset = 0; offset < frames; offset += max_frames) {
+		size_t count = min(max_frames, frames-offset);
+		for(size_t i = 0; i < count; ++i) {
+			for(size_t c = 0; c < channels; ++c) {
+				in_scratch_[i*channels+c] = data[(offset+i)*in_channels + min(c, in_channels-1)];
+			}
+		}
+		send_ring_.write(in_scratch_.data(), count*channels);
+	}
+	samples_written_ += frames*channels;
+}
+bool ofxSNNAudioStream::detectVoice(const ofSoundBuffer &buffer)
+{
+	const auto &data = buffer.getBuffer();
+	if(data.empty()) {
+		return is_talking_.load(memory_order_relaxed);
+	}
+	float level = getLevel(data.data(), data.size());
+	float seconds = buffer.getNumFrames()/(float)settings_.sample_rate;
+	// the floor follows quiet blocks quickly and creeps up slowly, so that speech doesn't raise it
+	if(level < noise_floor_) {
+		noise_floor_ += (level-noise_floor_)*0.5f;
+	}
+	else {
+		noise_floor_ += min(level-noise_floor_, seconds);
+	}
+	bool speech = level > noise_floor_+settings_.vad_threshold && level > -70;
+	hangover_left_ = speech ? settings_.vad_hangover : max(0.f, hangover_left_-seconds);
+	bool talking = !vad_enabled_.load(memory_order_relaxed) || speech || hangover_left_ > 0;
+	is_talking_.store(talking, memory_order_relaxed);
+	return talking;
+}
+
+void ofxSNNAudioStream::audioOut(ofSoundBuffer &buffer)
+{
+	size_t channels = settings_.num_channels;
+	size_t out_channels = buffer.getNumChannels();
+	size_t frames = buffer.getNumFrames();
+	size_t max_frames = out_scratch_.size()/channels;
+	auto &data = buffer.getBuffer();
+	for(auto &peer : peers_) {
+		int expected = RETIRING;
+		peer->state.compare_exchange_strong(expected, FREE, memory_order_acq_rel);
+	}
+	bool monitor = monitor_ring_.getWriteAvailable() >= frames*channels;
+	for(size_t offset = 0; offset < frames; offset += max_frames) {
+		size_t count = min(max_frames, frames-offset);
+		float *mix = mix_scratch_.data();
+		fill(mix, mix+count*channels, 0.f);
+		for(auto &peer : peers_) {
+			if(peer->state.load(memory_order_acquire) != ACTIVE) {
+				continue;
+			}
+			peer->jitter.read(out_scratch_.data(), count);
+			ofxSNNAudioMixer::mixAdd(mix, out_scratch_.data(), count*channels, peer->gain.load(memory_order_relaxed));
+		}
+		ofxSNNAudioMixer::softClip(mix, count*channels);
+		if(monitor) {
+			monitor_ring_.write(mix, count*channels);
+		}
+		for(size_t i = 0; i < count; ++i) {
+			for(size_t c = 0; c < out_channels; ++c) {
+				data[(offset+i)*out_channels+c] = mix[i*channels + min(c, channels-1)];
+			}
+		}
+	}
+}
+
+void ofxSNNAudioStream::update(ofEventArgs&)
+{
+	float now = ofGetElapsedTimef();
+	float delta_time = ofGetLastFrameTime();
+	updateTalkers(now);
+	for(const auto &p : peer_index_) {
+		auto stats = p.second->jitter.getStats();
+		// nothing to hold flat while it is buffering
+		if(stats.delay > 0) {
+			drifts_[p.first].updateDelay(stats.delay, stats.target_delay, delta_time);
+		}
+	}
+	if(!send_thread_.joinable()) {
+		sendPackets();
+	}
+	send_rate_.update(bytes_sent_.load(memory_order_relaxed), delta_time);
+	for(auto &p : peer_index_) {
+		p.second->rate.update(p.second->bytes_received, delta_time);
+	}
+}
+void ofxSNNAudioStream::sendPackets()
+{
+	int codec = codec_.load(memory_order_relaxed);
+	if(!encoder_ || encoder_->getId() != codec) {
+		encoder_ = codecs_[codec]();
+		encode_scratch_.resize(encoder_->getMaxEncodedSize(packet_scratch_.size()));
+	}
+	Segment segment;
+	while(segment_ring_.read(&segment, 1) > 0) {
+		segments_.push_back(segment);
+	}
+	size_t packet_size = packet_scratch_.size();
+	while(send_ring_.getReadAvailable() >= packet_size) {
+		while(segments_.size() > 1 && segments_[1].ring_position <= samples_read_) {
+			segments_.pop_front();
+		}
+		int64_t timestamp = segments_.empty() ? 0 : segments_.front().capture_frame + (samples_read_-segments_.front().ring_position)/settings_.num_channels;
+		send_ring_.read(packet_scratch_.data(), packet_size);
+		samples_read_ += packet_size;
+		float level = getLevel(packet_scratch_.data(), packet_size);
+		self_level_ = smoothLevel(self_level_, level);
+		self_level_published_.store(self_level_, memory_order_relaxed);
+		// stay quiet while enough louder talkers are heard. the margin keeps the selection from flapping
+		float margin = is_self_selected_ ? TALKER_HYSTERESIS : 0;
+		is_self_selected_ = self_level_+margin >= louder_level_.load(memory_order_relaxed);
+		if(!is_self_selected_) {
+			packets_suppressed_.fetch_add(1, memory_order_relaxed);
+			continue;
+		}
+		ofxOscMessage msg;
+		msg.setAddress(address_);
+		msg.addInt32Arg(settings_.frames_per_packet);
+		msg.addInt32Arg(settings_.num_channels);
+		msg.addInt32Arg(settings_.sample_rate);
+		size_t size = encoder_->encode(packet_scratch_.data(), packet_size, encode_scratch_.data());
+		ofBuffer blob;
+		blob.set(encode_scratch_.data(), size);
+		msg.addBlobArg(blob);
+		msg.addInt32Arg(send_seq_++);
+		msg.addInt32Arg(encoder_->getId());
+		msg.addFloatArg(level);
+		msg.addInt64Arg(timestamp);
+		node_->sendMessage(msg);
+		packets_sent_.fetch_add(1, memory_order_relaxed);
+		bytes_sent_.fetch_add(size, memory_order_relaxed);
+	}
+}
+void ofxSNNAudioStream::sendThread()
+{
+	while(is_sending_.load(memory_order_relaxed)) {
+		sendPackets();
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+void ofxSNNAudioStream::RateMeter::update(uint64_t bytes, float delta_time)
+{
+	elapsed += delta_time;
+	if(elapsed >= 1) {
+		bytes_per_sec = (bytes-last_bytes)/elapsed;
+		last_bytes = bytes;
+		elapsed = 0;
+	}
+}
+void ofxSNNAudioStream::messageReceived(ofxOscMessage &msg)
+{
+	if(msg.getAddress() != address_) {
+		return;
+	}
+	size_t frames = msg.getArgAsInt32(0);
+	size_t in_channels = msg.getArgAsInt32(1);
+	int sample_rate = msg.getArgAsInt32(2);
+	const ofBuffer &blob = msg.getArgAsBlob(3);
+	int32_t seq = msg.getArgAsInt32(4);
+	int codec = msg.getNumArgs() > 5 ? msg.getArgAsInt32(5) : (int)ofxSNNAudioCodec::FLOAT32;
+	float level = msg.getNumArgs() > 6 ? msg.getArgAsFloat(6) : 0.f;
+	int64_t timestamp = msg.getNumArgs() > 7 ? msg.getArgAsInt64(7) : (int64_t)seq*frames;
+	if(in_channels == 0 || in_channels > (size_t)settings_.max_packet_channels || sample_rate <= 0 || frames > (size_t)settings_.max_packet_frames) {
+		ofLogWarning("ofxSNNAudioStream") << "received broken packet from " << msg.getRemoteHost();
+		return;
+	}
+	if(codecs_.find(codec) == end(codecs_)) {
+		if(find(begin(unknown_codecs_), end(unknown_codecs_), codec) == end(unknown_codecs_)) {
+			ofLogWarning("ofxSNNAudioStream") << "received packets of unknown codec : " << codec;
+			unknown_codecs_.push_back(codec);
+		}
+		return;
+	}
+	float now = ofGetElapsedTimef();
+	double arrival_time = ofGetElapsedTimeMicros()/1000000.;
+	auto &drift = drifts_[msg.getRemoteHost()];
+	drift.addPacket(timestamp/(double)sample_rate, arrival_time);
+	auto found = talkers_.find(msg.getRemoteHost());
+	Talker &talker = talkers_[msg.getRemoteHost()];
+	talker.level = smoothLevel(talker.level, level);
+	talker.last_heard = now;
+	if(found == end(talkers_)) {
+		updateTalkers(now);
+	}
+	// neither decoded nor mixed unless among the loudest
+	if(!talker.selected) {
+		return;
+	}
+	Peer *peer = acquirePeer(msg.getRemoteHost());
+	if(!peer) {
+		return;
+	}
+	auto &decoder = peer->decoders[codec];
+	if(!decoder) {
+		decoder = codecs_[codec]();
+	}
+	decode_scratch_.resize(frames*in_channels);
+	if(!decoder->decode(blob.getData(), blob.size(), decode_scratch_.data(), decode_scratch_.size())) {
+		ofLogWarning("ofxSNNAudioStream") << "received broken packet from " << msg.getRemoteHost();
+		return;
+	}
+	peer->codec = codec;
+	peer->bytes_received += blob.size();
+	size_t channels = settings_.num_channels;
+	const float *data = decode_scratch_.data();
+	recv_scratch_.resize(frames*channels);
+	for(size_t i = 0; i < frames; ++i) {
+		for(size_t c = 0; c < channels; ++c) {
+			recv_scratch_[i*channels+c] = data[i*in_channels + min(c, in_channels-1)];
+		}
+	}
+	// converts the nominal rate and follows the drift of the sender's clock at once
+	double ratio = sample_rate/(double)settings_.sample_rate;
+	peer->resampler.setRatio(ratio*drift.getRatioCorrection());
+	resample_scratch_.clear();
+	size_t resampled = peer->resampler.process(recv_scratch_.data(), frames, resample_scratch_);
+	peer->jitter.write(seq, (int64_t)(timestamp/ratio), resample_scratch_.data(), resampled, arrival_time);
+}
+void ofxSNNAudioStream::nodeDisconnected(const pair<string,ofxSearchNetworkNode::Node> &node)
+{
+	talkers_.erase(node.first);
+	drifts_.erase(node.first);
+	retirePeer(node.first);
+}
+
+void ofxSNNAudioStream::updateTalkers(float now)
+{
+	for(auto it = begin(talkers_); it != end(talkers_);) {
+		if(now-it->second.last_heard > talker_timeout_) {
+			retirePeer(it->first);
+			it = talkers_.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	vector<pair<float, string>> order;
+	for(const auto &t : talkers_) {
+		order.push_back(make_pair(t.second.level + (t.second.selected ? TALKER_HYSTERESIS : 0), t.first));
+	}
+	sort(begin(order), end(order), greater<pair<float, string>>());
+	for(size_t i = 0; i < order.size(); ++i) {
+		Talker &talker = talkers_[order[i].second];
+		bool selected = settings_.max_talkers <= 0 || i < (size_t)settings_.max_talkers;
+		if(talker.selected && !selected) {
+			retirePeer(order[i].second);
+		}
+		talker.selected = selected;
+	}
+	// the level our own packets have to reach to be sent
+	vector<float> others;
+	for(const auto &t : talkers_) {
+		if(!node_->isSelfIp(t.first)) {
+			others.push_back(t.second.level);
+		}
+	}
+	float louder = numeric_limits<float>::lowest();
+	size_t max_talkers = settings_.max_talkers;
+	if(max_talkers > 0 && others.size() >= max_talkers) {
+		nth_element(begin(others), begin(others)+max_talkers-1, end(others), greater<float>());
+		louder = others[max_talkers-1];
+	}
+	louder_level_.store(louder, memory_order_relaxed);
+}
+
+ofxSNNAudioStream::Peer* ofxSNNAudioStream::acquirePeer(const string &ip)
+{
+	auto found = peer_index_.find(ip);
+	if(found != end(peer_index_)) {
+		return found->second;
+	}
+	for(auto &peer : peers_) {
+		if(peer->state.load(memory_order_acquire) == FREE) {
+			peer->ip = ip;
+			peer->jitter.reset();
+			peer->resampler.reset();
+			auto gain = gains_.find(ip);
+			peer->gain.store(gain == end(gains_) ? 1.f : gain->second, memory_order_relaxed);
+			peer->decoders.clear();
+			peer->codec = -1;
+			peer->bytes_received = 0;
+			peer->rate = RateMeter();
+			peer->state.store(ACTIVE, memory_order_release);
+			peer_index_.insert(make_pair(ip, peer.get()));
+			return peer.get();
+		}
+	}
+	ofLogWarning("ofxSNNAudioStream") << "no room for " << ip << ", increase Settings::max_peers";
+	return nullptr;
+}
+void ofxSNNAudioStream::retirePeer(const string &ip)
+{
+	auto found = peer_index_.find(ip);
+	if(found == end(peer_index_)) {
+		return;
+	}
+	// the audio thread marks it FREE once it stopped reading the ring
+	found->second->state.store(RETIRING, memory_order_release);
+	peer_index_.erase(found);
+}
+
+void ofxSNNAudioStream::setGain(const string &ip, float gain)
+{
+	gains_[ip] = gain;
+	auto found = peer_index_.find(ip);
+	if(found != end(peer_index_)) {
+		found->second->gain.store(gain, memory_order_relaxed);
+	}
+}
+float ofxSNNAudioStream::getGain(const string &ip) const
+{
+	auto found = gains_.find(ip);
+	return found == end(gains_) ? 1.f : found->second;
+}
+
+ofxSNNAudioStream::Stats ofxSNNAudioStream::getStats() const
+{
+	Stats ret;
+	ret.input_overruns = input_overruns_.load(memory_order_relaxed);
+	ret.packets_sent = packets_sent_.load(memory_order_relaxed);
+	ret.bytes_sent = bytes_sent_.load(memory_order_relaxed);
+	ret.bytes_per_sec = send_rate_.bytes_per_sec;
+	ret.packets_suppressed = packets_suppressed_.load(memory_order_relaxed);
+	ret.is_talking = is_talking_.load(memory_order_relaxed);
+	ret.level = self_level_published_.load(memory_order_relaxed);
+	return ret;
+}
+ofxSNNAudioStream::PeerStats ofxSNNAudioStream::getPeerStats(const string &ip) const
+{
+	PeerStats ret;
+	auto talker = talkers_.find(ip);
+	if(talker != end(talkers_)) {
+		ret.level = talker->second.level;
+		ret.is_selected = talker->second.selected;
+	}
+	auto drift = drifts_.find(ip);
+	if(drift != end(drifts_)) {
+		ret.drift_ppm = drift->second.getDriftPpm();
+		ret.correction_ppm = drift->second.getCorrectionPpm();
+	}
+	auto found = peer_index_.find(ip);
+	if(found == end(peer_index_)) {
+		return ret;
+	}
+	const Peer &peer = *found->second;
+	static_cast<ofxSNNJitterBuffer::Stats&>(ret) = peer.jitter.getStats();
+	ret.codec = peer.codec;
+	ret.bytes_received = peer.bytes_received;
+	ret.bytes_per_sec = peer.rate.bytes_per_sec;
+	return ret;
+}
+vector<string> ofxSNNAudioStream::getPeers() const
+{
+	vector<string> ret;
+	for(const auto &p : talkers_) {
+		ret.push_back(p.first);
+	}
+	return ret;
+}
+void ofxSNNAudioStream::getMonitor(ofSoundBuffer &buffer, size_t num_frames)
+{
+	size_t channels = settings_.num_channels;
+	monitor_scratch_.resize(monitor_ring_.getReadAvailable());
+	monitor_scratch_.resize(monitor_ring_.read(monitor_scratch_.data(), monitor_scratch_.size()));
+	if(monitor_scratch_.empty()) {
+		return;
+	}
+	size_t count = min(num_frames*channels, monitor_scratch_.size());
+	buffer.copyFrom(monitor_scratch_.data() + monitor_scratch_.size()-count, count/channels, channels, settings_.sample_rate);
+}
@@ -0,0 +1,217 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofEvents.h"
+#include "ofSoundBuffer.h"
+#include "ofxSearchNetworkNode.h"
+#include "ofxSNNRingBuffer.h"
+#include "ofxSNNJitterBuffer.h"
+#include "ofxSNNAudioCodec.h"
+#include "ofxSNNAudioMixer.h"
+#include "ofxSNNDriftEstimator.h"
+#include <deque>
+#include <thread>
+#include <functional>
+#include <memory>
+
+// moves audio between the sound stream callbacks and the network.
+// audioIn and audioOut are real-time safe; they never lock nor allocate.
+// samples cross threads only through fixed capacity ring buffers and per-peer jitter buffers,
+// and packets are sent and received from the update event.
+class ofxSNNAudioStream
+{
+public:
+	struct Settings {
+		int num_channels=1;
+		int sample_rate=44100;
+		int frames_per_packet=256;
+		// capacity of each ring and jitter buffer in seconds
+		float buffer_length=1;
+		// largest packet accepted from peers
+		int max_packet_frames=1024;
+		int max_packet_channels=8;
+		// bounds of the adaptive playout delay in seconds
+		float min_delay=0.02f;
+		float max_delay=0.5f;
+		// peers that can be heard at the same time
+		int max_peers=16;
+		// largest block audioIn or audioOut will be called with
+		int max_block_frames=4096;
+		// ofxSNNAudioCodec::Id used for sending
+		int codec=ofxSNNAudioCodec::INT16;
+		// a block is speech when it is this many dB above the noise floor
+		float vad_threshold=9;
+		// keeps sending for this long after speech ends, in seconds
+		float vad_hangover=0.4f;
+		// only this many of the loudest talkers are sent and mixed. 0 for no limit
+		int max_talkers=4;
+		// sends each packet from a dedicated thread as soon as audioIn produces it,
+		// instead of waiting for the next update
+		bool send_thread=false;
+	};
+	struct Stats {
+		// audioIn couldn't push because update didn't drain the send ring in time
+		uint64_t input_overruns=0;
+		uint64_t packets_sent=0;
+		uint64_t bytes_sent=0;
+		// per receiver
+		float bytes_per_sec=0;
+		// not sent because enough louder talkers were heard
+		uint64_t packets_suppressed=0;
+		bool is_talking=false;
+		// dBFS
+		float level=-100;
+	};
+	struct PeerStats : ofxSNNJitterBuffer::Stats {
+		int codec=-1;
+		uint64_t bytes_received=0;
+		float bytes_per_sec=0;
+		float level=-100;
+		// among the loudest talkers, so being received and mixed
+		bool is_selected=false;
+		// estimated clock drift of the sender and the correction applied to the resampling
+		float drift_ppm=0;
+		float correction_ppm=0;
+	};
+	using CodecFactory = std::function<std::unique_ptr<ofxSNNAudioCodec>()>;
+
+	virtual ~ofxSNNAudioStream();
+	void setup(ofxSearchNetworkNode &node, const Settings &settings);
+	void setup(ofxSearchNetworkNode &node) { setup(node, Settings()); }
+	const Settings& getSettings() const { return settings_; }
+	// call before setup
+	void setAddress(const std::string &address) { address_ = address; }
+	// when disabled, every block is sent
+	void setVoiceActivityDetection(bool enabled) { vad_enabled_ = enabled; }
+	bool isVoiceActivityDetection() const { return vad_enabled_; }
+	void setMaxTalkers(int max_talkers) { settings_.max_talkers = max_talkers; }
+	// float32, int16 and mu-law are built in. register more before setup
+	void addCodec(int id, CodecFactory factory) { codecs_[id] = factory; }
+	void setCodec(int id);
+	int getCodec() const { return codec_; }
+
+	// call from the audio thread
+	void audioIn(const ofSoundBuffer &buffer);
+	// fills buffer with the mix of every peer, soft clipped.
+	// peers are resampled on arrival, both for another sample rate and for the drift of their clock
+	void audioOut(ofSoundBuffer &buffer);
+
+	// call from the main thread
+	void setGain(const std::string &ip, float gain);
+	float getGain(const std::string &ip) const;
+	Stats getStats() const;
+	PeerStats getPeerStats(const std::string &ip) const;
+	// everyone heard recently, selected or not
+	std::vector<std::string> getPeers() const;
+	// the latest output written by audioOut, up to num_frames
+	void getMonitor(ofSoundBuffer &buffer, std::size_t num_frames);
+private:
+	ofxSearchNetworkNode *node_=nullptr;
+	Settings settings_;
+	std::string address_="/audio";
+
+	// voice activity detection runs on the audio thread
+	std::atomic<bool> vad_enabled_{true};
+	std::atomic<bool> is_talking_{false};
+	float noise_floor_=-60;
+	float hangover_left_=0;
+	bool detectVoice(const ofSoundBuffer &buffer);
+
+	// main thread only
+	struct Talker {
+		float level=-100;
+		float last_heard=0;
+		bool selected=false;
+	};
+	std::map<std::string, Talker> talkers_;
+	// kept while the node is connected, as clocks drift across talk spurts
+	std::map<std::string, ofxSNNDriftEstimator> drifts_;
+	float talker_timeout_=0.5f;
+	void updateTalkers(float now);
+	// own packets quieter than this are held back
+	std::atomic<float> louder_level_{-100};
+
+	struct RateMeter {
+		uint64_t last_bytes=0;
+		float elapsed=0;
+		float bytes_per_sec=0;
+		void update(uint64_t bytes, float delta_time);
+	};
+
+	std::map<int, CodecFactory> codecs_;
+	std::atomic<int> codec_{-1};
+	std::vector<int> unknown_codecs_;
+
+	enum PeerState { FREE, ACTIVE, RETIRING };
+	struct Peer {
+		// written by the main thread while FREE, read by the audio thread while ACTIVE
+		std::atomic<int> state{FREE};
+		std::string ip;
+		ofxSNNJitterBuffer jitter;
+		std::atomic<float> gain{1};
+		// main thread only
+		ofxSNNResampler resampler;
+		std::map<int, std::unique_ptr<ofxSNNAudioCodec>> decoders;
+		int codec=-1;
+		uint64_t bytes_received=0;
+		RateMeter rate;
+	};
+	// allocated in setup and never resized, so the audio thread can walk it
+	std::vector<std::unique_ptr<Peer>> peers_;
+	// main thread only
+	std::map<std::string, Peer*> peer_index_;
+	std::map<std::string, float> gains_;
+	Peer* acquirePeer(const std::string &ip);
+	void retirePeer(const std::string &ip);
+
+	ofxSNNRingBuffer<float> send_ring_;
+	// packets are stamped with the capture clock, which keeps running while nothing is sent.
+	// a segment marks where the samples after such a gap start
+	struct Segment {
+		uint64_t ring_position;
+		int64_t capture_frame;
+	};
+	ofxSNNRingBuffer<Segment> segment_ring_;
+	// audio thread
+	int64_t capture_frames_=0;
+	uint64_t samples_written_=0;
+	bool is_segment_open_=false;
+
+	// the sending side, either update or the send thread
+	std::deque<Segment> segments_;
+	uint64_t samples_read_=0;
+	int32_t send_seq_=0;
+	std::unique_ptr<ofxSNNAudioCodec> encoder_;
+	std::vector<float> packet_scratch_;
+	std::vector<char> encode_scratch_;
+	float self_level_=-100;
+	bool is_self_selected_=false;
+	void sendPackets();
+	std::thread send_thread_;
+	std::atomic<bool> is_sending_{false};
+	void sendThread();
+	std::atomic<uint64_t> packets_sent_{0}, bytes_sent_{0}, packets_suppressed_{0};
+	std::atomic<float> self_level_published_{-100};
+	ofxSNNRingBuffer<float> monitor_ring_;
+	std::atomic<uint64_t> input_overruns_{0};
+	RateMeter send_rate_;
+
+	// scratch buffers owned by each thread
+	std::vector<float> in_scratch_, out_scratch_, mix_scratch_;
+	std::vector<float> recv_scratch_, decode_scratch_, resample_scratch_, monitor_scratch_;
+
+	void update(ofEventArgs&);
+	void messageReceived(ofxOscMessage &msg);
+	void nodeDisconnected(const std::pair<std::string,ofxSearchNetworkNode::Node> &node);
+};
@@ -0,0 +1,84 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNDriftEstimator.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+void ofxSNNDriftEstimator::reset()
+{
+	has_window_ = false;
+	history_.clear();
+	drift_ppm_ = 0;
+	delay_error_ = 0;
+}
+void ofxSNNDriftEstimator::addPacket(double timestamp, double arrival_time)
+{
+	double transit = arrival_time-timestamp;
+	// a jump this large is a restarted sender, not drift
+	if(has_window_ && abs(transit-window_min_) > 1) {
+		reset();
+	}
+	if(!has_window_) {
+		window_start_ = arrival_time;
+		window_min_ = transit;
+		has_window_ = true;
+		return;
+	}
+	window_min_ = min(window_min_, transit);
+	if(arrival_time-window_start_ >= settings_.window) {
+		history_.push_back(make_pair(window_start_, window_min_));
+		while(history_.size() > (size_t)settings_.history) {
+			history_.pop_front();
+		}
+		window_start_ = arrival_time;
+		window_min_ = transit;
+		fit();
+	}
+}
+void ofxSNNDriftEstimator::fit()
+{
+	if(history_.size() < 3 || history_.back().first-history_.front().first < settings_.min_span) {
+		return;
+	}
+	// least squares slope of the minimum transit over time
+	double t0 = history_.front().first;
+	double sum_t=0, sum_v=0, sum_tt=0, sum_tv=0;
+	for(const auto &h : history_) {
+		double t = h.first-t0;
+		sum_t += t;
+		sum_v += h.second;
+		sum_tt += t*t;
+		sum_tv += t*h.second;
+	}
+	double n = history_.size();
+	double denominator = n*sum_tt - sum_t*sum_t;
+	if(denominator <= 0) {
+		return;
+	}
+	double slope = (n*sum_tv - sum_t*sum_v)/denominator;
+	// a fast sender stamps ahead of real time, so its transit shrinks
+	drift_ppm_ = max(-settings_.max_ppm, min<float>(settings_.max_ppm, -slope*1000000));
+}
+void ofxSNNDriftEstimator::updateDelay(float delay, float target, float delta_time)
+{
+	// follows over a couple of seconds, smoothing the sawtooth of packet arrivals
+	float k = min(1.f, delta_time/2.f);
+	delay_error_ += (delay-target-delay_error_)*k;
+}
+float ofxSNNDriftEstimator::getCorrectionPpm() const
+{
+	float ppm = drift_ppm_ + delay_error_*settings_.delay_gain;
+	return max(-settings_.max_ppm, min(settings_.max_ppm, ppm));
+}
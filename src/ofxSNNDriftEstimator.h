@@ -0,0 +1,62 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <deque>
+#include <utility>
+
+// estimates how fast a sender's sample clock runs against the local one
+// and suggests a correction for the resampling ratio that keeps the playout delay flat.
+//
+// the drift is the slope of the minimum transit time (arrival minus sender timestamp) over windows,
+// fitted over a long history so that arrival jitter averages out.
+// a proportional term on the playout delay takes over until the history is long enough,
+// and removes the delay accumulated meanwhile.
+class ofxSNNDriftEstimator
+{
+public:
+	struct Settings {
+		// seconds over which the minimum transit is taken
+		float window=5;
+		// windows kept for the fit
+		int history=120;
+		// the fit is trusted after this many seconds
+		float min_span=60;
+		// ppm of correction per second of delay over the target
+		float delay_gain=2000;
+		float max_ppm=1000;
+	};
+	void setup(const Settings &settings) { settings_ = settings; reset(); }
+	void reset();
+
+	// timestamp in seconds of the sender's clock, arrival_time in seconds of the local one
+	void addPacket(double timestamp, double arrival_time);
+	// playout delay and its target in seconds, from the jitter buffer
+	void updateDelay(float delay, float target, float delta_time);
+
+	// positive when the sender runs fast
+	float getDriftPpm() const { return drift_ppm_; }
+	// multiply the resampling ratio (input frames per output frame) by this
+	double getRatioCorrection() const { return 1 + getCorrectionPpm()/1000000.; }
+	float getCorrectionPpm() const;
+private:
+	Settings settings_;
+	bool has_window_=false;
+	double window_start_=0;
+	double window_min_=0;
+	// (time, minimum transit)
+	std::deque<std::pair<double,double>> history_;
+	float drift_ppm_=0;
+	float delay_error_=0;
+	void fit();
+};
@@ -0,0 +1,222 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNJitterBuffer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+void ofxSNNJitterBuffer::setup(const Settings &settings)
+{
+	settings_ = settings;
+	num_slots_ = 1;
+	while(num_slots_ < (size_t)settings_.num_slots) {
+		num_slots_ <<= 1;
+	}
+	mask_ = num_slots_-1;
+	size_t packet_size = settings_.max_packet_frames*settings_.num_channels;
+	slots_.reset(new Slot[num_slots_]);
+	for(size_t i = 0; i < num_slots_; ++i) {
+		slots_[i].data.resize(packet_size);
+	}
+	last_.resize(packet_size);
+	reset();
+}
+void ofxSNNJitterBuffer::reset()
+{
+	for(size_t i = 0; i < num_slots_; ++i) {
+		slots_[i].seq.store(-1, memory_order_relaxed);
+	}
+	play_seq_ = -1;
+	latest_seq_ = -1;
+	reset_seq_ = -1;
+	packet_frames_ = 0;
+	target_frames_ = settings_.min_delay*settings_.sample_rate;
+	has_transit_ = false;
+	jitter_ = 0;
+	is_buffering_ = true;
+	offset_ = 0;
+	conceal_run_ = 0;
+	last_frames_ = 0;
+	received_ = played_ = late_ = concealed_ = dropped_ = overflows_ = underruns_ = 0;
+	jitter_seconds_ = delay_seconds_ = 0;
+}
+
+bool ofxSNNJitterBuffer::write(int64_t seq, int64_t timestamp, const float *data, size_t num_frames, double arrival_time)
+{
+	if(num_frames == 0 || num_frames > (size_t)settings_.max_packet_frames) {
+		return false;
+	}
+	received_.fetch_add(1, memory_order_relaxed);
+	int64_t latest = latest_seq_.load(memory_order_relaxed);
+	int64_t pending = reset_seq_.load(memory_order_acquire);
+	int64_t play = play_seq_.load(memory_order_acquire);
+	if(latest < 0 && pending < 0) {
+		// the first packet decides where to start
+		base_seq_ = pending = seq;
+		reset_seq_.store(seq, memory_order_release);
+	}
+	if(pending >= 0) {
+		// slots can't be touched until the reader has moved to the new position
+		if(play >= 0) {
+			return false;
+		}
+		play = base_seq_;
+	}
+	if(seq < play) {
+		late_.fetch_add(1, memory_order_relaxed);
+		// far behind means the sender has restarted
+		if(play-seq > (int64_t)num_slots_) {
+			resync(seq);
+		}
+		return false;
+	}
+	if(seq >= play+(int64_t)num_slots_) {
+		// the reader has stalled or the sender skipped ahead, e.g. while it was not selected
+		overflows_.fetch_add(1, memory_order_relaxed);
+		resync(seq);
+		return false;
+	}
+	Slot &slot = slots_[seq&mask_];
+	copy(data, data+num_frames*settings_.num_channels, slot.data.data());
+	slot.num_frames = num_frames;
+	slot.seq.store(seq, memory_order_release);
+	packet_frames_.store(num_frames, memory_order_relaxed);
+	if(seq > latest) {
+		latest_seq_.store(seq, memory_order_release);
+		// interarrival jitter in frames
+		double transit = arrival_time*settings_.sample_rate - timestamp;
+		if(has_transit_) {
+			jitter_ += (abs(transit-last_transit_) - jitter_)/16.;
+		}
+		last_transit_ = transit;
+		has_transit_ = true;
+		float target = num_frames + jitter_*4;
+		target = max<float>(target, settings_.min_delay*settings_.sample_rate);
+		target = min<float>(target, settings_.max_delay*settings_.sample_rate);
+		target_frames_.store(target, memory_order_relaxed);
+		jitter_seconds_.store(jitter_/settings_.sample_rate, memory_order_relaxed);
+	}
+	return true;
+}
+
+void ofxSNNJitterBuffer::resync(int64_t seq)
+{
+	base_seq_ = seq;
+	has_transit_ = false;
+	latest_seq_.store(seq-1, memory_order_relaxed);
+	reset_seq_.store(seq, memory_order_release);
+}
+
+void ofxSNNJitterBuffer::read(float *dst, size_t num_frames)
+{
+	size_t channels = settings_.num_channels;
+	int64_t reset_seq = reset_seq_.load(memory_order_acquire);
+	int64_t play = play_seq_.load(memory_order_relaxed);
+	if(reset_seq >= 0) {
+		play = reset_seq;
+		offset_ = 0;
+		is_buffering_ = true;
+		// publish the position before clearing the request, so the writer never sees neither
+		play_seq_.store(play, memory_order_release);
+		reset_seq_.compare_exchange_strong(reset_seq, -1, memory_order_acq_rel);
+	}
+	if(play < 0) {
+		fill(dst, dst+num_frames*channels, 0.f);
+		return;
+	}
+	int64_t latest = latest_seq_.load(memory_order_acquire);
+	size_t packet_frames = packet_frames_.load(memory_order_relaxed);
+	auto getDepth = [&]() -> float {
+		return latest < play ? 0 : (latest+1-play)*(float)packet_frames - offset_;
+	};
+	// the device block has to be covered besides the jitter
+	float target = max<float>(target_frames_.load(memory_order_relaxed), num_frames+packet_frames);
+	if(is_buffering_) {
+		if(getDepth() < target) {
+			fill(dst, dst+num_frames*channels, 0.f);
+			play_seq_.store(play, memory_order_release);
+			delay_seconds_.store(getDepth()/settings_.sample_rate, memory_order_relaxed);
+			return;
+		}
+		is_buffering_ = false;
+	}
+	// skip whole packets rather than letting the delay grow
+	if(getDepth() > target*2) {
+		while(getDepth() > target + packet_frames) {
+			++play;
+			offset_ = 0;
+			dropped_.fetch_add(1, memory_order_relaxed);
+		}
+	}
+	size_t written = 0;
+	while(written < num_frames) {
+		Slot &slot = slots_[play&mask_];
+		if(slot.seq.load(memory_order_acquire) == play) {
+			size_t count = min(slot.num_frames-min(offset_, slot.num_frames), num_frames-written);
+			copy(slot.data.data() + offset_*channels, slot.data.data() + (offset_+count)*channels, dst + written*channels);
+			written += count;
+			offset_ += count;
+			if(offset_ >= slot.num_frames) {
+				copy(slot.data.data(), slot.data.data() + slot.num_frames*channels, last_.data());
+				last_frames_ = slot.num_frames;
+				conceal_run_ = 0;
+				played_.fetch_add(1, memory_order_relaxed);
+				++play;
+				offset_ = 0;
+			}
+		}
+		else if(play < latest) {
+			// lost or still on the way while later ones are here.
+			// repeat the last packet, halving it every time in a row
+			float gain = conceal_run_ < 4 && last_frames_ > 0 ? 1.f/(1 << (conceal_run_+1)) : 0.f;
+			size_t frames = last_frames_ > 0 ? last_frames_ : packet_frames;
+			size_t count = min(frames-min(offset_, frames), num_frames-written);
+			for(size_t i = 0; i < count*channels; ++i) {
+				dst[written*channels+i] = last_[offset_*channels+i]*gain;
+			}
+			written += count;
+			offset_ += count;
+			if(offset_ >= frames) {
+				concealed_.fetch_add(1, memory_order_relaxed);
+				++conceal_run_;
+				++play;
+				offset_ = 0;
+			}
+		}
+		else {
+			underruns_.fetch_add(1, memory_order_relaxed);
+			fill(dst + written*channels, dst + num_frames*channels, 0.f);
+			is_buffering_ = true;
+			break;
+		}
+	}
+	play_seq_.store(play, memory_order_release);
+	delay_seconds_.store(getDepth()/settings_.sample_rate, memory_order_relaxed);
+}
+
+ofxSNNJitterBuffer::Stats ofxSNNJitterBuffer::getStats() const
+{
+	Stats ret;
+	ret.received = received_.load(memory_order_relaxed);
+	ret.played = played_.load(memory_order_relaxed);
+	ret.late = late_.load(memory_order_relaxed);
+	ret.concealed = concealed_.load(memory_order_relaxed);
+	ret.dropped = dropped_.load(memory_order_relaxed);
+	ret.overflows = overflows_.load(memory_order_relaxed);
+	ret.underruns = underruns_.load(memory_order_relaxed);
+	ret.jitter = jitter_seconds_.load(memory_order_relaxed);
+	ret.delay = delay_seconds_.load(memory_order_relaxed);
+	ret.target_delay = target_frames_.load(memory_order_relaxed)/settings_.sample_rate;
+	return ret;
+}
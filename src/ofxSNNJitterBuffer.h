@@ -0,0 +1,109 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// reorders incoming audio packets by sequence number and plays them out at an adaptive delay.
+// the target delay follows the interarrival jitter (RFC 3550, A.8),
+// packets are dropped when the delay grows too long,
+// and lost packets are concealed by fading out the last one.
+// write is called from one thread and read from another (typically the audio thread).
+// read never locks nor allocates.
+class ofxSNNJitterBuffer
+{
+public:
+	struct Settings {
+		int num_channels=1;
+		int sample_rate=44100;
+		// packets that can be held at the same time
+		int num_slots=256;
+		int max_packet_frames=1024;
+		// bounds of the target delay in seconds
+		float min_delay=0.02f;
+		float max_delay=0.5f;
+	};
+	struct Stats {
+		uint64_t received=0;
+		uint64_t played=0;
+		// arrived after their time to play
+		uint64_t late=0;
+		// played from the last packet because they didn't arrive in time
+		uint64_t concealed=0;
+		// skipped to bound the delay
+		uint64_t dropped=0;
+		// didn't fit because the reader fell behind
+		uint64_t overflows=0;
+		// ran out of packets while playing, which includes the end of every talk spurt
+		uint64_t underruns=0;
+		// in seconds
+		float jitter=0;
+		float delay=0;
+		float target_delay=0;
+		float getConcealmentRate() const {
+			return played+concealed > 0 ? concealed/(float)(played+concealed) : 0;
+		}
+	};
+	void setup(const Settings &settings);
+	// must be called while read is not running
+	void reset();
+
+	// writer side. data is interleaved with Settings::num_channels.
+	// timestamp is the sender's position of the first frame, and arrival_time is the local time in seconds.
+	bool write(int64_t seq, int64_t timestamp, const float *data, std::size_t num_frames, double arrival_time);
+
+	// reader side. fills num_frames interleaved frames, silence included.
+	void read(float *dst, std::size_t num_frames);
+
+	Stats getStats() const;
+private:
+	Settings settings_;
+	struct Slot {
+		std::atomic<int64_t> seq{-1};
+		std::size_t num_frames=0;
+		std::vector<float> data;
+	};
+	std::unique_ptr<Slot[]> slots_;
+	std::size_t num_slots_=0;
+	std::size_t mask_=0;
+
+	// owned by the reader, published for the writer
+	std::atomic<int64_t> play_seq_{-1};
+	// owned by the writer, published for the reader
+	std::atomic<int64_t> latest_seq_{-1};
+	std::atomic<int64_t> reset_seq_{-1};
+	std::atomic<std::size_t> packet_frames_{0};
+	std::atomic<float> target_frames_{0};
+
+	// writer state
+	int64_t base_seq_=0;
+	bool has_transit_=false;
+	double last_transit_=0;
+	double jitter_=0;
+	// asks the reader to restart from seq
+	void resync(int64_t seq);
+
+	// reader state
+	bool is_buffering_=true;
+	std::size_t offset_=0;
+	int conceal_run_=0;
+	std::size_t last_frames_=0;
+	std::vector<float> last_;
+
+	std::atomic<uint64_t> received_{0}, played_{0}, late_{0}, concealed_{0}, dropped_{0}, overflows_{0}, underruns_{0};
+	std::atomic<float> jitter_seconds_{0}, delay_seconds_{0};
+};
@@ -0,0 +1,115 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNMessageLog.h"
+#include "ofLog.h"
+#include <algorithm>
+
+using namespace std;
+
+ofxSNNMessageLog::~ofxSNNMessageLog()
+{
+	if(node_) {
+		ofRemoveListener(node_->nodeFound, this, &ofxSNNMessageLog::nodeChanged);
+		ofRemoveListener(node_->nodePropertyChanged, this, &ofxSNNMessageLog::nodeChanged);
+	}
+}
+void ofxSNNMessageLog::setup(ofxSearchNetworkNode &node, const Settings &settings)
+{
+	if(node_) {
+		ofLogWarning("ofxSNNMessageLog") << "setup can be called only once";
+		return;
+	}
+	node_ = &node;
+	settings_ = settings;
+	settings_.capacity = max<size_t>(settings_.capacity, 1);
+	settings_.arena_size = max<size_t>(settings_.arena_size, 2);
+	arena_.assign(settings_.arena_size, 0);
+	slots_.resize(settings_.capacity);
+	ofAddListener(node_->nodeFound, this, &ofxSNNMessageLog::nodeChanged);
+	ofAddListener(node_->nodePropertyChanged, this, &ofxSNNMessageLog::nodeChanged);
+}
+
+void ofxSNNMessageLog::add(const string &ip, const string &text)
+{
+	if(!node_) {
+		ofLogWarning("ofxSNNMessageLog") << "call setup before adding lines";
+		return;
+	}
+	size_t length = min(text.size(), arena_.size()-1);
+	// with the terminator, so no line takes no room
+	size_t size = length+1;
+	if(count_ == slots_.size()) {
+		removeOldest();
+	}
+	// a text is never split, so one that doesn't fit before the end goes to the start.
+	// the lines after the write position are the oldest, so they go first
+	size_t offset = write_;
+	if(offset+size > arena_.size()) {
+		while(count_ > 0 && getOldest().offset >= write_) {
+			removeOldest();
+		}
+		offset = 0;
+	}
+	while(count_ > 0 && getOldest().offset < offset+size && offset < getOldest().offset+getOldest().length+1) {
+		removeOldest();
+	}
+	copy(text.begin(), text.begin()+length, arena_.begin()+offset);
+	arena_[offset+length] = '\0';
+	write_ = offset+size;
+	Slot &slot = slots_[(head_+count_)%slots_.size()];
+	slot.sender = intern(ip);
+	slot.offset = offset;
+	slot.length = length;
+	++count_;
+	++num_added_;
+}
+void ofxSNNMessageLog::removeOldest()
+{
+	head_ = (head_+1)%slots_.size();
+	--count_;
+	if(count_ == 0) {
+		write_ = 0;
+	}
+}
+void ofxSNNMessageLog::clear()
+{
+	head_ = 0;
+	count_ = 0;
+	write_ = 0;
+}
+ofxSNNMessageLog::Line ofxSNNMessageLog::get(size_t index) const
+{
+	const Slot &slot = slots_[(head_+index)%slots_.size()];
+	return Line{slot.sender, arena_.data()+slot.offset, slot.length};
+}
+
+ofxSNNMessageLog::SenderId ofxSNNMessageLog::intern(const string &ip)
+{
+	auto found = sender_ids_.find(ip);
+	if(found != end(sender_ids_)) {
+		return found->second;
+	}
+	SenderId id = senders_.size();
+	const auto &nodes = node_->getNodes();
+	auto node = nodes.find(ip);
+	senders_.push_back(Sender{ip, node != end(nodes) ? node->second.name : "unknown"});
+	sender_ids_.emplace(ip, id);
+	return id;
+}
+void ofxSNNMessageLog::nodeChanged(const pair<string, ofxSearchNetworkNode::Node> &node)
+{
+	auto found = sender_ids_.find(node.first);
+	if(found != end(sender_ids_)) {
+		senders_[found->second].name = node.second.name;
+	}
+}
@@ -0,0 +1,86 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofEvents.h"
+#include "ofxSearchNetworkNode.h"
+#include <unordered_map>
+#include <vector>
+
+// the latest lines of a chat, for windows that stay open for days.
+// the texts are kept in one arena allocated in setup and the oldest lines make room for new ones,
+// so adding a line doesn't allocate and the memory used never grows.
+// senders are interned as small ids with their names cached from the node table,
+// so drawing a line is an index into the ring, not a lookup by ip.
+class ofxSNNMessageLog
+{
+public:
+	struct Settings {
+		// lines at most
+		std::size_t capacity=1000;
+		// bytes for the texts of all lines. a longer text is cut
+		std::size_t arena_size=256*1024;
+	};
+	using SenderId = uint32_t;
+	struct Line {
+		SenderId sender;
+		// null terminated
+		const char *text;
+		std::size_t length;
+	};
+
+	virtual ~ofxSNNMessageLog();
+	void setup(ofxSearchNetworkNode &node, const Settings &settings);
+	void setup(ofxSearchNetworkNode &node) { setup(node, Settings()); }
+	const Settings& getSettings() const { return settings_; }
+
+	void add(const std::string &ip, const std::string &text);
+	void clear();
+	std::size_t size() const { return count_; }
+	bool empty() const { return count_ == 0; }
+	// 0 is the oldest. valid until the next add
+	Line get(std::size_t index) const;
+	// lines ever added, to tell if there is a new one
+	uint64_t getNumAdded() const { return num_added_; }
+
+	const std::string& getSenderIp(SenderId sender) const { return senders_[sender].ip; }
+	// the name from the node table, kept after the node is gone
+	const std::string& getSenderName(SenderId sender) const { return senders_[sender].name; }
+private:
+	ofxSearchNetworkNode *node_=nullptr;
+	Settings settings_;
+	std::vector<char> arena_;
+	// where the next text goes
+	std::size_t write_=0;
+	struct Slot {
+		SenderId sender;
+		std::size_t offset;
+		std::size_t length;
+	};
+	std::vector<Slot> slots_;
+	// the oldest line
+	std::size_t head_=0;
+	std::size_t count_=0;
+	uint64_t num_added_=0;
+	void removeOldest();
+	const Slot& getOldest() const { return slots_[head_]; }
+
+	struct Sender {
+		std::string ip;
+		std::string name;
+	};
+	std::vector<Sender> senders_;
+	std::unordered_map<std::string, SenderId> sender_ids_;
+	SenderId intern(const std::string &ip);
+	void nodeChanged(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+};
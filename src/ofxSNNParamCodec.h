@@ -0,0 +1,139 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofxOsc.h"
+#include "ofVec2f.h"
+#include "ofVec3f.h"
+#include "ofColor.h"
+#include "ofQuaternion.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+// how a value is put in an OSC message, in the same layout as ofxPubSubOsc, and how far apart two values are.
+// specialize it to sync other types.
+template<typename T, typename Enable=void>
+struct ofxSNNParamCodec;
+
+template<typename T>
+struct ofxSNNParamCodec<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+	static void encode(ofxOscMessage &msg, T value) {
+		if(std::is_floating_point<T>::value) {
+			if(sizeof(T) > 4) msg.addDoubleArg(value);
+			else msg.addFloatArg(value);
+		}
+		else {
+			if(sizeof(T) > 4) msg.addInt64Arg(value);
+			else msg.addInt32Arg(value);
+		}
+	}
+	// any number is taken, as ofxOscMessage does
+	static bool decode(const ofxOscMessage &msg, std::size_t &index, T &value) {
+		if(index >= msg.getNumArgs()) {
+			return false;
+		}
+		switch(msg.getArgType(index)) {
+			case OFXOSC_TYPE_INT32: value = static_cast<T>(msg.getArgAsInt32(index)); break;
+			case OFXOSC_TYPE_INT64: value = static_cast<T>(msg.getArgAsInt64(index)); break;
+			case OFXOSC_TYPE_FLOAT: value = static_cast<T>(msg.getArgAsFloat(index)); break;
+			case OFXOSC_TYPE_DOUBLE: value = static_cast<T>(msg.getArgAsDouble(index)); break;
+			case OFXOSC_TYPE_TRUE: value = static_cast<T>(1); break;
+			case OFXOSC_TYPE_FALSE: value = static_cast<T>(0); break;
+			default: return false;
+		}
+		++index;
+		return true;
+	}
+	static float distance(T a, T b) {
+		return std::abs(static_cast<double>(a)-static_cast<double>(b));
+	}
+};
+
+template<>
+struct ofxSNNParamCodec<std::string> {
+	static void encode(ofxOscMessage &msg, const std::string &value) {
+		msg.addStringArg(value);
+	}
+	static bool decode(const ofxOscMessage &msg, std::size_t &index, std::string &value) {
+		if(index >= msg.getNumArgs() || msg.getArgType(index) != OFXOSC_TYPE_STRING) {
+			return false;
+		}
+		value = msg.getArgAsString(index++);
+		return true;
+	}
+	static float distance(const std::string &a, const std::string &b) {
+		return a == b ? 0 : std::numeric_limits<float>::infinity();
+	}
+};
+
+// vectors and colors go as one argument per component
+template<typename T, typename Component, int N>
+struct ofxSNNParamCodecComponents {
+	static void encode(ofxOscMessage &msg, const T &value) {
+		for(int i = 0; i < N; ++i) {
+			ofxSNNParamCodec<Component>::encode(msg, value[i]);
+		}
+	}
+	static bool decode(const ofxOscMessage &msg, std::size_t &index, T &value) {
+		std::size_t end = index;
+		T result = value;
+		for(int i = 0; i < N; ++i) {
+			Component component;
+			if(!ofxSNNParamCodec<Component>::decode(msg, end, component)) {
+				return false;
+			}
+			result[i] = component;
+		}
+		index = end;
+		value = result;
+		return true;
+	}
+	static float distance(const T &a, const T &b) {
+		float d = 0;
+		for(int i = 0; i < N; ++i) {
+			d = std::max(d, ofxSNNParamCodec<Component>::distance(a[i], b[i]));
+		}
+		return d;
+	}
+};
+template<> struct ofxSNNParamCodec<ofVec2f> : ofxSNNParamCodecComponents<ofVec2f, float, 2> {};
+template<> struct ofxSNNParamCodec<ofVec3f> : ofxSNNParamCodecComponents<ofVec3f, float, 3> {};
+template<typename U> struct ofxSNNParamCodec<ofColor_<U>> : ofxSNNParamCodecComponents<ofColor_<U>, typename std::conditional<std::is_floating_point<U>::value, float, int32_t>::type, 4> {};
+
+template<>
+struct ofxSNNParamCodec<ofQuaternion> {
+	static void encode(ofxOscMessage &msg, const ofQuaternion &value) {
+		msg.addFloatArg(value.x());
+		msg.addFloatArg(value.y());
+		msg.addFloatArg(value.z());
+		msg.addFloatArg(value.w());
+	}
+	static bool decode(const ofxOscMessage &msg, std::size_t &index, ofQuaternion &value) {
+		std::size_t end = index;
+		float v[4];
+		for(int i = 0; i < 4; ++i) {
+			if(!ofxSNNParamCodec<float>::decode(msg, end, v[i])) {
+				return false;
+			}
+		}
+		index = end;
+		value.set(v[0], v[1], v[2], v[3]);
+		return true;
+	}
+	static float distance(const ofQuaternion &a, const ofQuaternion &b) {
+		return std::max(std::max(std::abs(a.x()-b.x()), std::abs(a.y()-b.y())), std::max(std::abs(a.z()-b.z()), std::abs(a.w()-b.w())));
+	}
+};
@@ -0,0 +1,509 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNParamGroupSync.h"
+#include "ofLog.h"
+#include "ofUtils.h"
+#include "ofVec2f.h"
+#include "ofVec3f.h"
+#include "ofColor.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+// messages under the address
+//   /schema blob : uint32 schema id, uint32 count, then for each field uint8 type, uint16 length and the path
+//   /query : asks for the schema
+//   /set blob : uint32 schema id, uint32 count, a bit for each field, then the values of the fields whose bit is set
+// paths are the names from the group down to the parameter joined by '/'.
+namespace {
+	template<typename T>
+	void put(vector<char> &dst, T value) {
+		const char *src = reinterpret_cast<const char*>(&value);
+		dst.insert(dst.end(), src, src+sizeof(T));
+	}
+	template<typename T>
+	bool get(const char *&src, const char *end, T &value) {
+		if((size_t)(end-src) < sizeof(T)) {
+			return false;
+		}
+		memcpy(&value, src, sizeof(T));
+		src += sizeof(T);
+		return true;
+	}
+	template<typename T>
+	bool isType(const ofAbstractParameter &param) {
+		return param.type() == typeid(ofParameter<T>).name();
+	}
+	template<typename T>
+	void addCopy(ofParameterGroup &dst, const ofAbstractParameter &src) {
+		ofParameter<T> param;
+		param.set(src.getName(), src.cast<T>().get());
+		dst.add(param);
+	}
+	template<typename T>
+	bool differs(const vector<char> &a, const vector<char> &b, float epsilon) {
+		for(size_t i = 0; i+sizeof(T) <= a.size(); i += sizeof(T)) {
+			T x, y;
+			memcpy(&x, a.data()+i, sizeof(T));
+			memcpy(&y, b.data()+i, sizeof(T));
+			if(std::abs(x-y) > epsilon) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+ofxSNNParamGroupSync::~ofxSNNParamGroupSync()
+{
+	if(node_) {
+		ofRemoveListener(ofEvents().update, this, &ofxSNNParamGroupSync::update);
+		ofRemoveListener(node_->unhandledMessageReceived, this, &ofxSNNParamGroupSync::messageReceived);
+		ofRemoveListener(node_->nodeFound, this, &ofxSNNParamGroupSync::nodeFound);
+		ofRemoveListener(node_->nodeDisconnected, this, &ofxSNNParamGroupSync::nodeDisconnected);
+	}
+}
+void ofxSNNParamGroupSync::setup(ofxSearchNetworkNode &node, ofParameterGroup &group, const Settings &settings)
+{
+	if(node_) {
+		ofLogWarning("ofxSNNParamGroupSync") << "setup can be called only once";
+		return;
+	}
+	node_ = &node;
+	settings_ = settings;
+	group_ = group;
+	random_device seed;
+	schema_id_ = uniform_int_distribution<uint32_t>()(seed);
+	collect(group, "");
+
+	vector<char> schema;
+	put(schema, schema_id_);
+	put<uint32_t>(schema, fields_.size());
+	for(auto &field : fields_) {
+		put<uint8_t>(schema, field.type);
+		uint16_t size = min<size_t>(field.path.size(), numeric_limits<uint16_t>::max());
+		put(schema, size);
+		schema.insert(schema.end(), field.path.begin(), field.path.begin()+size);
+	}
+	schema_.set(schema.data(), schema.size());
+
+	for(auto &n : node_->getNodes()) {
+		new_peers_.push_back(n.first);
+	}
+	ofAddListener(ofEvents().update, this, &ofxSNNParamGroupSync::update);
+	ofAddListener(node_->unhandledMessageReceived, this, &ofxSNNParamGroupSync::messageReceived);
+	ofAddListener(node_->nodeFound, this, &ofxSNNParamGroupSync::nodeFound);
+	ofAddListener(node_->nodeDisconnected, this, &ofxSNNParamGroupSync::nodeDisconnected);
+}
+void ofxSNNParamGroupSync::collect(ofParameterGroup &group, const string &prefix)
+{
+	for(size_t i = 0; i < group.size(); ++i) {
+		ofAbstractParameter &param = group.get(i);
+		string path = prefix + param.getName();
+		Type type;
+		if(param.type() == typeid(ofParameterGroup).name()) {
+			collect(param.castGroup(), path+"/");
+		}
+		else if(getType(param, type)) {
+			Field field;
+			field.path = path;
+			field.type = type;
+			field.param = &param;
+			fields_.push_back(field);
+		}
+		else {
+			ofLogWarning("ofxSNNParamGroupSync") << "the type is not supported, left out: " << path;
+		}
+	}
+}
+void ofxSNNParamGroupSync::cloneGroup(const ofParameterGroup &src, ofParameterGroup &dst, vector<ofAbstractParameter*> &fields) const
+{
+	dst.setName(src.getName());
+	for(size_t i = 0; i < src.size(); ++i) {
+		const ofAbstractParameter &param = src.get(i);
+		Type type;
+		if(param.type() == typeid(ofParameterGroup).name()) {
+			ofParameterGroup child;
+			cloneGroup(param.castGroup(), child, fields);
+			dst.add(child);
+			continue;
+		}
+		if(!getType(param, type)) {
+			continue;
+		}
+		switch(type) {
+			case TYPE_BOOL: addCopy<bool>(dst, param); break;
+			case TYPE_INT: addCopy<int>(dst, param); break;
+			case TYPE_FLOAT: addCopy<float>(dst, param); break;
+			case TYPE_DOUBLE: addCopy<double>(dst, param); break;
+			case TYPE_STRING: addCopy<string>(dst, param); break;
+			case TYPE_VEC2: addCopy<ofVec2f>(dst, param); break;
+			case TYPE_VEC3: addCopy<ofVec3f>(dst, param); break;
+			case TYPE_COLOR: addCopy<ofColor>(dst, param); break;
+			case TYPE_FLOAT_COLOR: addCopy<ofFloatColor>(dst, param); break;
+		}
+		fields.push_back(&dst.get(dst.size()-1));
+	}
+}
+
+bool ofxSNNParamGroupSync::getType(const ofAbstractParameter &param, Type &type)
+{
+	if(isType<bool>(param)) type = TYPE_BOOL;
+	else if(isType<int>(param)) type = TYPE_INT;
+	else if(isType<float>(param)) type = TYPE_FLOAT;
+	else if(isType<double>(param)) type = TYPE_DOUBLE;
+	else if(isType<string>(param)) type = TYPE_STRING;
+	else if(isType<ofVec2f>(param)) type = TYPE_VEC2;
+	else if(isType<ofVec3f>(param)) type = TYPE_VEC3;
+	else if(isType<ofColor>(param)) type = TYPE_COLOR;
+	else if(isType<ofFloatColor>(param)) type = TYPE_FLOAT_COLOR;
+	else return false;
+	return true;
+}
+void ofxSNNParamGroupSync::write(Type type, const ofAbstractParameter &param, vector<char> &dst)
+{
+	switch(type) {
+		case TYPE_BOOL:
+			put<uint8_t>(dst, param.cast<bool>().get() ? 1 : 0);
+			break;
+		case TYPE_INT:
+			put<int32_t>(dst, param.cast<int>().get());
+			break;
+		case TYPE_FLOAT:
+			put<float>(dst, param.cast<float>().get());
+			break;
+		case TYPE_DOUBLE:
+			put<double>(dst, param.cast<double>().get());
+			break;
+		case TYPE_STRING: {
+			const string &value = param.cast<string>().get();
+			uint16_t size = min<size_t>(value.size(), numeric_limits<uint16_t>::max());
+			put(dst, size);
+			dst.insert(dst.end(), value.begin(), value.begin()+size);
+		}	break;
+		case TYPE_VEC2: {
+			const ofVec2f &value = param.cast<ofVec2f>().get();
+			put(dst, value.x);
+			put(dst, value.y);
+		}	break;
+		case TYPE_VEC3: {
+			const ofVec3f &value = param.cast<ofVec3f>().get();
+			put(dst, value.x);
+			put(dst, value.y);
+			put(dst, value.z);
+		}	break;
+		case TYPE_COLOR: {
+			const ofColor &value = param.cast<ofColor>().get();
+			dst.push_back((char)value.r);
+			dst.push_back((char)value.g);
+			dst.push_back((char)value.b);
+			dst.push_back((char)value.a);
+		}	break;
+		case TYPE_FLOAT_COLOR: {
+			const ofFloatColor &value = param.cast<ofFloatColor>().get();
+			put(dst, value.r);
+			put(dst, value.g);
+			put(dst, value.b);
+			put(dst, value.a);
+		}	break;
+	}
+}
+bool ofxSNNParamGroupSync::read(Type type, const char *&src, const char *end, ofAbstractParameter *target)
+{
+	switch(type) {
+		case TYPE_BOOL: {
+			uint8_t value;
+			if(!get(src, end, value)) return false;
+			if(target) target->cast<bool>().set(value != 0);
+		}	break;
+		case TYPE_INT: {
+			int32_t value;
+			if(!get(src, end, value)) return false;
+			if(target) target->cast<int>().set(value);
+		}	break;
+		case TYPE_FLOAT: {
+			float value;
+			if(!get(src, end, value)) return false;
+			if(target) target->cast<float>().set(value);
+		}	break;
+		case TYPE_DOUBLE: {
+			double value;
+			if(!get(src, end, value)) return false;
+			if(target) target->cast<double>().set(value);
+		}	break;
+		case TYPE_STRING: {
+			uint16_t size;
+			if(!get(src, end, size) || size > end-src) return false;
+			if(target) target->cast<string>().set(string(src, size));
+			src += size;
+		}	break;
+		case TYPE_VEC2: {
+			ofVec2f value;
+			if(!get(src, end, value.x) || !get(src, end, value.y)) return false;
+			if(target) target->cast<ofVec2f>().set(value);
+		}	break;
+		case TYPE_VEC3: {
+			ofVec3f value;
+			if(!get(src, end, value.x) || !get(src, end, value.y) || !get(src, end, value.z)) return false;
+			if(target) target->cast<ofVec3f>().set(value);
+		}	break;
+		case TYPE_COLOR: {
+			if(end-src < 4) return false;
+			if(target) target->cast<ofColor>().set(ofColor((uint8_t)src[0], (uint8_t)src[1], (uint8_t)src[2], (uint8_t)src[3]));
+			src += 4;
+		}	break;
+		case TYPE_FLOAT_COLOR: {
+			ofFloatColor value;
+			if(!get(src, end, value.r) || !get(src, end, value.g) || !get(src, end, value.b) || !get(src, end, value.a)) return false;
+			if(target) target->cast<ofFloatColor>().set(value);
+		}	break;
+		default:
+			return false;
+	}
+	return true;
+}
+bool ofxSNNParamGroupSync::isChanged(const Field &field) const
+{
+	if(field.sent.size() != field.current.size()) {
+		return true;
+	}
+	switch(field.type) {
+		case TYPE_FLOAT:
+		case TYPE_VEC2:
+		case TYPE_VEC3:
+		case TYPE_FLOAT_COLOR:
+			return differs<float>(field.sent, field.current, settings_.epsilon);
+		case TYPE_DOUBLE:
+			return differs<double>(field.sent, field.current, settings_.epsilon);
+		default:
+			return memcmp(field.sent.data(), field.current.data(), field.sent.size()) != 0;
+	}
+}
+
+const ofParameterGroup* ofxSNNParamGroupSync::getRemote(const string &ip) const
+{
+	auto found = remotes_.find(ip);
+	return found == end(remotes_) || !found->second.has_schema ? nullptr : &found->second.group;
+}
+
+void ofxSNNParamGroupSync::update(ofEventArgs&)
+{
+	float now = ofGetElapsedTimef();
+	// new peers learn our fields and every value first
+	if(!new_peers_.empty()) {
+		vector<size_t> all(fields_.size());
+		for(size_t i = 0; i < all.size(); ++i) {
+			all[i] = i;
+		}
+		for(auto &ip : new_peers_) {
+			sendSchema(ip);
+			send(ip, all);
+		}
+		new_peers_.clear();
+	}
+	if(sent_at_ >= 0 && now-sent_at_ < settings_.min_interval) {
+		return;
+	}
+	bool is_refresh = now >= refresh_at_;
+	vector<size_t> changed;
+	for(size_t i = 0; i < fields_.size(); ++i) {
+		Field &field = fields_[i];
+		field.current.clear();
+		write(field.type, *field.param, field.current);
+		if(is_refresh || isChanged(field)) {
+			changed.push_back(i);
+		}
+	}
+	if(changed.empty()) {
+		return;
+	}
+	send("", changed);
+	for(size_t i : changed) {
+		fields_[i].sent.swap(fields_[i].current);
+	}
+	sent_at_ = now;
+	if(is_refresh) {
+		refresh_at_ = now+settings_.refresh_interval;
+	}
+}
+void ofxSNNParamGroupSync::send(const string &ip, const vector<size_t> &fields)
+{
+	size_t limit = numeric_limits<size_t>::max();
+	if(ip.empty()) {
+		for(auto &n : node_->getNodes()) {
+			limit = min(limit, node_->getMaxDatagramSize(n.first));
+		}
+	}
+	if(limit == numeric_limits<size_t>::max()) {
+		limit = node_->getMaxDatagramSize(ip);
+	}
+	const size_t head_size = 8 + (fields_.size()+7)/8;
+	limit = limit > MESSAGE_OVERHEAD+head_size ? limit-MESSAGE_OVERHEAD-head_size : 0;
+
+	auto flush = [&](size_t values_size) {
+		vector<char> data;
+		put(data, schema_id_);
+		put<uint32_t>(data, fields_.size());
+		data.insert(data.end(), mask_.begin(), mask_.end());
+		data.insert(data.end(), values_.begin(), values_.begin()+values_size);
+		ofxOscMessage msg;
+		msg.setAddress(address_+"/set");
+		msg.addBlobArg(ofBuffer(data.data(), data.size()));
+		if(ip.empty()) {
+			node_->sendMessage(msg);
+		}
+		else {
+			node_->sendMessage(ip, msg);
+		}
+	};
+	mask_.assign((fields_.size()+7)/8, 0);
+	values_.clear();
+	for(size_t i : fields) {
+		size_t before = values_.size();
+		write(fields_[i].type, *fields_[i].param, values_);
+		// a field that doesn't fit starts the next datagram
+		if(values_.size() > limit && before > 0) {
+			flush(before);
+			values_.erase(values_.begin(), values_.begin()+before);
+			mask_.assign(mask_.size(), 0);
+		}
+		mask_[i/8] |= 1 << (i%8);
+	}
+	if(!values_.empty()) {
+		flush(values_.size());
+	}
+}
+void ofxSNNParamGroupSync::sendSchema(const string &ip)
+{
+	ofxOscMessage msg;
+	msg.setAddress(address_+"/schema");
+	msg.addBlobArg(schema_);
+	node_->sendMessage(ip, msg);
+}
+
+void ofxSNNParamGroupSync::messageReceived(ofxOscMessage &msg)
+{
+	const string &address = msg.getAddress();
+	if(address.compare(0, address_.size(), address_) != 0) {
+		return;
+	}
+	string command = address.substr(address_.size());
+	const string &ip = msg.getRemoteHost();
+	if(command == "/query") {
+		sendSchema(ip);
+		return;
+	}
+	if(command != "/schema" && command != "/set") {
+		return;
+	}
+	if(msg.getNumArgs() < 1 || msg.getArgType(0) != OFXOSC_TYPE_BLOB) {
+		ofLogWarning("ofxSNNParamGroupSync") << "received broken packet from " << ip;
+		return;
+	}
+	if(command == "/schema") {
+		schemaReceived(ip, msg.getArgAsBlob(0));
+	}
+	else {
+		updateReceived(ip, msg.getArgAsBlob(0));
+	}
+}
+void ofxSNNParamGroupSync::schemaReceived(const string &ip, const ofBuffer &buffer)
+{
+	const char *src = buffer.getData();
+	const char *src_end = src + buffer.size();
+	uint32_t schema_id, count;
+	if(!get(src, src_end, schema_id) || !get(src, src_end, count) || count > (size_t)(src_end-src)) {
+		ofLogWarning("ofxSNNParamGroupSync") << "received broken schema from " << ip;
+		return;
+	}
+	map<string, size_t> local;
+	for(size_t i = 0; i < fields_.size(); ++i) {
+		local[fields_[i].path] = i;
+	}
+	vector<Type> types(count);
+	vector<int> to_local(count, -1);
+	for(uint32_t i = 0; i < count; ++i) {
+		uint8_t type;
+		uint16_t size;
+		if(!get(src, src_end, type) || type > TYPE_FLOAT_COLOR || !get(src, src_end, size) || size > src_end-src) {
+			ofLogWarning("ofxSNNParamGroupSync") << "received broken schema from " << ip;
+			return;
+		}
+		types[i] = (Type)type;
+		auto found = local.find(string(src, size));
+		if(found != end(local) && fields_[found->second].type == type) {
+			to_local[i] = found->second;
+		}
+		src += size;
+	}
+	Remote &remote = remotes_[ip];
+	if(!remote.has_schema) {
+		cloneGroup(group_, remote.group, remote.fields);
+	}
+	remote.has_schema = true;
+	remote.schema_id = schema_id;
+	remote.types.swap(types);
+	remote.to_local.swap(to_local);
+}
+void ofxSNNParamGroupSync::updateReceived(const string &ip, const ofBuffer &buffer)
+{
+	const char *src = buffer.getData();
+	const char *src_end = src + buffer.size();
+	uint32_t schema_id, count;
+	if(!get(src, src_end, schema_id) || !get(src, src_end, count)) {
+		ofLogWarning("ofxSNNParamGroupSync") << "received broken packet from " << ip;
+		return;
+	}
+	Remote &remote = remotes_[ip];
+	if(!remote.has_schema || remote.schema_id != schema_id || remote.types.size() != count) {
+		// the schema was lost or the node started again
+		float now = ofGetElapsedTimef();
+		if(remote.query_sent_at < 0 || now-remote.query_sent_at >= settings_.refresh_interval) {
+			remote.query_sent_at = now;
+			ofxOscMessage msg;
+			msg.setAddress(address_+"/query");
+			node_->sendMessage(ip, msg);
+		}
+		return;
+	}
+	const char *mask = src;
+	size_t mask_size = (count+7)/8;
+	if((size_t)(src_end-src) < mask_size) {
+		ofLogWarning("ofxSNNParamGroupSync") << "received broken packet from " << ip;
+		return;
+	}
+	src += mask_size;
+	for(uint32_t i = 0; i < count; ++i) {
+		if(!(mask[i/8] & (1 << (i%8)))) {
+			continue;
+		}
+		int local = remote.to_local[i];
+		if(!read(remote.types[i], src, src_end, local < 0 ? nullptr : remote.fields[local])) {
+			ofLogWarning("ofxSNNParamGroupSync") << "received broken packet from " << ip;
+			return;
+		}
+	}
+}
+
+void ofxSNNParamGroupSync::nodeFound(const pair<string, ofxSearchNetworkNode::Node> &node)
+{
+	new_peers_.push_back(node.first);
+}
+void ofxSNNParamGroupSync::nodeDisconnected(const pair<string, ofxSearchNetworkNode::Node> &node)
+{
+	remotes_.erase(node.first);
+	new_peers_.erase(remove(new_peers_.begin(), new_peers_.end(), node.first), new_peers_.end());
+}
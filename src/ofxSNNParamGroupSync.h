@@ -0,0 +1,113 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofEvents.h"
+#include "ofParameter.h"
+#include "ofxSearchNetworkNode.h"
+
+// shares every parameter in an ofParameterGroup with the other nodes through the node.
+// the fields are numbered once in setup and the nodes tell each other the name and type of each number when they meet,
+// so an update is only the changed fields as a bitmask followed by their values in binary.
+// supported types are bool, int, float, double, std::string, ofVec2f, ofVec3f, ofColor and ofFloatColor.
+// parameters of other types are left out, and the group must keep its shape after setup.
+class ofxSNNParamGroupSync
+{
+public:
+	struct Settings {
+		// float components that moved less than this are not sent
+		float epsilon=0;
+		// seconds between two updates at least
+		float min_interval=0;
+		// seconds between sending every field again, so a lost update doesn't last
+		float refresh_interval=1;
+	};
+
+	virtual ~ofxSNNParamGroupSync();
+	void setup(ofxSearchNetworkNode &node, ofParameterGroup &group, const Settings &settings);
+	void setup(ofxSearchNetworkNode &node, ofParameterGroup &group) { setup(node, group, Settings()); }
+	const Settings& getSettings() const { return settings_; }
+	// call before setup. use a different one for each group
+	void setAddress(const std::string &address) { address_ = address; }
+
+	std::size_t getNumFields() const { return fields_.size(); }
+	// the values of the node in the shape of the local group. nullptr until it has told its fields
+	const ofParameterGroup* getRemote(const std::string &ip) const;
+
+	// room for the address and arguments of an update
+	static const std::size_t MESSAGE_OVERHEAD=64;
+private:
+	enum Type : uint8_t {
+		TYPE_BOOL,
+		TYPE_INT,
+		TYPE_FLOAT,
+		TYPE_DOUBLE,
+		TYPE_STRING,
+		TYPE_VEC2,
+		TYPE_VEC3,
+		TYPE_COLOR,
+		TYPE_FLOAT_COLOR,
+	};
+	static bool getType(const ofAbstractParameter &param, Type &type);
+	static void write(Type type, const ofAbstractParameter &param, std::vector<char> &dst);
+	// target may be nullptr to skip the value
+	static bool read(Type type, const char *&src, const char *end, ofAbstractParameter *target);
+
+	ofxSearchNetworkNode *node_=nullptr;
+	Settings settings_;
+	std::string address_="/params";
+	// chosen in setup, to tell our numbering from an older one
+	uint32_t schema_id_=0;
+	struct Field {
+		std::string path;
+		Type type;
+		ofAbstractParameter *param;
+		std::vector<char> sent;
+		std::vector<char> current;
+	};
+	ofParameterGroup group_;
+	std::vector<Field> fields_;
+	ofBuffer schema_;
+	void collect(ofParameterGroup &group, const std::string &prefix);
+	bool isChanged(const Field &field) const;
+
+	struct Remote {
+		bool has_schema=false;
+		uint32_t schema_id=0;
+		std::vector<Type> types;
+		// our field for each of theirs, -1 if we don't have it
+		std::vector<int> to_local;
+		ofParameterGroup group;
+		// parameters of group in the order of fields_
+		std::vector<ofAbstractParameter*> fields;
+		float query_sent_at=-1;
+	};
+	std::map<std::string, Remote> remotes_;
+	void cloneGroup(const ofParameterGroup &src, ofParameterGroup &dst, std::vector<ofAbstractParameter*> &fields) const;
+	void schemaReceived(const std::string &ip, const ofBuffer &buffer);
+	void updateReceived(const std::string &ip, const ofBuffer &buffer);
+
+	float sent_at_=-1;
+	float refresh_at_=0;
+	std::vector<std::string> new_peers_;
+	std::vector<char> mask_;
+	std::vector<char> values_;
+	// indices of fields_, ip is empty to send to every node
+	void send(const std::string &ip, const std::vector<std::size_t> &fields);
+	void sendSchema(const std::string &ip);
+
+	void update(ofEventArgs&);
+	void messageReceived(ofxOscMessage &msg);
+	void nodeFound(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+	void nodeDisconnected(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+};
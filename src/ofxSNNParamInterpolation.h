@@ -0,0 +1,72 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofVec2f.h"
+#include "ofVec3f.h"
+#include "ofColor.h"
+#include "ofQuaternion.h"
+#include <type_traits>
+
+// how a remote value is blended between the updates p1 and p2, t going from 0 to 1.
+// p0 and p3 are the updates around them, the same as p1 and p2 at the ends of the history.
+// the default keeps p1 until p2 is due, which suits values that can't be blended.
+// specialize it to blend other types.
+template<typename T, typename Enable=void>
+struct ofxSNNParamInterpolation {
+	static T interpolate(const T &p0, const T &p1, const T &p2, const T &p3, float t) {
+		return p1;
+	}
+};
+
+// linear for floating point numbers
+template<typename T>
+struct ofxSNNParamInterpolation<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+	static T interpolate(const T &p0, const T &p1, const T &p2, const T &p3, float t) {
+		return p1 + (p2-p1)*t;
+	}
+};
+
+// cubic Hermite through the updates (Catmull-Rom), so a moving point keeps its speed across them
+template<typename T>
+struct ofxSNNParamHermite {
+	static T interpolate(const T &p0, const T &p1, const T &p2, const T &p3, float t) {
+		float t2 = t*t;
+		float t3 = t2*t;
+		return (p1*2 + (p2-p0)*t + (p0*2 - p1*5 + p2*4 - p3)*t2 + (p1*3 - p0 - p2*3 + p3)*t3)*0.5f;
+	}
+};
+template<> struct ofxSNNParamInterpolation<ofVec2f> : ofxSNNParamHermite<ofVec2f> {};
+template<> struct ofxSNNParamInterpolation<ofVec3f> : ofxSNNParamHermite<ofVec3f> {};
+
+// linear for each channel
+template<typename U>
+struct ofxSNNParamInterpolation<ofColor_<U>> {
+	static ofColor_<U> interpolate(const ofColor_<U> &p0, const ofColor_<U> &p1, const ofColor_<U> &p2, const ofColor_<U> &p3, float t) {
+		ofColor_<U> result;
+		for(int i = 0; i < 4; ++i) {
+			result[i] = p1[i] + (p2[i]-p1[i])*t;
+		}
+		return result;
+	}
+};
+
+// spherical, for rotations
+template<>
+struct ofxSNNParamInterpolation<ofQuaternion> {
+	static ofQuaternion interpolate(const ofQuaternion &p0, const ofQuaternion &p1, const ofQuaternion &p2, const ofQuaternion &p3, float t) {
+		ofQuaternion result;
+		result.slerp(t, p1, p2);
+		return result;
+	}
+};
@@ -15,15 +15,36 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include "ofParameter.h"
 #include "ofxSearchNetworkNode.h"
 #include "ofxPubSubOsc.h"
+#include "ofxSNNParamCodec.h"
+#include "ofxSNNParamInterpolation.h"
+#include "ofxSNNParamSyncEngine.h"
+#include <unordered_map>
+#include <deque>
+#include <tuple>
+#include <cstdio>
 
+// an ofParameter shared with every node, whose value on each of them can be read with getRemote.
+// values are sent through the ofxSNNParamSyncEngine of the node and port, only when they change.
+// one subscriber takes the values from every node and puts each in the slot of its sender.
+// every value is stamped with the sender's clock, so with setInterpolation
+// sampleRemote can play a node's values back smoothly with a fixed delay.
+// in owner mode there is one value for the whole room instead, held by the node with the lowest ip.
 template<typename T>
-class ofxSNNParamSync : public ofParameter<T>
+class ofxSNNParamSync : public ofParameter<T>, private ofxSNNParamSyncEngine::Param
 {
 public:
+	using Codec = ofxSNNParamCodec<T>;
 	virtual ~ofxSNNParamSync() {
 		if(searcher_) {
 			removeListener();
 		}
+		if(is_owner_mode_) {
+			ofParameter<T>::removeListener(this, &ofxSNNParamSync::valueChanged);
+		}
+		if(engine_) {
+			ofxSNNParamSyncEngine::detach(engine_, *this);
+		}
+		unsubscribe();
 	}
 	void setNode(ofxSearchNetworkNode &search) {
 		if(searcher_) {
@@ -31,48 +52,327 @@ public:
 		}
 		searcher_ = &search;
 		addListener();
+		elect();
+		attach();
 	}
 	void setup(int port, const std::string &name) {
 		name_ = name;
 		port_ = port;
+		address_ = "/ofxSNNParamSync/" + name_ + (is_owner_mode_ ? "/shared" : "/set");
+		attach();
+		unsubscribe();
+		subscriber_ = ofxSubscribeOsc(port_, address_, [this](const ofxOscMessage &msg) { messageReceived(msg); });
+		is_subscribed_ = true;
+	}
+	// changes smaller than this are not sent. the distance is given by ofxSNNParamCodec
+	void setEpsilon(float epsilon) { epsilon_ = epsilon; }
+	// seconds between two updates at least
+	void setMinInterval(float seconds) { min_interval_ = seconds; }
+	// in owner mode every node sees the same value.
+	// the others send their changes only to the owner and it sends the resolved value to everyone,
+	// so the traffic grows with the number of nodes rather than its square.
+	// the last change wins, ordered by lamport clock and then by the ip of the writer.
+	// the owner is the node with the lowest ip among the ones not lost, and changes as nodes come and go.
+	// getRemote and sampleRemote are not used in this mode.
+	void setOwnerMode(bool owner_mode) {
+		if(owner_mode == is_owner_mode_) {
+			return;
+		}
+		is_owner_mode_ = owner_mode;
+		if(is_owner_mode_) {
+			ofParameter<T>::addListener(this, &ofxSNNParamSync::valueChanged);
+			stamped_ = this->get();
+		}
+		else {
+			ofParameter<T>::removeListener(this, &ofxSNNParamSync::valueChanged);
+		}
+		if(!address_.empty()) {
+			setup(port_, name_);
+		}
 	}
+	bool isOwnerMode() const { return is_owner_mode_; }
+	// the ip of the owner. empty while no other node is known
+	const std::string& getOwner() const { return owner_; }
+	bool isOwner() const { return owner_.empty() || searcher_->isSelfIp(owner_); }
 	
-	const T& getRemote(const std::string &ip) const { return remotes_[ip].value; }
-	T& getRemote(const std::string &ip) { return remotes_[ip].value; }
+	// keep the last `history` values of each node and sample them `delay` seconds in the past.
+	// the delay should cover a few update intervals so there is a later value to move towards.
+	// a delay of 0 turns it off.
+	void setInterpolation(float delay, std::size_t history=16) {
+		delay_ = delay;
+		history_ = std::max<std::size_t>(history, 2);
+		for(auto &remote : remotes_) {
+			remote.samples.clear();
+		}
+	}
+	
+	// the default value until the node sends one
+	const T& getRemote(const std::string &ip) const {
+		auto found = index_.find(ip);
+		return found == index_.end() ? default_ : remotes_[found->second].value;
+	}
+	// valid until another node is found or one is gone
+	T& getRemote(const std::string &ip) { return getRemoteSlot(ip).value; }
+	// the value of the node at the local time now minus the delay, interpolated by ofxSNNParamInterpolation.
+	// same as getRemote if interpolation is off.
+	T sampleRemote(const std::string &ip) const {
+		auto found = index_.find(ip);
+		if(found == index_.end()) {
+			return default_;
+		}
+		const Remote &remote = remotes_[found->second];
+		const auto &samples = remote.samples;
+		if(delay_ <= 0 || samples.empty()) {
+			return remote.value;
+		}
+		// in the sender's clock
+		double time = getLocalTime() - delay_ - remote.offset;
+		if(time <= samples.front().time) {
+			return samples.front().value;
+		}
+		if(time >= samples.back().time) {
+			return samples.back().value;
+		}
+		std::size_t i = 0;
+		while(samples[i+1].time < time) {
+			++i;
+		}
+		std::size_t last = samples.size()-1;
+		const T &p0 = samples[i > 0 ? i-1 : 0].value;
+		const T &p1 = samples[i].value;
+		const T &p2 = samples[i+1].value;
+		const T &p3 = samples[std::min(i+2, last)].value;
+		double span = samples[i+1].time - samples[i].time;
+		float t = span > 0 ? (time - samples[i].time) / span : 1;
+		return ofxSNNParamInterpolation<T>::interpolate(p0, p1, p2, p3, t);
+	}
 protected:
 	void addListener() {
 		ofAddListener(searcher_->nodeFound, this, &ofxSNNParamSync::nodeConnected);
 		ofAddListener(searcher_->nodeDisconnected, this, &ofxSNNParamSync::nodeDisconnected);
+		ofAddListener(searcher_->nodeLost, this, &ofxSNNParamSync::nodeChanged);
+		ofAddListener(searcher_->nodeReconnected, this, &ofxSNNParamSync::nodeChanged);
 	}
 	void removeListener() {
 		ofRemoveListener(searcher_->nodeFound, this, &ofxSNNParamSync::nodeConnected);
 		ofRemoveListener(searcher_->nodeDisconnected, this, &ofxSNNParamSync::nodeDisconnected);
+		ofRemoveListener(searcher_->nodeLost, this, &ofxSNNParamSync::nodeChanged);
+		ofRemoveListener(searcher_->nodeReconnected, this, &ofxSNNParamSync::nodeChanged);
+	}
+	void attach() {
+		if(engine_) {
+			ofxSNNParamSyncEngine::detach(engine_, *this);
+			engine_ = nullptr;
+		}
+		if(searcher_ && !address_.empty()) {
+			is_sent_ = false;
+			engine_ = ofxSNNParamSyncEngine::attach(*searcher_, port_, *this);
+		}
+	}
+	void unsubscribe() {
+		if(is_subscribed_) {
+			ofxUnsubscribeOsc(subscriber_);
+			is_subscribed_ = false;
+		}
+	}
+	void messageReceived(const ofxOscMessage &msg) {
+		if(is_owner_mode_) {
+			sharedReceived(msg);
+			return;
+		}
+		std::size_t index = 0;
+		T value = getRemote(msg.getRemoteHost());
+		if(!Codec::decode(msg, index, value)) {
+			return;
+		}
+		Remote &remote = getRemoteSlot(msg.getRemoteHost());
+		remote.value = value;
+		if(delay_ <= 0 || index >= msg.getNumArgs() || msg.getArgType(index) != OFXOSC_TYPE_INT64) {
+			return;
+		}
+		double sent = msg.getArgAsInt64(index)*1e-6;
+		auto &samples = remote.samples;
+		if(!samples.empty() && sent <= samples.back().time) {
+			// reordered or the sender has restarted
+			if(sent < samples.back().time - 1) {
+				samples.clear();
+			}
+			else {
+				return;
+			}
+		}
+		// local minus sender time. the smallest one seen is the one with the least latency,
+		// and it creeps up slowly so a drifting clock is followed.
+		double offset = getLocalTime() - sent;
+		if(samples.empty() || offset < remote.offset) {
+			remote.offset = offset;
+		}
+		else {
+			remote.offset += (offset - remote.offset) * 0.01;
+		}
+		samples.push_back(Sample{sent, value});
+		while(samples.size() > history_) {
+			samples.pop_front();
+		}
+	}
+	void sharedReceived(const ofxOscMessage &msg) {
+		std::size_t index = 0;
+		T value = this->get();
+		if(!Codec::decode(msg, index, value) || index+2 > msg.getNumArgs()
+		   || msg.getArgType(index) != OFXOSC_TYPE_INT64 || msg.getArgType(index+1) != OFXOSC_TYPE_STRING) {
+			return;
+		}
+		uint64_t lamport = msg.getArgAsInt64(index);
+		std::string author = msg.getArgAsString(index+1);
+		clock_ = std::max(clock_, lamport);
+		bool is_owner = isOwner();
+		// what the owner sends is the truth, even if it's as old as ours
+		bool is_from_owner = !is_owner && msg.getRemoteHost() == owner_;
+		auto stamp = std::tie(lamport, author);
+		auto current = std::tie(lamport_, author_);
+		if(!(stamp > current || (is_from_owner && stamp == current))) {
+			return;
+		}
+		lamport_ = lamport;
+		author_ = author;
+		stamped_ = value;
+		is_adopting_ = true;
+		this->set(value);
+		is_adopting_ = false;
+		// the owner passes it on, the others already have what the owner sent
+		if(!is_owner) {
+			markSent();
+		}
+	}
+	void valueChanged(T &value) {
+		if(is_adopting_ || Codec::distance(value, stamped_) == 0) {
+			return;
+		}
+		lamport_ = ++clock_;
+		author_ = owner_.empty() ? "" : searcher_->getSelfIp(owner_);
+		stamped_ = value;
+	}
+	// the owner may be another node when one is found, gone or lost
+	void elect() {
+		std::string owner;
+		if(searcher_) {
+			for(const auto &node : searcher_->getNodes()) {
+				if(node.second.lost) {
+					continue;
+				}
+				if(owner.empty()) {
+					owner = searcher_->getSelfIp(node.first);
+				}
+				if(owner.empty() || toNumber(node.first) < toNumber(owner)) {
+					owner = node.first;
+				}
+			}
+		}
+		if(owner == owner_) {
+			return;
+		}
+		owner_ = owner;
+		// the new owner tells everyone its value, the others tell the new owner theirs
+		is_sent_ = false;
+	}
+	static uint32_t toNumber(const std::string &ip) {
+		unsigned int a=0, b=0, c=0, d=0;
+		sscanf(ip.c_str(), "%u.%u.%u.%u", &a, &b, &c, &d);
+		return (a<<24) | (b<<16) | (c<<8) | d;
+	}
+	static double getLocalTime() {
+		return ofGetElapsedTimeMicros()*1e-6;
 	}
 	void nodeConnected(const std::pair<std::string,ofxSearchNetworkNode::Node> &node) {
-		const std::string &ip = node.first;
-		auto &remote = remotes_[ip];
-		remote.publisher = ofxPublishOsc(ip, port_, getAddress(), *this);
-		remote.subscriber = ofxSubscribeOsc(port_, getAddress(), remote.value);
+		getRemoteSlot(node.first);
+		elect();
+	}
+	void nodeChanged(const std::pair<std::string,ofxSearchNetworkNode::Node>&) {
+		elect();
 	}
 	void nodeDisconnected(const std::pair<std::string,ofxSearchNetworkNode::Node> &node) {
-		const std::string &ip = node.first;
-		auto &remote = remotes_[ip];
-		ofxUnpublishOsc(remote.publisher);
-		ofxUnsubscribeOsc(remote.subscriber);
-		remotes_.erase(ip);
+		auto found = index_.find(node.first);
+		if(found == index_.end()) {
+			return;
+		}
+		// the last slot takes the place of the removed one
+		std::size_t index = found->second;
+		index_.erase(found);
+		if(index+1 != remotes_.size()) {
+			remotes_[index] = std::move(remotes_.back());
+			index_[remotes_[index].ip] = index;
+		}
+		remotes_.pop_back();
+		elect();
 	}
 
-	std::string getAddress() const {
-		return "/ofxSNNParamSync/" + name_ + "/set";
+	const std::string& getAddress() const override {
+		return address_;
+	}
+	bool hasChanged() const override {
+		return !is_sent_ || Codec::distance(this->get(), sent_) > epsilon_;
+	}
+	void encode(ofxOscMessage &msg) const override {
+		Codec::encode(msg, this->get());
+		if(is_owner_mode_) {
+			msg.addInt64Arg(lamport_);
+			msg.addStringArg(author_);
+			return;
+		}
+		msg.addInt64Arg(ofGetElapsedTimeMicros());
+	}
+	void markSent() override {
+		sent_ = this->get();
+		is_sent_ = true;
+	}
+	float getMinInterval() const override {
+		return min_interval_;
+	}
+	const std::string& getDestination() const override {
+		return is_owner_mode_ && !isOwner() ? owner_ : no_destination_;
 	}
 	ofxSearchNetworkNode *searcher_=nullptr;
+	ofxSNNParamSyncEngine *engine_=nullptr;
 	std::string name_;
+	std::string address_;
 	int port_;
+	float epsilon_=0;
+	float min_interval_=0;
+	T sent_;
+	bool is_sent_=false;
+	ofxOscSubscriberIdentifier subscriber_;
+	bool is_subscribed_=false;
+	bool is_owner_mode_=false;
+	std::string owner_;
+	const std::string no_destination_;
+	uint64_t clock_=0;
+	// the lamport time and the ip of the change that made the current value
+	uint64_t lamport_=0;
+	std::string author_;
+	T stamped_{};
+	bool is_adopting_=false;
+	float delay_=0;
+	std::size_t history_=16;
+	struct Sample {
+		double time;
+		T value;
+	};
 	struct Remote {
-		ofxOscPublisherIdentifier publisher;
-		ofxOscSubscriberIdentifier subscriber;
+		std::string ip;
 		T value;
+		std::deque<Sample> samples;
+		double offset=0;
 	};
-	std::map<std::string, Remote> remotes_;
+	std::vector<Remote> remotes_;
+	std::unordered_map<std::string, std::size_t> index_;
+	T default_{};
+	Remote& getRemoteSlot(const std::string &ip) {
+		auto found = index_.find(ip);
+		if(found != index_.end()) {
+			return remotes_[found->second];
+		}
+		index_.emplace(ip, remotes_.size());
+		remotes_.push_back(Remote{ip, default_, {}, 0});
+		return remotes_.back();
+	}
 };
-
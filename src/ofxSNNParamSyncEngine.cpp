@@ -0,0 +1,171 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNParamSyncEngine.h"
+#include "ofUtils.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+	map<pair<ofxSearchNetworkNode*, int>, unique_ptr<ofxSNNParamSyncEngine>> engines;
+}
+
+ofxSNNParamSyncEngine* ofxSNNParamSyncEngine::attach(ofxSearchNetworkNode &node, int port, Param &param)
+{
+	auto &engine = engines[make_pair(&node, port)];
+	if(!engine) {
+		engine.reset(new ofxSNNParamSyncEngine(node, port));
+	}
+	engine->add(param);
+	return engine.get();
+}
+void ofxSNNParamSyncEngine::detach(ofxSNNParamSyncEngine *engine, Param &param)
+{
+	engine->remove(param);
+	if(engine->entries_.empty()) {
+		engines.erase(make_pair(&engine->node_, engine->port_));
+	}
+}
+ofxSNNParamSyncEngine* ofxSNNParamSyncEngine::find(ofxSearchNetworkNode &node, int port)
+{
+	auto found = engines.find(make_pair(&node, port));
+	return found == end(engines) ? nullptr : found->second.get();
+}
+
+ofxSNNParamSyncEngine::ofxSNNParamSyncEngine(ofxSearchNetworkNode &node, int port)
+:node_(node)
+,port_(port)
+{
+	ofAddListener(ofEvents().update, this, &ofxSNNParamSyncEngine::update);
+	ofAddListener(node_.nodeFound, this, &ofxSNNParamSyncEngine::nodeFound);
+	ofAddListener(node_.nodeDisconnected, this, &ofxSNNParamSyncEngine::nodeDisconnected);
+	for(auto &n : node_.getNodes()) {
+		new_peers_.push_back(n.first);
+	}
+}
+ofxSNNParamSyncEngine::~ofxSNNParamSyncEngine()
+{
+	ofRemoveListener(ofEvents().update, this, &ofxSNNParamSyncEngine::update);
+	ofRemoveListener(node_.nodeFound, this, &ofxSNNParamSyncEngine::nodeFound);
+	ofRemoveListener(node_.nodeDisconnected, this, &ofxSNNParamSyncEngine::nodeDisconnected);
+}
+
+void ofxSNNParamSyncEngine::add(Param &param)
+{
+	Entry entry;
+	entry.param = &param;
+	entry.sent_at = -1;
+	entry.refresh_at = 0;
+	entries_.push_back(entry);
+}
+void ofxSNNParamSyncEngine::remove(Param &param)
+{
+	entries_.erase(remove_if(entries_.begin(), entries_.end(), [&param](const Entry &entry) { return entry.param == &param; }), entries_.end());
+}
+
+void ofxSNNParamSyncEngine::update(ofEventArgs&)
+{
+	float now = ofGetElapsedTimef();
+	changed_.clear();
+	all_.clear();
+	for(auto &direct : direct_) {
+		direct.second.clear();
+	}
+	for(auto &entry : entries_) {
+		Param &param = *entry.param;
+		bool is_due = entry.sent_at < 0 || now >= entry.refresh_at;
+		bool is_changed = now-entry.sent_at >= param.getMinInterval() && param.hasChanged();
+		if(!is_due && !is_changed && new_peers_.empty()) {
+			continue;
+		}
+		const string &destination = param.getDestination();
+		if(!destination.empty() && !is_due && !is_changed) {
+			continue;
+		}
+		ofxOscMessage msg;
+		msg.setAddress(param.getAddress());
+		param.encode(msg);
+		// new peers get every value, the others only the ones to send now
+		if(is_due || is_changed) {
+			param.markSent();
+			entry.sent_at = now;
+			entry.refresh_at = now + settings_.refresh_interval*uniform_real_distribution<float>(0.5f, 1)(random_);
+			if(!destination.empty()) {
+				direct_[destination].push_back(msg);
+				continue;
+			}
+			changed_.push_back(msg);
+		}
+		if(!new_peers_.empty()) {
+			all_.push_back(msg);
+		}
+	}
+	for(auto &n : node_.getNodes()) {
+		const string &ip = n.first;
+		if(n.second.lost) {
+			continue;
+		}
+		bool is_new = std::find(new_peers_.begin(), new_peers_.end(), ip) != new_peers_.end();
+		const auto &messages = is_new ? all_ : changed_;
+		auto direct = direct_.find(ip);
+		if(direct == direct_.end() || direct->second.empty()) {
+			send(ip, messages);
+			continue;
+		}
+		outgoing_ = messages;
+		outgoing_.insert(outgoing_.end(), direct->second.begin(), direct->second.end());
+		send(ip, outgoing_);
+	}
+	new_peers_.clear();
+}
+void ofxSNNParamSyncEngine::send(const string &ip, const vector<ofxOscMessage> &messages)
+{
+	if(messages.empty()) {
+		return;
+	}
+	auto &sender = senders_[ip];
+	if(!sender) {
+		sender.reset(new ofxOscSender());
+		sender->setup(ip, port_);
+	}
+	size_t limit = node_.getMaxDatagramSize(ip);
+	ofxOscBundle bundle;
+	size_t size = BUNDLE_OVERHEAD;
+	for(auto &msg : messages) {
+		size_t msg_size = ofxSearchNetworkNode::getMessageSize(msg);
+		if(bundle.getMessageCount() > 0 && size+msg_size > limit) {
+			sender->sendBundle(bundle);
+			++stats_.bundles_sent;
+			stats_.bytes_sent += size;
+			bundle.clear();
+			size = BUNDLE_OVERHEAD;
+		}
+		bundle.addMessage(msg);
+		size += msg_size;
+		++stats_.messages_sent;
+	}
+	sender->sendBundle(bundle);
+	++stats_.bundles_sent;
+	stats_.bytes_sent += size;
+}
+
+void ofxSNNParamSyncEngine::nodeFound(const pair<string, ofxSearchNetworkNode::Node> &node)
+{
+	new_peers_.push_back(node.first);
+}
+void ofxSNNParamSyncEngine::nodeDisconnected(const pair<string, ofxSearchNetworkNode::Node> &node)
+{
+	senders_.erase(node.first);
+	direct_.erase(node.first);
+	new_peers_.erase(std::remove(new_peers_.begin(), new_peers_.end(), node.first), new_peers_.end());
+}
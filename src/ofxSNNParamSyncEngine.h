@@ -0,0 +1,98 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofEvents.h"
+#include "ofxOsc.h"
+#include "ofxSearchNetworkNode.h"
+#include <memory>
+#include <random>
+
+// sends the parameters of every ofxSNNParamSync sharing a node and a port.
+// once a frame the values that moved are collected into one bundle per peer, split at the datagram size,
+// so a change costs a datagram per peer however many parameters changed.
+// every value is sent again now and then, so a lost update doesn't last.
+class ofxSNNParamSyncEngine
+{
+public:
+	struct Settings {
+		// seconds between sending an unchanged value again, at most.
+		// each value picks a time between half of this and this, so they don't all come at once
+		float refresh_interval=1;
+	};
+	struct Stats {
+		uint64_t messages_sent=0;
+		uint64_t bundles_sent=0;
+		uint64_t bytes_sent=0;
+	};
+	// implemented by ofxSNNParamSync
+	class Param {
+	public:
+		virtual ~Param() {}
+		virtual const std::string& getAddress() const = 0;
+		// true if the value moved beyond the threshold since it was sent
+		virtual bool hasChanged() const = 0;
+		virtual void encode(ofxOscMessage &msg) const = 0;
+		// remembers the current value as the one sent
+		virtual void markSent() = 0;
+		// seconds between two updates at least
+		virtual float getMinInterval() const = 0;
+		// the only peer to send the value to, or empty for every peer
+		virtual const std::string& getDestination() const = 0;
+	};
+
+	// the engine of the node and port, made for the first parameter and gone with the last
+	static ofxSNNParamSyncEngine* attach(ofxSearchNetworkNode &node, int port, Param &param);
+	static void detach(ofxSNNParamSyncEngine *engine, Param &param);
+	// nullptr if no parameter uses them
+	static ofxSNNParamSyncEngine* find(ofxSearchNetworkNode &node, int port);
+
+	ofxSNNParamSyncEngine(ofxSearchNetworkNode &node, int port);
+	virtual ~ofxSNNParamSyncEngine();
+	void setSettings(const Settings &settings) { settings_ = settings; }
+	const Settings& getSettings() const { return settings_; }
+	std::size_t getNumParams() const { return entries_.size(); }
+	const Stats& getStats() const { return stats_; }
+
+	// room for the bundle header and the size of a message in it
+	static const std::size_t BUNDLE_OVERHEAD=16;
+private:
+	ofxSearchNetworkNode &node_;
+	int port_;
+	Settings settings_;
+	Stats stats_;
+	struct Entry {
+		Param *param;
+		// negative until sent
+		float sent_at;
+		float refresh_at;
+	};
+	std::vector<Entry> entries_;
+	std::minstd_rand random_;
+	// peers that get every value next time
+	std::vector<std::string> new_peers_;
+	std::map<std::string, std::unique_ptr<ofxOscSender>> senders_;
+	std::vector<ofxOscMessage> changed_;
+	std::vector<ofxOscMessage> all_;
+	// values for one peer only, sent with the others
+	std::map<std::string, std::vector<ofxOscMessage>> direct_;
+	std::vector<ofxOscMessage> outgoing_;
+
+	void add(Param &param);
+	void remove(Param &param);
+	void send(const std::string &ip, const std::vector<ofxOscMessage> &messages);
+
+	void update(ofEventArgs&);
+	void nodeFound(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+	void nodeDisconnected(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+};
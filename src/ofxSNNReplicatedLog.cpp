@@ -0,0 +1,457 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNReplicatedLog.h"
+#include "ofLog.h"
+#include "ofUtils.h"
+#include <cstring>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+// messages under the address
+//   /op author, seq, lamport, payload blob
+//   /version blob : pairs of uint32 author and seq
+// the state transfer under /sync is queried with a version vector and answers with
+// uint32 count and as many pairs of uint32 author and the seq truncated so far,
+// then every operation after the query, each as uint32 author, seq, uint64 lamport, uint32 size and the payload.
+namespace {
+	template<typename T>
+	void put(vector<char> &dst, T value) {
+		const char *src = reinterpret_cast<const char*>(&value);
+		dst.insert(dst.end(), src, src+sizeof(T));
+	}
+	template<typename T>
+	bool get(const char *&src, const char *end, T &value) {
+		if((size_t)(end-src) < sizeof(T)) {
+			return false;
+		}
+		memcpy(&value, src, sizeof(T));
+		src += sizeof(T);
+		return true;
+	}
+	ofBuffer encodeVersion(const ofxSNNReplicatedLog::VersionVector &version) {
+		vector<char> data;
+		for(auto &v : version) {
+			put(data, v.first);
+			put(data, v.second);
+		}
+		return ofBuffer(data.data(), data.size());
+	}
+	bool decodeVersion(const ofBuffer &buffer, ofxSNNReplicatedLog::VersionVector &version) {
+		const char *src = buffer.getData();
+		const char *src_end = src + buffer.size();
+		while(src < src_end) {
+			uint32_t author, seq;
+			if(!get(src, src_end, author) || !get(src, src_end, seq)) {
+				return false;
+			}
+			version[author] = seq;
+		}
+		return true;
+	}
+	uint32_t makeAuthor() {
+		random_device seed;
+		return uniform_int_distribution<uint32_t>()(seed);
+	}
+}
+
+ofxSNNReplicatedLog::~ofxSNNReplicatedLog()
+{
+	if(node_) {
+		ofRemoveListener(ofEvents().update, this, &ofxSNNReplicatedLog::update);
+		ofRemoveListener(node_->unhandledMessageReceived, this, &ofxSNNReplicatedLog::messageReceived);
+		ofRemoveListener(transfer_.snapshotReceived, this, &ofxSNNReplicatedLog::diffReceived);
+	}
+}
+void ofxSNNReplicatedLog::setup(ofxSearchNetworkNode &node, const Settings &settings)
+{
+	if(node_) {
+		ofLogWarning("ofxSNNReplicatedLog") << "setup can be called only once";
+		return;
+	}
+	node_ = &node;
+	settings_ = settings;
+	author_ = makeAuthor();
+	transfer_.setAddress(address_+"/sync");
+	transfer_.setup(node, settings_.transfer);
+	transfer_.setSnapshotFunction([this](const ofBuffer &query) { return makeDiff(query); });
+	ofAddListener(transfer_.snapshotReceived, this, &ofxSNNReplicatedLog::diffReceived);
+	ofAddListener(ofEvents().update, this, &ofxSNNReplicatedLog::update);
+	ofAddListener(node_->unhandledMessageReceived, this, &ofxSNNReplicatedLog::messageReceived);
+}
+
+const ofxSNNReplicatedLog::Op& ofxSNNReplicatedLog::append(const ofBuffer &payload)
+{
+	Op op;
+	op.author = author_;
+	op.seq = version_[author_]+1;
+	op.lamport = clock_+1;
+	op.payload = payload;
+	sendOp("", op);
+	deliver(move(op));
+	return ops_[author_].back();
+}
+void ofxSNNReplicatedLog::sync()
+{
+	transfer_.request(encodeVersion(version_));
+}
+void ofxSNNReplicatedLog::reset()
+{
+	transfer_.cancel();
+	author_ = makeAuthor();
+	clock_ = 0;
+	ops_.clear();
+	num_ops_ = 0;
+	version_.clear();
+	truncated_.clear();
+	truncate_at_ = make_pair(0, 0);
+	peer_versions_.clear();
+	pending_.clear();
+	repair_deadline_ = -1;
+}
+void ofxSNNReplicatedLog::truncate(uint64_t lamport, uint32_t author)
+{
+	truncate_at_ = max(truncate_at_, make_pair(lamport, author));
+	applyTruncation();
+}
+void ofxSNNReplicatedLog::applyTruncation()
+{
+	if(truncate_at_ == make_pair<uint64_t,uint32_t>(0, 0)) {
+		return;
+	}
+	// the last seq of each author ordered before the truncation point.
+	// an author's Lamport times grow with its seq, so those are at the front
+	VersionVector target;
+	for(auto &author : ops_) {
+		uint32_t seq = 0;
+		for(auto &op : author.second) {
+			if(make_pair(op.lamport, op.author) >= truncate_at_) {
+				break;
+			}
+			seq = op.seq;
+		}
+		if(seq > 0) {
+			target[author.first] = seq;
+		}
+	}
+	// no further than every node has delivered
+	const auto &nodes = node_->getNodes();
+	for(auto it = begin(peer_versions_); it != end(peer_versions_);) {
+		if(nodes.find(it->first) == end(nodes)) {
+			it = peer_versions_.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	for(auto &n : nodes) {
+		if(n.second.lost || node_->isSelfIp(n.first)) {
+			continue;
+		}
+		auto peer = peer_versions_.find(n.first);
+		if(peer == end(peer_versions_)) {
+			return;
+		}
+		for(auto &t : target) {
+			auto found = peer->second.find(t.first);
+			t.second = min(t.second, found == end(peer->second) ? 0 : found->second);
+		}
+	}
+	for(auto &t : target) {
+		uint32_t &truncated = truncated_[t.first];
+		if(t.second <= truncated) {
+			continue;
+		}
+		auto &ops = ops_[t.first];
+		size_t count = t.second-truncated;
+		ops.erase(begin(ops), begin(ops)+count);
+		num_ops_ -= count;
+		truncated = t.second;
+	}
+}
+void ofxSNNReplicatedLog::skipTo(uint32_t author, uint32_t seq)
+{
+	uint32_t &last = version_[author];
+	if(seq <= last) {
+		return;
+	}
+	auto &ops = ops_[author];
+	num_ops_ -= ops.size();
+	ops.clear();
+	last = seq;
+	truncated_[author] = seq;
+	auto waiting = pending_.find(author);
+	if(waiting == end(pending_)) {
+		return;
+	}
+	auto &pending = waiting->second;
+	pending.erase(begin(pending), pending.upper_bound(seq));
+	while(!pending.empty() && pending.begin()->first == version_[author]+1) {
+		deliver(move(pending.begin()->second));
+		pending.erase(pending.begin());
+	}
+	if(pending.empty()) {
+		pending_.erase(waiting);
+	}
+}
+deque<ofxSNNReplicatedLog::Op>::const_iterator ofxSNNReplicatedLog::findAfter(const deque<Op> &ops, uint32_t author, uint32_t seq) const
+{
+	auto found = truncated_.find(author);
+	uint32_t truncated = found == end(truncated_) ? 0 : found->second;
+	return seq <= truncated ? begin(ops) : begin(ops)+min<size_t>(seq-truncated, ops.size());
+}
+void ofxSNNReplicatedLog::forEach(const function<void(const Op&)> &function) const
+{
+	for(auto &author : ops_) {
+		for(auto &op : author.second) {
+			function(op);
+		}
+	}
+}
+
+void ofxSNNReplicatedLog::receive(Op &&op)
+{
+	auto found = version_.find(op.author);
+	uint32_t last = found == end(version_) ? 0 : found->second;
+	if(op.seq <= last) {
+		return;
+	}
+	if(op.seq > last+1) {
+		pending_[op.author].insert(make_pair(op.seq, move(op)));
+		return;
+	}
+	uint32_t author = op.author;
+	deliver(move(op));
+	auto waiting = pending_.find(author);
+	if(waiting == end(pending_)) {
+		return;
+	}
+	auto &ops = waiting->second;
+	while(!ops.empty() && ops.begin()->first <= version_[author]+1) {
+		if(ops.begin()->first == version_[author]+1) {
+			deliver(move(ops.begin()->second));
+		}
+		ops.erase(ops.begin());
+	}
+	if(ops.empty()) {
+		pending_.erase(waiting);
+	}
+}
+void ofxSNNReplicatedLog::deliver(Op &&op)
+{
+	clock_ = max(clock_, op.lamport);
+	version_[op.author] = op.seq;
+	++num_ops_;
+	auto &ops = ops_[op.author];
+	ops.push_back(move(op));
+	ofNotifyEvent(opReceived, ops.back(), this);
+}
+size_t ofxSNNReplicatedLog::countMissing(const VersionVector &version) const
+{
+	size_t count = 0;
+	for(auto &v : version) {
+		auto found = version_.find(v.first);
+		uint32_t last = found == end(version_) ? 0 : found->second;
+		if(v.second > last) {
+			count += v.second-last;
+		}
+	}
+	return count;
+}
+string ofxSNNReplicatedLog::findPeerAhead() const
+{
+	const auto &nodes = node_->getNodes();
+	string ret;
+	size_t most = 0;
+	for(auto &peer : peer_versions_) {
+		auto found = nodes.find(peer.first);
+		if(found == end(nodes) || found->second.lost) {
+			continue;
+		}
+		size_t missing = countMissing(peer.second);
+		if(missing > most) {
+			most = missing;
+			ret = peer.first;
+		}
+	}
+	return ret;
+}
+
+size_t ofxSNNReplicatedLog::getDatagramLimit(const string &ip) const
+{
+	size_t size = numeric_limits<size_t>::max();
+	if(ip.empty()) {
+		for(auto &n : node_->getNodes()) {
+			size = min(size, node_->getMaxDatagramSize(n.first));
+		}
+	}
+	if(size == numeric_limits<size_t>::max()) {
+		size = node_->getMaxDatagramSize(ip);
+	}
+	return size > MESSAGE_OVERHEAD ? size-MESSAGE_OVERHEAD : 0;
+}
+void ofxSNNReplicatedLog::sendOp(const string &ip, const Op &op)
+{
+	// the others find it missing in the version vector and pull it
+	if(op.payload.size() > getDatagramLimit(ip)) {
+		return;
+	}
+	ofxOscMessage msg;
+	msg.setAddress(address_+"/op");
+	msg.addInt32Arg(op.author);
+	msg.addInt32Arg(op.seq);
+	msg.addInt64Arg(op.lamport);
+	msg.addBlobArg(op.payload);
+	if(ip.empty()) {
+		node_->sendMessage(msg);
+	}
+	else {
+		node_->sendMessage(ip, msg);
+	}
+}
+void ofxSNNReplicatedLog::sendVersion()
+{
+	ofxOscMessage msg;
+	msg.setAddress(address_+"/version");
+	msg.addBlobArg(encodeVersion(version_));
+	node_->sendMessage(msg);
+}
+
+ofBuffer ofxSNNReplicatedLog::makeDiff(const ofBuffer &query) const
+{
+	VersionVector version;
+	if(!decodeVersion(query, version)) {
+		ofLogWarning("ofxSNNReplicatedLog") << "received broken version vector";
+		version.clear();
+	}
+	vector<char> data;
+	put(data, (uint32_t)truncated_.size());
+	for(auto &t : truncated_) {
+		put(data, t.first);
+		put(data, t.second);
+	}
+	for(auto &author : ops_) {
+		auto found = version.find(author.first);
+		for(auto it = findAfter(author.second, author.first, found == end(version) ? 0 : found->second); it != author.second.end(); ++it) {
+			put(data, it->author);
+			put(data, it->seq);
+			put(data, it->lamport);
+			put(data, (uint32_t)it->payload.size());
+			data.insert(data.end(), it->payload.getData(), it->payload.getData()+it->payload.size());
+		}
+	}
+	return ofBuffer(data.data(), data.size());
+}
+void ofxSNNReplicatedLog::diffReceived(const ofxSNNStateTransfer::Snapshot &snapshot)
+{
+	const char *src = snapshot.buffer.getData();
+	const char *src_end = src + snapshot.buffer.size();
+	uint32_t count;
+	if(!get(src, src_end, count)) {
+		ofLogWarning("ofxSNNReplicatedLog") << "received broken operations from " << snapshot.ip;
+		return;
+	}
+	for(uint32_t i = 0; i < count; ++i) {
+		uint32_t author, seq;
+		if(!get(src, src_end, author) || !get(src, src_end, seq)) {
+			ofLogWarning("ofxSNNReplicatedLog") << "received broken operations from " << snapshot.ip;
+			return;
+		}
+		skipTo(author, seq);
+	}
+	while(src < src_end) {
+		Op op;
+		uint32_t size;
+		if(!get(src, src_end, op.author) || !get(src, src_end, op.seq) || !get(src, src_end, op.lamport)
+		   || !get(src, src_end, size) || size > (size_t)(src_end-src)) {
+			ofLogWarning("ofxSNNReplicatedLog") << "received broken operations from " << snapshot.ip;
+			return;
+		}
+		op.payload.set(src, size);
+		src += size;
+		receive(move(op));
+	}
+}
+
+void ofxSNNReplicatedLog::update(ofEventArgs&)
+{
+	float now = ofGetElapsedTimef();
+	sync_timer_ += ofGetLastFrameTime();
+	if(sync_timer_ >= settings_.sync_interval) {
+		sync_timer_ = 0;
+		sendVersion();
+		applyTruncation();
+	}
+	// what the others did not send back in time, or could not as it is too large, is pulled from a node that has it
+	string ahead = transfer_.isRequesting() ? "" : findPeerAhead();
+	if(ahead.empty()) {
+		repair_deadline_ = -1;
+	}
+	else if(repair_deadline_ < 0) {
+		repair_deadline_ = now+settings_.sync_interval;
+	}
+	else if(now >= repair_deadline_) {
+		repair_deadline_ = -1;
+		transfer_.request(encodeVersion(version_), ahead);
+	}
+}
+void ofxSNNReplicatedLog::messageReceived(ofxOscMessage &msg)
+{
+	const string &address = msg.getAddress();
+	if(address.compare(0, address_.size(), address_) != 0) {
+		return;
+	}
+	string command = address.substr(address_.size());
+	const string &ip = msg.getRemoteHost();
+	if(command == "/op") {
+		if(msg.getNumArgs() < 4 || msg.getArgType(3) != OFXOSC_TYPE_BLOB) {
+			ofLogWarning("ofxSNNReplicatedLog") << "received broken packet from " << ip;
+			return;
+		}
+		Op op;
+		op.author = msg.getArgAsInt32(0);
+		op.seq = msg.getArgAsInt32(1);
+		op.lamport = msg.getArgAsInt64(2);
+		op.payload = msg.getArgAsBlob(3);
+		receive(move(op));
+	}
+	else if(command == "/version") {
+		if(node_->isSelfIp(ip)) {
+			return;
+		}
+		VersionVector version;
+		if(msg.getNumArgs() < 1 || msg.getArgType(0) != OFXOSC_TYPE_BLOB || !decodeVersion(msg.getArgAsBlob(0), version)) {
+			ofLogWarning("ofxSNNReplicatedLog") << "received broken packet from " << ip;
+			return;
+		}
+		peer_versions_[ip] = version;
+		if(countMissing(version) > settings_.max_repair_ops && !transfer_.isRequesting()) {
+			transfer_.request(encodeVersion(version_), ip);
+		}
+		// sends back what the peer is missing, oldest first.
+		// a peer behind the truncation can't use them and pulls instead
+		size_t budget = settings_.max_repair_ops;
+		for(auto &author : ops_) {
+			auto found = version.find(author.first);
+			uint32_t seq = found == end(version) ? 0 : found->second;
+			auto truncated = truncated_.find(author.first);
+			if(truncated != end(truncated_) && seq < truncated->second) {
+				continue;
+			}
+			for(auto it = findAfter(author.second, author.first, seq); it != author.second.end() && budget > 0; ++it, --budget) {
+				sendOp(ip, *it);
+			}
+		}
+	}
+}
@@ -0,0 +1,128 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofEvents.h"
+#include "ofFileUtils.h"
+#include "ofxSearchNetworkNode.h"
+#include "ofxSNNStateTransfer.h"
+#include <deque>
+#include <functional>
+
+// an append-only log written by every node, which ends up the same on every node whatever order the messages come in.
+// each author numbers its own operations, so what a node has is summed up by a version vector of the last number from each author.
+// the nodes tell each other their version vectors from time to time and send back only the ranges the other is missing;
+// a node far behind pulls its missing ranges through a state transfer instead.
+// operations of an author are delivered in order, and their Lamport times give an order across authors that every node agrees on.
+// the operations the application no longer needs can be truncated; nodes joining later skip them.
+class ofxSNNReplicatedLog
+{
+public:
+	struct Settings {
+		// how often the version vector is told to the others
+		float sync_interval=2;
+		// operations sent back for a version vector. a node missing more pulls them instead
+		std::size_t max_repair_ops=64;
+		ofxSNNStateTransfer::Settings transfer;
+	};
+	struct Op {
+		uint32_t author;
+		// from 1, without gaps
+		uint32_t seq;
+		uint64_t lamport;
+		ofBuffer payload;
+		// the order shared by every node
+		bool isBefore(const Op &op) const {
+			return lamport != op.lamport ? lamport < op.lamport : author < op.author;
+		}
+	};
+	// the last seq delivered from each author
+	using VersionVector = std::map<uint32_t, uint32_t>;
+
+	virtual ~ofxSNNReplicatedLog();
+	void setup(ofxSearchNetworkNode &node, const Settings &settings);
+	void setup(ofxSearchNetworkNode &node) { setup(node, Settings()); }
+	const Settings& getSettings() const { return settings_; }
+	// call before setup
+	void setAddress(const std::string &address) { address_ = address; }
+	// chosen at random in setup and reset
+	uint32_t getAuthor() const { return author_; }
+
+	// delivered through opReceived before this returns
+	const Op& append(const ofBuffer &payload);
+	// pulls every operation the others have and this node doesn't
+	void sync();
+	bool isSyncing() const { return transfer_.isRequesting(); }
+	float getProgress() const { return transfer_.getProgress(); }
+	// drops every operation and starts over as a new author
+	void reset();
+	// drops the operations ordered before the one at (lamport, author) once every node has delivered them.
+	// nodes behind by then skip them, so the application must not need them anymore, as after a clear.
+	void truncate(uint64_t lamport, uint32_t author);
+
+	const VersionVector& getVersionVector() const { return version_; }
+	// the last seq truncated from each author
+	const VersionVector& getTruncated() const { return truncated_; }
+	uint64_t getClock() const { return clock_; }
+	std::size_t getNumOps() const { return num_ops_; }
+	// every operation delivered and not truncated, each author's in order
+	void forEach(const std::function<void(const Op&)> &function) const;
+
+	// every operation once, each author's in order
+	ofEvent<const Op> opReceived;
+
+	// room for the address and arguments of an operation
+	static const std::size_t MESSAGE_OVERHEAD=64;
+private:
+	ofxSearchNetworkNode *node_=nullptr;
+	Settings settings_;
+	std::string address_="/log";
+	uint32_t author_=0;
+	uint64_t clock_=0;
+	// a deque keeps the operations in place while a listener appends.
+	// each starts right after the truncated seq of its author
+	std::map<uint32_t, std::deque<Op>> ops_;
+	std::size_t num_ops_=0;
+	VersionVector version_;
+	VersionVector truncated_;
+	std::pair<uint64_t,uint32_t> truncate_at_{0,0};
+	// the version vectors last told by the others
+	std::map<std::string, VersionVector> peer_versions_;
+	void applyTruncation();
+	// jumps over operations truncated by the others
+	void skipTo(uint32_t author, uint32_t seq);
+	// the operations of an author after seq, as far as this node has them
+	std::deque<Op>::const_iterator findAfter(const std::deque<Op> &ops, uint32_t author, uint32_t seq) const;
+	// arrived ahead of one still missing
+	std::map<uint32_t, std::map<uint32_t, Op>> pending_;
+	float sync_timer_=0;
+	// negative while nothing is missing
+	float repair_deadline_=-1;
+	ofxSNNStateTransfer transfer_;
+
+	void receive(Op &&op);
+	void deliver(Op &&op);
+	std::size_t countMissing(const VersionVector &version) const;
+	// the node still here that told a version vector with the most operations this node doesn't have.
+	// empty if there is none, so operations only a departed node had are not waited for
+	std::string findPeerAhead() const;
+	std::size_t getDatagramLimit(const std::string &ip) const;
+	// ip is empty to send to every node
+	void sendOp(const std::string &ip, const Op &op);
+	void sendVersion();
+	ofBuffer makeDiff(const ofBuffer &query) const;
+	void diffReceived(const ofxSNNStateTransfer::Snapshot &snapshot);
+
+	void update(ofEventArgs&);
+	void messageReceived(ofxOscMessage &msg);
+};
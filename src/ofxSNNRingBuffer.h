@@ -0,0 +1,82 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// fixed capacity single-producer single-consumer queue.
+// write and read never lock nor allocate, so either side may run on a real-time audio thread.
+// allocate and reset must be called while neither side is running.
+template<typename T>
+class ofxSNNRingBuffer
+{
+public:
+	void allocate(std::size_t capacity) {
+		std::size_t size = 1;
+		while(size < capacity) {
+			size <<= 1;
+		}
+		buffer_.assign(size, T());
+		mask_ = size-1;
+		reset();
+	}
+	void reset() {
+		head_.store(0, std::memory_order_relaxed);
+		tail_.store(0, std::memory_order_relaxed);
+	}
+	std::size_t getCapacity() const { return buffer_.size(); }
+
+	// producer side
+	std::size_t getWriteAvailable() const {
+		return buffer_.size() - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+	}
+	std::size_t write(const T *src, std::size_t count) {
+		std::size_t head = head_.load(std::memory_order_relaxed);
+		count = std::min(count, getWriteAvailable());
+		std::size_t first = std::min(count, buffer_.size() - (head & mask_));
+		std::copy(src, src+first, buffer_.data() + (head & mask_));
+		std::copy(src+first, src+count, buffer_.data());
+		head_.store(head+count, std::memory_order_release);
+		return count;
+	}
+
+	// consumer side
+	std::size_t getReadAvailable() const {
+		return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+	}
+	std::size_t read(T *dst, std::size_t count) {
+		std::size_t tail = tail_.load(std::memory_order_relaxed);
+		count = std::min(count, getReadAvailable());
+		std::size_t first = std::min(count, buffer_.size() - (tail & mask_));
+		std::copy(buffer_.data() + (tail & mask_), buffer_.data() + (tail & mask_) + first, dst);
+		std::copy(buffer_.data(), buffer_.data() + (count-first), dst+first);
+		tail_.store(tail+count, std::memory_order_release);
+		return count;
+	}
+	std::size_t skip(std::size_t count) {
+		count = std::min(count, getReadAvailable());
+		tail_.fetch_add(count, std::memory_order_release);
+		return count;
+	}
+private:
+	std::vector<T> buffer_;
+	std::size_t mask_=0;
+	// keep the indices on separate cache lines without needing over-aligned new
+	char pad0_[64];
+	std::atomic<std::size_t> head_{0};
+	char pad1_[64];
+	std::atomic<std::size_t> tail_{0};
+};
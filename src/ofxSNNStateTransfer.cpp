@@ -0,0 +1,413 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNStateTransfer.h"
+#include "ofLog.h"
+#include "ofUtils.h"
+#include <random>
+
+using namespace std;
+
+// messages under the address
+//   /query : asks every node for an offer
+//   /offer synced, sessions, pending bytes : the load of the node that would serve
+//   /start session, [query blob] : pulls a snapshot
+//   /data session, index, count, size, chunk size, blob
+//   /ack session, next, mask : every chunk below next is received, and so is next+1+i for each bit i of mask
+namespace {
+	const int ACK_MASK_BITS = 32;
+}
+
+ofxSNNStateTransfer::~ofxSNNStateTransfer()
+{
+	if(node_) {
+		ofRemoveListener(ofEvents().update, this, &ofxSNNStateTransfer::update);
+		ofRemoveListener(node_->unhandledMessageReceived, this, &ofxSNNStateTransfer::messageReceived);
+		ofRemoveListener(node_->nodeDisconnected, this, &ofxSNNStateTransfer::nodeDisconnected);
+	}
+}
+void ofxSNNStateTransfer::setup(ofxSearchNetworkNode &node, const Settings &settings)
+{
+	if(node_) {
+		ofLogWarning("ofxSNNStateTransfer") << "setup can be called only once";
+		return;
+	}
+	node_ = &node;
+	settings_ = settings;
+	settings_.window = max(settings_.window, 1);
+	ofAddListener(ofEvents().update, this, &ofxSNNStateTransfer::update);
+	ofAddListener(node_->unhandledMessageReceived, this, &ofxSNNStateTransfer::messageReceived);
+	ofAddListener(node_->nodeDisconnected, this, &ofxSNNStateTransfer::nodeDisconnected);
+}
+
+void ofxSNNStateTransfer::request(const ofBuffer &buffer)
+{
+	request(buffer, "");
+}
+void ofxSNNStateTransfer::request(const ofBuffer &buffer, const string &ip)
+{
+	is_synced_ = false;
+	query_ = buffer;
+	peer_ = ip;
+	query();
+}
+void ofxSNNStateTransfer::cancel()
+{
+	state_ = IDLE;
+	peer_.clear();
+	offers_.clear();
+	receiving_ = Receiving();
+}
+float ofxSNNStateTransfer::getProgress() const
+{
+	if(state_ != RECEIVING || receiving_.received.empty()) {
+		return 0;
+	}
+	return receiving_.num_received/(float)receiving_.received.size();
+}
+
+void ofxSNNStateTransfer::query()
+{
+	state_ = QUERYING;
+	offers_.clear();
+	receiving_ = Receiving();
+	query_timer_ = 0;
+	ofxOscMessage msg;
+	msg.setAddress(address_+"/query");
+	if(peer_.empty()) {
+		node_->sendMessage(msg);
+	}
+	else {
+		node_->sendMessage(peer_, msg);
+	}
+}
+void ofxSNNStateTransfer::choosePeer(float now)
+{
+	// peers still waiting for a snapshot themselves are chosen only when nobody else answers
+	auto isBetter = [](const Offer &a, const Offer &b) {
+		if(a.synced != b.synced) return a.synced;
+		if(a.sessions != b.sessions) return a.sessions < b.sessions;
+		return a.pending < b.pending;
+	};
+	auto best = end(offers_);
+	for(auto it = begin(offers_); it != end(offers_); ++it) {
+		if(best == end(offers_) || isBetter(it->second, best->second)) {
+			best = it;
+		}
+	}
+	state_ = RECEIVING;
+	receiving_ = Receiving();
+	receiving_.ip = best->first;
+	random_device seed;
+	receiving_.session = uniform_int_distribution<int32_t>(0)(seed);
+	receiving_.last_heard = now;
+	receiving_.start_sent_at = now;
+	offers_.clear();
+	sendStart();
+}
+void ofxSNNStateTransfer::sendStart()
+{
+	ofxOscMessage msg;
+	msg.setAddress(address_+"/start");
+	msg.addInt32Arg(receiving_.session);
+	if(query_.size() > 0) {
+		msg.addBlobArg(query_);
+	}
+	node_->sendMessage(receiving_.ip, msg);
+}
+void ofxSNNStateTransfer::sendAck(const string &ip, int32_t session, size_t next, uint32_t mask)
+{
+	ofxOscMessage msg;
+	msg.setAddress(address_+"/ack");
+	msg.addInt32Arg(session);
+	msg.addInt32Arg(next);
+	msg.addInt32Arg(mask);
+	node_->sendMessage(ip, msg);
+}
+
+void ofxSNNStateTransfer::update(ofEventArgs&)
+{
+	float now = ofGetElapsedTimef();
+	float delta_time = ofGetLastFrameTime();
+	switch(state_) {
+		case IDLE:
+			break;
+		case QUERYING:
+			query_timer_ += delta_time;
+			if(query_timer_ >= settings_.query_interval) {
+				if(offers_.empty()) {
+					query();
+				}
+				else {
+					choosePeer(now);
+				}
+			}
+			else if(now >= offer_deadline_ && any_of(begin(offers_), end(offers_), [](const pair<const string, Offer> &offer) { return offer.second.synced; })) {
+				choosePeer(now);
+			}
+			break;
+		case RECEIVING:
+			if(now-receiving_.last_heard > settings_.timeout) {
+				ofLogWarning("ofxSNNStateTransfer") << "no response from " << receiving_.ip << ", asking again";
+				query();
+				break;
+			}
+			// the start may have been lost
+			if(receiving_.received.empty() && now-receiving_.start_sent_at >= settings_.query_interval) {
+				receiving_.start_sent_at = now;
+				sendStart();
+			}
+			// one acknowledgement per frame however many chunks came
+			if(receiving_.need_ack) {
+				uint32_t mask = 0;
+				for(int i = 0; i < ACK_MASK_BITS; ++i) {
+					size_t index = receiving_.next+1+i;
+					if(index < receiving_.received.size() && receiving_.received[index]) {
+						mask |= 1u << i;
+					}
+				}
+				sendAck(receiving_.ip, receiving_.session, receiving_.next, mask);
+				receiving_.need_ack = false;
+			}
+			break;
+	}
+	serve(now, delta_time);
+}
+
+float ofxSNNStateTransfer::Session::getTimeout() const
+{
+	return min(max(rtt*2, 0.05f), 2.f);
+}
+void ofxSNNStateTransfer::serve(float now, float delta_time)
+{
+	for(auto it = begin(sessions_); it != end(sessions_);) {
+		if(now-it->second.last_heard > settings_.timeout) {
+			ofLogWarning("ofxSNNStateTransfer") << "no response from " << it->first.first << ", giving up the transfer";
+			it = sessions_.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	if(settings_.max_bytes_per_sec > 0) {
+		// a short burst at most, so the rate holds whatever the frame rate is
+		tokens_ = min(tokens_ + settings_.max_bytes_per_sec*delta_time, settings_.max_bytes_per_sec*0.1f);
+	}
+	// a chunk to each in turn, so every peer gets a fair share of the rate
+	bool sent = true;
+	while(sent) {
+		sent = false;
+		for(auto &session : sessions_) {
+			if(settings_.max_bytes_per_sec > 0 && tokens_ <= 0) {
+				return;
+			}
+			sent |= sendNextChunk(session.first.first, session.first.second, session.second, now);
+		}
+	}
+}
+bool ofxSNNStateTransfer::sendNextChunk(const string &ip, int32_t id, Session &session, float now)
+{
+	float timeout = session.getTimeout();
+	size_t window_end = min(session.next+settings_.window, session.num_chunks);
+	size_t inflight = 0;
+	size_t index = window_end;
+	for(size_t i = session.next; i < window_end; ++i) {
+		if(session.acked[i]) {
+			continue;
+		}
+		if(session.sent_at[i] >= 0 && now-session.sent_at[i] < timeout) {
+			++inflight;
+		}
+		else if(index == window_end) {
+			index = i;
+		}
+	}
+	if(index == window_end || inflight >= (size_t)settings_.window) {
+		return false;
+	}
+	size_t offset = index*session.chunk_size;
+	size_t size = min(session.chunk_size, session.buffer.size()-offset);
+	ofxOscMessage msg;
+	msg.setAddress(address_+"/data");
+	msg.addInt32Arg(id);
+	msg.addInt32Arg(index);
+	msg.addInt32Arg(session.num_chunks);
+	msg.addInt64Arg(session.buffer.size());
+	msg.addInt32Arg(session.chunk_size);
+	msg.addBlobArg(ofBuffer(session.buffer.getData()+offset, size));
+	node_->sendMessage(ip, msg);
+	session.sent_at[index] = now;
+	if(session.sent_count[index] < 255) {
+		++session.sent_count[index];
+	}
+	tokens_ -= size;
+	return true;
+}
+
+void ofxSNNStateTransfer::messageReceived(ofxOscMessage &msg)
+{
+	const string &address = msg.getAddress();
+	if(address.compare(0, address_.size(), address_) != 0) {
+		return;
+	}
+	const string command = address.substr(address_.size());
+	const string ip = msg.getRemoteHost();
+	if(node_->isSelfIp(ip)) {
+		return;
+	}
+	float now = ofGetElapsedTimef();
+	if(command == "/query") {
+		int64_t pending = 0;
+		for(auto &session : sessions_) {
+			pending += session.second.buffer.size() - min(session.second.buffer.size(), session.second.next*session.second.chunk_size);
+		}
+		ofxOscMessage offer;
+		offer.setAddress(address_+"/offer");
+		offer.addInt32Arg(is_synced_ ? 1 : 0);
+		offer.addInt32Arg(sessions_.size());
+		offer.addInt64Arg(pending);
+		node_->sendMessage(ip, offer);
+	}
+	else if(command == "/offer") {
+		if(state_ != QUERYING || (!peer_.empty() && ip != peer_)) {
+			return;
+		}
+		if(offers_.empty()) {
+			offer_deadline_ = now+settings_.offer_wait;
+		}
+		Offer &offer = offers_[ip];
+		offer.synced = msg.getArgAsInt32(0) != 0;
+		offer.sessions = msg.getArgAsInt32(1);
+		offer.pending = msg.getArgAsInt64(2);
+	}
+	else if(command == "/start") {
+		auto key = make_pair(ip, msg.getArgAsInt32(0));
+		if(sessions_.find(key) != end(sessions_)) {
+			return;
+		}
+		if(!snapshot_function_) {
+			ofLogWarning("ofxSNNStateTransfer") << "no snapshot function is set";
+			return;
+		}
+		Session &session = sessions_[key];
+		session.buffer = snapshot_function_(msg.getNumArgs() > 1 && msg.getArgType(1) == OFXOSC_TYPE_BLOB ? msg.getArgAsBlob(1) : ofBuffer());
+		session.chunk_size = max<size_t>(node_->getMaxDatagramSize(ip), DATA_MESSAGE_OVERHEAD*2) - DATA_MESSAGE_OVERHEAD;
+		session.num_chunks = max<size_t>((session.buffer.size()+session.chunk_size-1)/session.chunk_size, 1);
+		session.sent_at.assign(session.num_chunks, -1);
+		session.sent_count.assign(session.num_chunks, 0);
+		session.acked.assign(session.num_chunks, false);
+		session.last_heard = now;
+	}
+	else if(command == "/ack") {
+		auto found = sessions_.find(make_pair(ip, msg.getArgAsInt32(0)));
+		if(found == end(sessions_)) {
+			return;
+		}
+		Session &session = found->second;
+		size_t next = min<size_t>(max(msg.getArgAsInt32(1), 0), session.num_chunks);
+		uint32_t mask = msg.getArgAsInt32(2);
+		auto acknowledge = [&](size_t index) {
+			if(index >= session.num_chunks || session.acked[index]) {
+				return;
+			}
+			session.acked[index] = true;
+			// a chunk sent more than once can't tell which one was answered
+			if(session.sent_count[index] == 1) {
+				session.rtt += (now-session.sent_at[index] - session.rtt)*0.125f;
+			}
+		};
+		for(size_t i = session.next; i < next; ++i) {
+			acknowledge(i);
+		}
+		for(int i = 0; i < ACK_MASK_BITS; ++i) {
+			if(mask & (1u << i)) {
+				acknowledge(next+1+i);
+			}
+		}
+		while(session.next < session.num_chunks && session.acked[session.next]) {
+			++session.next;
+		}
+		session.last_heard = now;
+		if(session.next == session.num_chunks) {
+			sessions_.erase(found);
+		}
+	}
+	else if(command == "/data") {
+		int32_t session = msg.getArgAsInt32(0);
+		size_t index = msg.getArgAsInt32(1);
+		size_t num_chunks = msg.getArgAsInt32(2);
+		size_t size = msg.getArgAsInt64(3);
+		size_t chunk_size = msg.getArgAsInt32(4);
+		const ofBuffer &blob = msg.getArgAsBlob(5);
+		// left over from a finished or cancelled transfer. let the sender stop
+		if(state_ != RECEIVING || ip != receiving_.ip || session != receiving_.session) {
+			sendAck(ip, session, num_chunks, 0);
+			return;
+		}
+		if(receiving_.received.empty()) {
+			if(chunk_size == 0 || num_chunks != max<size_t>((size+chunk_size-1)/chunk_size, 1)) {
+				ofLogWarning("ofxSNNStateTransfer") << "received broken packet from " << ip;
+				return;
+			}
+			receiving_.buffer.allocate(size);
+			receiving_.chunk_size = chunk_size;
+			receiving_.received.assign(num_chunks, false);
+		}
+		size_t offset = index*receiving_.chunk_size;
+		if(index >= receiving_.received.size() || num_chunks != receiving_.received.size() || offset+blob.size() > receiving_.buffer.size()) {
+			ofLogWarning("ofxSNNStateTransfer") << "received broken packet from " << ip;
+			return;
+		}
+		receiving_.last_heard = now;
+		receiving_.need_ack = true;
+		if(receiving_.received[index]) {
+			return;
+		}
+		copy(blob.getData(), blob.getData()+blob.size(), receiving_.buffer.getData()+offset);
+		receiving_.received[index] = true;
+		++receiving_.num_received;
+		while(receiving_.next < receiving_.received.size() && receiving_.received[receiving_.next]) {
+			++receiving_.next;
+		}
+		if(receiving_.num_received == receiving_.received.size()) {
+			sendAck(ip, session, num_chunks, 0);
+			Snapshot snapshot;
+			snapshot.ip = ip;
+			snapshot.buffer = move(receiving_.buffer);
+			state_ = IDLE;
+			is_synced_ = true;
+			receiving_ = Receiving();
+			ofNotifyEvent(snapshotReceived, snapshot, this);
+		}
+	}
+}
+
+void ofxSNNStateTransfer::nodeDisconnected(const pair<string, ofxSearchNetworkNode::Node> &node)
+{
+	for(auto it = begin(sessions_); it != end(sessions_);) {
+		if(it->first.first == node.first) {
+			it = sessions_.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	offers_.erase(node.first);
+	if(state_ != IDLE && peer_ == node.first) {
+		ofLogWarning("ofxSNNStateTransfer") << node.first << " disconnected, giving up the transfer";
+		cancel();
+		return;
+	}
+	if(state_ == RECEIVING && receiving_.ip == node.first) {
+		query();
+	}
+}
@@ -0,0 +1,134 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofEvents.h"
+#include "ofFileUtils.h"
+#include "ofxSearchNetworkNode.h"
+#include <functional>
+
+// brings a node up to date with the state of the others.
+// a node that requests a snapshot asks everyone, waits shortly for the answers and pulls from the least loaded peer.
+// the snapshot is sent in datagram sized chunks within a window and a rate limit shared by every peer being served,
+// and chunks not acknowledged in time are sent again.
+class ofxSNNStateTransfer
+{
+public:
+	struct Settings {
+		// how often the request is repeated while nobody answers
+		float query_interval=1;
+		// how long to collect answers before choosing a peer
+		float offer_wait=0.2f;
+		// chunks in flight per peer being served
+		int window=32;
+		// bytes per second for every peer being served together. 0 for unlimited
+		float max_bytes_per_sec=1024*1024;
+		// a peer silent for this many seconds is given up
+		float timeout=3;
+	};
+	struct Snapshot {
+		std::string ip;
+		ofBuffer buffer;
+	};
+	// query is what the pulling peer passed to request, so it can ask for only a part of the state
+	using SnapshotFunction = std::function<ofBuffer(const ofBuffer &query)>;
+
+	virtual ~ofxSNNStateTransfer();
+	void setup(ofxSearchNetworkNode &node, const Settings &settings);
+	void setup(ofxSearchNetworkNode &node) { setup(node, Settings()); }
+	const Settings& getSettings() const { return settings_; }
+	// call before setup
+	void setAddress(const std::string &address) { address_ = address; }
+	// called when a peer starts pulling, so each one gets the state of that moment
+	void setSnapshotFunction(SnapshotFunction function) { snapshot_function_ = function; }
+
+	// keeps asking until some peer answers.
+	// query has to fit in a datagram
+	void request(const ofBuffer &query);
+	void request() { request(ofBuffer()); }
+	// asks only the given peer, as one known to have the state. given up if it disconnects
+	void request(const ofBuffer &query, const std::string &ip);
+	void cancel();
+	bool isRequesting() const { return state_ != IDLE; }
+	// 0 to 1 while receiving
+	float getProgress() const;
+	// peers being served
+	std::size_t getNumSessions() const { return sessions_.size(); }
+
+	ofEvent<const Snapshot> snapshotReceived;
+
+	// room for the address and arguments of a chunk
+	static const std::size_t DATA_MESSAGE_OVERHEAD=128;
+private:
+	ofxSearchNetworkNode *node_=nullptr;
+	Settings settings_;
+	std::string address_="/state";
+	SnapshotFunction snapshot_function_;
+
+	// serving side
+	struct Session {
+		ofBuffer buffer;
+		std::size_t chunk_size;
+		std::size_t num_chunks;
+		// negative until sent
+		std::vector<float> sent_at;
+		std::vector<uint8_t> sent_count;
+		std::vector<bool> acked;
+		// every chunk below is acknowledged
+		std::size_t next=0;
+		float last_heard;
+		float rtt=0.2f;
+		float getTimeout() const;
+	};
+	std::map<std::pair<std::string,int32_t>, Session> sessions_;
+	float tokens_=0;
+	void serve(float now, float delta_time);
+	bool sendNextChunk(const std::string &ip, int32_t id, Session &session, float now);
+
+	// pulling side
+	enum State { IDLE, QUERYING, RECEIVING };
+	State state_=IDLE;
+	// false from the request until a snapshot arrives
+	bool is_synced_=true;
+	ofBuffer query_;
+	// empty to ask everyone
+	std::string peer_;
+	float query_timer_=0;
+	float offer_deadline_=0;
+	struct Offer {
+		bool synced;
+		int32_t sessions;
+		int64_t pending;
+	};
+	std::map<std::string, Offer> offers_;
+	struct Receiving {
+		std::string ip;
+		int32_t session;
+		ofBuffer buffer;
+		std::size_t chunk_size=0;
+		std::vector<bool> received;
+		std::size_t num_received=0;
+		std::size_t next=0;
+		float last_heard;
+		float start_sent_at;
+		bool need_ack=false;
+	} receiving_;
+	void query();
+	void choosePeer(float now);
+	void sendStart();
+	void sendAck(const std::string &ip, int32_t session, std::size_t next, uint32_t mask);
+
+	void update(ofEventArgs&);
+	void messageReceived(ofxOscMessage &msg);
+	void nodeDisconnected(const std::pair<std::string, ofxSearchNetworkNode::Node> &node);
+};
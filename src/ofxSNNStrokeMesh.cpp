@@ -0,0 +1,143 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNStrokeMesh.h"
+#include "ofGraphics.h"
+
+using namespace std;
+
+void ofxSNNStrokeMesh::setup(const Settings &settings)
+{
+	settings_ = settings;
+	settings_.block_size = min<size_t>(max<size_t>(settings_.block_size, 2), 65536);
+	clear();
+}
+
+ofxSNNStrokeMesh::Block& ofxSNNStrokeMesh::getOpenBlock(Layer &layer, size_t num_vertices)
+{
+	if(layer.blocks.empty() || layer.blocks.back()->mesh.getNumVertices()+num_vertices > settings_.block_size) {
+		layer.blocks.emplace_back(new Block());
+		Block &block = *layer.blocks.back();
+		block.mesh.setMode(OF_PRIMITIVE_LINES);
+		const float inf = numeric_limits<float>::max();
+		block.min = ofVec3f(inf, inf, inf);
+		block.max = ofVec3f(-inf, -inf, -inf);
+	}
+	return *layer.blocks.back();
+}
+
+void ofxSNNStrokeMesh::add(uint32_t author, uint32_t stroke, const ofColor &color, float width, const ofVec3f *points, size_t num_points)
+{
+	if(num_points == 0) {
+		return;
+	}
+	LayerKey key{author, width, (uint32_t)color.r<<24 | (uint32_t)color.g<<16 | (uint32_t)color.b<<8 | color.a};
+	auto found = layers_.find(key);
+	if(found == end(layers_)) {
+		found = layers_.insert(make_pair(key, Layer())).first;
+		found->second.color = color;
+		found->second.width = width;
+	}
+	Layer &layer = found->second;
+	auto tail = tails_.find(make_pair(author, stroke));
+	bool has_tail = tail != end(tails_);
+	size_t i = 0;
+	while(i < num_points) {
+		// the last point of the stroke is added again when it is in another block
+		bool need_tail = has_tail && (layer.blocks.empty() || tail->second.block != layer.blocks.back().get());
+		Block &block = getOpenBlock(layer, need_tail ? 2 : 1);
+		ofVboMesh &mesh = block.mesh;
+		if(has_tail && tail->second.block != &block) {
+			tail->second.index = mesh.getNumVertices();
+			tail->second.block = &block;
+			mesh.addVertex(tail->second.point);
+			++num_vertices_;
+		}
+		size_t count = min(num_points-i, settings_.block_size-mesh.getNumVertices());
+		for(size_t end_i = i+count; i < end_i; ++i) {
+			ofIndexType index = mesh.getNumVertices();
+			mesh.addVertex(points[i]);
+			for(int d = 0; d < 3; ++d) {
+				block.min[d] = min(block.min[d], points[i][d]);
+				block.max[d] = max(block.max[d], points[i][d]);
+			}
+			if(has_tail) {
+				auto &runs = tail->second.runs;
+				if(runs.empty() || runs.back().block != &block || runs.back().first+runs.back().count != mesh.getNumIndices()) {
+					runs.push_back(Run{&block, mesh.getNumIndices(), 0});
+				}
+				runs.back().count += 2;
+				mesh.addIndex(tail->second.index);
+				mesh.addIndex(index);
+			}
+			else {
+				tail = tails_.insert(make_pair(make_pair(author, stroke), Tail())).first;
+				has_tail = true;
+			}
+			tail->second.block = &block;
+			tail->second.index = index;
+			tail->second.point = points[i];
+		}
+		num_vertices_ += count;
+	}
+}
+
+void ofxSNNStrokeMesh::remove(uint32_t author, uint32_t stroke)
+{
+	auto found = tails_.find(make_pair(author, stroke));
+	if(found == end(tails_)) {
+		return;
+	}
+	// collapsed segments draw nothing
+	for(auto &run : found->second.runs) {
+		auto &indices = run.block->mesh.getIndices();
+		for(size_t i = run.first; i < run.first+run.count; i += 2) {
+			indices[i+1] = indices[i];
+		}
+	}
+	tails_.erase(found);
+}
+
+void ofxSNNStrokeMesh::clear()
+{
+	layers_.clear();
+	tails_.clear();
+	num_vertices_ = 0;
+}
+
+void ofxSNNStrokeMesh::draw() const
+{
+	draw([](const ofVec3f&, const ofVec3f&) { return true; });
+}
+void ofxSNNStrokeMesh::draw(const function<bool(const ofVec3f &min, const ofVec3f &max)> &is_visible) const
+{
+	for(auto &layer : layers_) {
+		ofPushStyle();
+		ofSetColor(layer.second.color);
+		ofSetLineWidth(layer.second.width);
+		for(auto &block : layer.second.blocks) {
+			if(is_visible(block->min, block->max)) {
+				block->mesh.draw();
+			}
+		}
+		ofPopStyle();
+	}
+}
+
+size_t ofxSNNStrokeMesh::getNumBlocks() const
+{
+	size_t ret = 0;
+	for(auto &layer : layers_) {
+		ret += layer.second.blocks.size();
+	}
+	return ret;
+}
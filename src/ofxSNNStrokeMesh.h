@@ -0,0 +1,88 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofVboMesh.h"
+#include "ofColor.h"
+#include <map>
+#include <memory>
+#include <limits>
+#include <functional>
+
+// keeps strokes on the GPU as line segments, so drawing costs a handful of draw calls however long the history is.
+// strokes of an author sharing a color and a width go to the same buffers.
+// a buffer holds a fixed number of vertices and a new one is started when it is full,
+// so adding points re-uploads the last buffer only.
+class ofxSNNStrokeMesh
+{
+public:
+	struct Settings {
+		// vertices per buffer, 65536 at most so indices fit in 16 bits on GLES
+		std::size_t block_size=65536;
+	};
+	void setup(const Settings &settings);
+	void setup() { setup(Settings()); }
+
+	// continues the stroke from its last point
+	void add(uint32_t author, uint32_t stroke, const ofColor &color, float width, const ofVec3f *points, std::size_t num_points);
+	void add(uint32_t author, uint32_t stroke, const ofColor &color, float width, const std::vector<ofVec3f> &points) {
+		add(author, stroke, color, width, points.data(), points.size());
+	}
+	// the points already added stay in the buffers but are not drawn anymore
+	void remove(uint32_t author, uint32_t stroke);
+	void clear();
+	void draw() const;
+	// skips the buffers whose bounding box is_visible returns false for
+	void draw(const std::function<bool(const ofVec3f &min, const ofVec3f &max)> &is_visible) const;
+
+	std::size_t getNumVertices() const { return num_vertices_; }
+	std::size_t getNumBlocks() const;
+private:
+	Settings settings_;
+	struct Block {
+		ofVboMesh mesh;
+		ofVec3f min, max;
+	};
+	struct Layer {
+		ofColor color;
+		float width;
+		std::vector<std::unique_ptr<Block>> blocks;
+	};
+	struct LayerKey {
+		uint32_t author;
+		float width;
+		uint32_t color;
+		bool operator<(const LayerKey &key) const {
+			if(author != key.author) return author < key.author;
+			if(width != key.width) return width < key.width;
+			return color < key.color;
+		}
+	};
+	std::map<LayerKey, Layer> layers_;
+	// the indices of a stroke, to remove it
+	struct Run {
+		Block *block;
+		std::size_t first;
+		std::size_t count;
+	};
+	// where each stroke ends, to connect the next points to
+	struct Tail {
+		Block *block;
+		ofIndexType index;
+		ofVec3f point;
+		std::vector<Run> runs;
+	};
+	std::map<std::pair<uint32_t,uint32_t>, Tail> tails_;
+	std::size_t num_vertices_=0;
+	Block& getOpenBlock(Layer &layer, std::size_t num_vertices);
+};
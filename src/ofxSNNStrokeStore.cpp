@@ -0,0 +1,486 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNStrokeStore.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace {
+	float getSquareDistanceToSegment(const ofVec3f &p, const ofVec3f &a, const ofVec3f &b) {
+		ofVec3f ab = b-a;
+		float length = ab.dot(ab);
+		float t = length > 0 ? max(0.f, min((p-a).dot(ab)/length, 1.f)) : 0;
+		return p.squareDistance(a + ab*t);
+	}
+	// Douglas-Peucker. returns the indices of the points to keep
+	void simplify(const vector<ofVec3f> &points, float tolerance, vector<size_t> &result) {
+		result.clear();
+		if(points.size() < 3 || tolerance <= 0) {
+			for(size_t i = 0; i < points.size(); ++i) {
+				result.push_back(i);
+			}
+			return;
+		}
+		vector<bool> keep(points.size(), false);
+		keep.front() = keep.back() = true;
+		vector<pair<size_t,size_t>> stack{{0, points.size()-1}};
+		float square_tolerance = tolerance*tolerance;
+		while(!stack.empty()) {
+			auto range = stack.back();
+			stack.pop_back();
+			float farthest = 0;
+			size_t index = range.first;
+			for(size_t i = range.first+1; i < range.second; ++i) {
+				float distance = getSquareDistanceToSegment(points[i], points[range.first], points[range.second]);
+				if(distance > farthest) {
+					farthest = distance;
+					index = i;
+				}
+			}
+			if(farthest > square_tolerance) {
+				keep[index] = true;
+				stack.emplace_back(range.first, index);
+				stack.emplace_back(index, range.second);
+			}
+		}
+		for(size_t i = 0; i < points.size(); ++i) {
+			if(keep[i]) {
+				result.push_back(i);
+			}
+		}
+	}
+}
+
+void ofxSNNStrokeStore::Box::add(const ofVec3f &pos)
+{
+	for(int i = 0; i < 3; ++i) {
+		min[i] = std::min(min[i], pos[i]);
+		max[i] = std::max(max[i], pos[i]);
+	}
+}
+bool ofxSNNStrokeStore::Box::intersects(const Box &box) const
+{
+	for(int i = 0; i < 3; ++i) {
+		if(box.max[i] < min[i] || max[i] < box.min[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+bool ofxSNNStrokeStore::Box::contains(const Box &box) const
+{
+	for(int i = 0; i < 3; ++i) {
+		if(box.min[i] < min[i] || max[i] < box.max[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+ofxSNNStrokeStore::Box ofxSNNStrokeStore::Box::around(const ofVec3f &pos, float radius)
+{
+	Box box;
+	box.min = pos - ofVec3f(radius, radius, radius);
+	box.max = pos + ofVec3f(radius, radius, radius);
+	return box;
+}
+
+void ofxSNNStrokeStore::setup(const Settings &settings)
+{
+	settings_ = settings;
+	settings_.dimensions = settings_.dimensions == 3 ? 3 : 2;
+	settings_.node_capacity = max<size_t>(settings_.node_capacity, 1);
+	clear();
+}
+
+size_t ofxSNNStrokeStore::add(const ofxSNNStrokeStream::Points &points)
+{
+	Key key(points.author, points.stroke);
+	auto found = index_.find(key);
+	if(found == end(index_)) {
+		Stroke stroke;
+		stroke.author = points.author;
+		stroke.id = points.stroke;
+		const float inf = numeric_limits<float>::max();
+		stroke.box.min = ofVec3f(inf, inf, inf);
+		stroke.box.max = ofVec3f(-inf, -inf, -inf);
+		found = index_.insert(make_pair(key, strokes_.size())).first;
+		strokes_.push_back(stroke);
+	}
+	Stroke &stroke = strokes_[found->second];
+	if(stroke.is_erased || stroke.is_end) {
+		return 0;
+	}
+	stroke.style = points.style;
+	// points we already have come again when other nodes catch us up
+	size_t skip = min<size_t>(stroke.length > points.index ? stroke.length-points.index : 0, points.points.size());
+	auto &open = open_[key];
+	for(size_t i = skip; i < points.points.size(); ++i) {
+		open.push_back(points.points[i]);
+		stroke.box.add(points.points[i]);
+	}
+	stroke.length += points.points.size()-skip;
+	if(points.is_end) {
+		stroke.is_end = true;
+		pack(stroke, open);
+		open_.erase(key);
+		if(stroke.count > 0) {
+			insert(found->second);
+		}
+	}
+	return points.points.size()-skip;
+}
+void ofxSNNStrokeStore::pack(Stroke &stroke, const vector<ofVec3f> &points)
+{
+	vector<size_t> keep;
+	simplify(points, settings_.tolerance, keep);
+	stroke.offset = x_.size();
+	stroke.count = keep.size();
+	for(size_t i : keep) {
+		x_.push_back(points[i].x);
+		y_.push_back(points[i].y);
+		if(settings_.dimensions == 3) {
+			z_.push_back(points[i].z);
+		}
+	}
+}
+void ofxSNNStrokeStore::erase(const Key &key)
+{
+	auto found = index_.find(key);
+	if(found == end(index_)) {
+		Stroke stroke;
+		stroke.author = key.first;
+		stroke.id = key.second;
+		stroke.is_erased = true;
+		index_.insert(make_pair(key, strokes_.size()));
+		strokes_.push_back(stroke);
+		return;
+	}
+	Stroke &stroke = strokes_[found->second];
+	if(stroke.is_erased) {
+		return;
+	}
+	stroke.is_erased = true;
+	if(stroke.is_end) {
+		remove(found->second);
+		erased_points_ += stroke.count;
+		stroke.count = 0;
+		if(erased_points_ > x_.size()/2) {
+			compact();
+		}
+	}
+	else {
+		open_.erase(key);
+	}
+}
+void ofxSNNStrokeStore::reset(const Key &key)
+{
+	auto found = index_.find(key);
+	if(found == end(index_)) {
+		return;
+	}
+	Stroke &stroke = strokes_[found->second];
+	if(stroke.is_erased) {
+		return;
+	}
+	if(stroke.is_end) {
+		remove(found->second);
+		erased_points_ += stroke.count;
+		stroke.count = 0;
+		stroke.is_end = false;
+	}
+	else {
+		open_.erase(key);
+	}
+	stroke.length = 0;
+	const float inf = numeric_limits<float>::max();
+	stroke.box.min = ofVec3f(inf, inf, inf);
+	stroke.box.max = ofVec3f(-inf, -inf, -inf);
+	if(erased_points_ > x_.size()/2) {
+		compact();
+	}
+}
+void ofxSNNStrokeStore::compact()
+{
+	// moved in the order they were packed, so nothing is overwritten before it is moved.
+	// strokes end in another order than they start, and reset ones are packed again at the end
+	vector<size_t> packed;
+	for(size_t i = 0; i < strokes_.size(); ++i) {
+		if(strokes_[i].is_end && !strokes_[i].is_erased) {
+			packed.push_back(i);
+		}
+	}
+	sort(begin(packed), end(packed), [this](size_t a, size_t b) {
+		return strokes_[a].offset < strokes_[b].offset;
+	});
+	size_t dst = 0;
+	for(auto index : packed) {
+		Stroke &stroke = strokes_[index];
+		for(size_t i = 0; i < stroke.count; ++i) {
+			x_[dst+i] = x_[stroke.offset+i];
+			y_[dst+i] = y_[stroke.offset+i];
+			if(settings_.dimensions == 3) {
+				z_[dst+i] = z_[stroke.offset+i];
+			}
+		}
+		stroke.offset = dst;
+		dst += stroke.count;
+	}
+	x_.resize(dst);
+	y_.resize(dst);
+	z_.resize(settings_.dimensions == 3 ? dst : 0);
+	x_.shrink_to_fit();
+	y_.shrink_to_fit();
+	z_.shrink_to_fit();
+	erased_points_ = 0;
+}
+void ofxSNNStrokeStore::clear()
+{
+	strokes_.clear();
+	index_.clear();
+	open_.clear();
+	x_.clear();
+	y_.clear();
+	z_.clear();
+	erased_points_ = 0;
+	nodes_.clear();
+}
+
+const ofxSNNStrokeStore::Stroke* ofxSNNStrokeStore::getStroke(const Key &key) const
+{
+	auto found = index_.find(key);
+	return found == end(index_) ? nullptr : &strokes_[found->second];
+}
+void ofxSNNStrokeStore::getPoints(const Stroke &stroke, vector<ofVec3f> &points) const
+{
+	points.clear();
+	if(!stroke.is_end) {
+		auto found = open_.find(Key(stroke.author, stroke.id));
+		if(found != end(open_)) {
+			points = found->second;
+		}
+		return;
+	}
+	points.resize(stroke.count);
+	for(size_t i = 0; i < stroke.count; ++i) {
+		size_t index = stroke.offset+i;
+		points[i] = ofVec3f(x_[index], y_[index], settings_.dimensions == 3 ? z_[index] : 0);
+	}
+}
+
+void ofxSNNStrokeStore::query(const Box &box, vector<Key> &keys) const
+{
+	keys.clear();
+	// the ones being drawn are few and still growing, so they are not in the tree
+	for(auto &open : open_) {
+		const Stroke &stroke = strokes_[index_.at(open.first)];
+		if(stroke.box.intersects(box)) {
+			keys.push_back(open.first);
+		}
+	}
+	if(nodes_.empty()) {
+		return;
+	}
+	vector<int> stack{0};
+	while(!stack.empty()) {
+		const Node &node = nodes_[stack.back()];
+		stack.pop_back();
+		if(!node.box.intersects(box)) {
+			continue;
+		}
+		for(uint32_t item : node.items) {
+			const Stroke &stroke = strokes_[item];
+			if(stroke.box.intersects(box)) {
+				keys.emplace_back(stroke.author, stroke.id);
+			}
+		}
+		if(node.children >= 0) {
+			for(int i = 0; i < getNumChildren(); ++i) {
+				stack.push_back(node.children+i);
+			}
+		}
+	}
+}
+void ofxSNNStrokeStore::hitTest(const ofVec3f &pos, float radius, vector<Key> &keys) const
+{
+	vector<Key> candidates;
+	query(Box::around(pos, radius), candidates);
+	keys.clear();
+	vector<ofVec3f> points;
+	for(auto &key : candidates) {
+		const Stroke &stroke = strokes_[index_.at(key)];
+		float distance = radius + stroke.style.width/2;
+		getPoints(stroke, points);
+		bool hit = points.size() == 1 && pos.squareDistance(points[0]) <= distance*distance;
+		for(size_t i = 1; i < points.size() && !hit; ++i) {
+			hit = getSquareDistanceToSegment(pos, points[i-1], points[i]) <= distance*distance;
+		}
+		if(hit) {
+			keys.push_back(key);
+		}
+	}
+}
+
+size_t ofxSNNStrokeStore::getNumPoints() const
+{
+	size_t ret = x_.size() - erased_points_;
+	for(auto &open : open_) {
+		ret += open.second.size();
+	}
+	return ret;
+}
+size_t ofxSNNStrokeStore::getMemoryUsage() const
+{
+	size_t ret = (x_.capacity() + y_.capacity() + z_.capacity())*sizeof(float);
+	ret += strokes_.capacity()*sizeof(Stroke);
+	for(auto &open : open_) {
+		ret += open.second.capacity()*sizeof(ofVec3f);
+	}
+	for(auto &node : nodes_) {
+		ret += sizeof(Node) + node.items.capacity()*sizeof(uint32_t);
+	}
+	return ret;
+}
+
+ofxSNNStrokeStore::Box ofxSNNStrokeStore::getChildBox(const Box &box, int child) const
+{
+	Box ret = box;
+	ofVec3f center = (box.min + box.max)*0.5f;
+	for(int i = 0; i < settings_.dimensions; ++i) {
+		if(child & (1 << i)) {
+			ret.min[i] = center[i];
+		}
+		else {
+			ret.max[i] = center[i];
+		}
+	}
+	return ret;
+}
+void ofxSNNStrokeStore::insert(uint32_t index)
+{
+	Stroke &stroke = strokes_[index];
+	if(nodes_.empty()) {
+		// a cube around the first stroke. grown later as needed
+		ofVec3f center = (stroke.box.min + stroke.box.max)*0.5f;
+		ofVec3f extent = stroke.box.max - stroke.box.min;
+		float half = max(max(extent.x, max(extent.y, extent.z)), 512.f);
+		nodes_.emplace_back();
+		nodes_[0].box = Box::around(center, half);
+	}
+	grow(stroke.box);
+	int current = 0;
+	while(true) {
+		Node &node = nodes_[current];
+		if(node.children < 0) {
+			if(node.items.size() < settings_.node_capacity || node.depth >= settings_.max_depth) {
+				break;
+			}
+			split(current);
+		}
+		int next = -1;
+		for(int i = 0; i < getNumChildren(); ++i) {
+			if(nodes_[nodes_[current].children+i].box.contains(stroke.box)) {
+				next = nodes_[current].children+i;
+				break;
+			}
+		}
+		if(next < 0) {
+			break;
+		}
+		current = next;
+	}
+	nodes_[current].items.push_back(index);
+	stroke.node = current;
+}
+void ofxSNNStrokeStore::remove(uint32_t index)
+{
+	Stroke &stroke = strokes_[index];
+	if(stroke.node < 0) {
+		return;
+	}
+	auto &items = nodes_[stroke.node].items;
+	auto found = find(begin(items), end(items), index);
+	if(found != end(items)) {
+		*found = items.back();
+		items.pop_back();
+	}
+	stroke.node = -1;
+}
+void ofxSNNStrokeStore::grow(const Box &box)
+{
+	// doubles the root towards the box, keeping the old root as one of the children
+	while(!nodes_[0].box.contains(box)) {
+		Box old_box = nodes_[0].box;
+		ofVec3f size = old_box.max - old_box.min;
+		Box new_box = old_box;
+		int slot = 0;
+		for(int i = 0; i < settings_.dimensions; ++i) {
+			if(box.min[i] < old_box.min[i]) {
+				new_box.min[i] -= size[i];
+				slot |= 1 << i;
+			}
+			else {
+				new_box.max[i] += size[i];
+			}
+		}
+		for(int i = settings_.dimensions; i < 3; ++i) {
+			new_box.min[i] = min(new_box.min[i], box.min[i]);
+			new_box.max[i] = max(new_box.max[i], box.max[i]);
+		}
+		int children = nodes_.size();
+		nodes_.resize(nodes_.size() + getNumChildren());
+		for(int i = 0; i < getNumChildren(); ++i) {
+			nodes_[children+i].box = getChildBox(new_box, i);
+		}
+		nodes_[children+slot] = move(nodes_[0]);
+		nodes_[children+slot].box = getChildBox(new_box, slot);
+		nodes_[0] = Node();
+		nodes_[0].box = new_box;
+		nodes_[0].children = children;
+		// every node moved one level deeper
+		for(auto &node : nodes_) {
+			++node.depth;
+		}
+		nodes_[0].depth = 0;
+		for(auto &stroke : strokes_) {
+			if(stroke.node == 0) {
+				stroke.node = children+slot;
+			}
+		}
+	}
+}
+void ofxSNNStrokeStore::split(int index)
+{
+	int children = nodes_.size();
+	nodes_.resize(nodes_.size() + getNumChildren());
+	Node &node = nodes_[index];
+	node.children = children;
+	for(int i = 0; i < getNumChildren(); ++i) {
+		nodes_[children+i].box = getChildBox(node.box, i);
+		nodes_[children+i].depth = node.depth+1;
+	}
+	auto items = move(node.items);
+	node.items.clear();
+	for(uint32_t item : items) {
+		Stroke &stroke = strokes_[item];
+		int target = index;
+		for(int i = 0; i < getNumChildren(); ++i) {
+			if(nodes_[children+i].box.contains(stroke.box)) {
+				target = children+i;
+				break;
+			}
+		}
+		nodes_[target].items.push_back(item);
+		stroke.node = target;
+	}
+}
@@ -0,0 +1,111 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofxSNNStrokeStream.h"
+#include <map>
+#include <set>
+
+// keeps the history of strokes compact and searchable.
+// a stroke is kept as it comes while it is being drawn.
+// when it ends it is simplified and its points are packed into one array per coordinate,
+// and it is put in a quadtree (an octree for 3 dimensions) so that region queries and hit tests only visit strokes nearby.
+class ofxSNNStrokeStore
+{
+public:
+	struct Settings {
+		// 2 for the plane, 3 for the space
+		int dimensions=2;
+		// points within this distance from the simplified line are dropped when a stroke ends. 0 keeps every point
+		float tolerance=0.5f;
+		// a node of the tree holding more strokes than this is divided
+		std::size_t node_capacity=16;
+		int max_depth=16;
+	};
+	using Key = std::pair<uint32_t,uint32_t>;
+	struct Box {
+		ofVec3f min, max;
+		void add(const ofVec3f &pos);
+		bool intersects(const Box &box) const;
+		bool contains(const Box &box) const;
+		static Box around(const ofVec3f &pos, float radius);
+	};
+	struct Stroke {
+		uint32_t author;
+		uint32_t id;
+		ofxSNNStrokeStream::Style style;
+		bool is_end=false;
+		bool is_erased=false;
+		// points received, which can be more than the ones kept
+		uint32_t length=0;
+		Box box;
+		// range in the arena once ended
+		std::size_t offset=0;
+		std::size_t count=0;
+		int node=-1;
+	};
+
+	void setup(const Settings &settings);
+	void setup() { setup(Settings()); }
+	const Settings& getSettings() const { return settings_; }
+
+	// returns how many points at the end of points are new.
+	// the rest were known already, and all of them are ignored for an erased stroke
+	std::size_t add(const ofxSNNStrokeStream::Points &points);
+	// the stroke is remembered as erased so the points still coming for it are ignored
+	void erase(const Key &key);
+	// forgets the points of a stroke so it can be added again from the start
+	void reset(const Key &key);
+	void clear();
+
+	const Stroke* getStroke(const Key &key) const;
+	// in the order they appeared, erased ones included
+	const std::vector<Stroke>& getStrokes() const { return strokes_; }
+	void getPoints(const Stroke &stroke, std::vector<ofVec3f> &points) const;
+
+	// strokes whose bounding box intersects box
+	void query(const Box &box, std::vector<Key> &keys) const;
+	// strokes whose line passes within radius from pos
+	void hitTest(const ofVec3f &pos, float radius, std::vector<Key> &keys) const;
+
+	// points kept, and the bytes used for them and the strokes
+	std::size_t getNumPoints() const;
+	std::size_t getMemoryUsage() const;
+private:
+	Settings settings_;
+	std::vector<Stroke> strokes_;
+	std::map<Key, std::size_t> index_;
+
+	// columns of the points of ended strokes
+	std::vector<float> x_, y_, z_;
+	std::size_t erased_points_=0;
+	void pack(Stroke &stroke, const std::vector<ofVec3f> &points);
+	void compact();
+	// strokes being drawn
+	std::map<Key, std::vector<ofVec3f>> open_;
+
+	struct Node {
+		Box box;
+		int depth=0;
+		// index of the first child, -1 for a leaf
+		int children=-1;
+		std::vector<uint32_t> items;
+	};
+	std::vector<Node> nodes_;
+	int getNumChildren() const { return 1 << settings_.dimensions; }
+	Box getChildBox(const Box &box, int child) const;
+	void insert(uint32_t index);
+	void remove(uint32_t index);
+	void grow(const Box &box);
+	void split(int node);
+};
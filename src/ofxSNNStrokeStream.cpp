@@ -0,0 +1,436 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ofxSNNStrokeStream.h"
+#include "ofLog.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+// a datagram is
+//   uint8 dimensions, float32 resolution, then records until the end.
+// a record is
+//   uint8 flags, [varint author], varint stroke, varint index, [float32 width, uint8 rgba],
+//   varint count, then the first point in absolute and the rest as differences from the previous one,
+//   every coordinate as a zigzag varint of the quantized value.
+// author and style are written only when they differ from the previous record in the same datagram.
+namespace {
+	enum Flag : uint8_t {
+		FLAG_AUTHOR = 1,
+		FLAG_STYLE = 2,
+		FLAG_END = 4,
+	};
+	const size_t MAX_VARINT_SIZE = 5;
+	void putVarint(vector<char> &dst, uint32_t value) {
+		while(value >= 0x80) {
+			dst.push_back((char)(value | 0x80));
+			value >>= 7;
+		}
+		dst.push_back((char)value);
+	}
+	bool getVarint(const char *&src, const char *end, uint32_t &value) {
+		value = 0;
+		for(int shift = 0; shift < 35 && src < end; shift += 7) {
+			uint8_t byte = *src++;
+			value |= (uint32_t)(byte & 0x7f) << shift;
+			if(!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+	size_t getVarintSize(uint32_t value) {
+		size_t size = 1;
+		while(value >= 0x80) {
+			value >>= 7;
+			++size;
+		}
+		return size;
+	}
+	uint32_t zigzag(int32_t value) {
+		return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	}
+	int32_t unzigzag(uint32_t value) {
+		return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+	}
+	void putFloat(vector<char> &dst, float value) {
+		char bytes[sizeof(float)];
+		memcpy(bytes, &value, sizeof(float));
+		dst.insert(end(dst), bytes, bytes+sizeof(float));
+	}
+	bool getFloat(const char *&src, const char *end, float &value) {
+		if(end-src < (ptrdiff_t)sizeof(float)) {
+			return false;
+		}
+		memcpy(&value, src, sizeof(float));
+		src += sizeof(float);
+		return true;
+	}
+}
+
+ofxSNNStrokeStream::~ofxSNNStrokeStream()
+{
+	if(node_) {
+		ofRemoveListener(ofEvents().update, this, &ofxSNNStrokeStream::update);
+		ofRemoveListener(node_->unhandledMessageReceived, this, &ofxSNNStrokeStream::messageReceived);
+	}
+}
+void ofxSNNStrokeStream::setup(ofxSearchNetworkNode &node, const Settings &settings)
+{
+	if(node_) {
+		ofLogWarning("ofxSNNStrokeStream") << "setup can be called only once";
+		return;
+	}
+	node_ = &node;
+	settings_ = settings;
+	settings_.dimensions = settings_.dimensions == 3 ? 3 : 2;
+	random_device seed;
+	author_ = uniform_int_distribution<uint32_t>()(seed);
+	ofAddListener(ofEvents().update, this, &ofxSNNStrokeStream::update);
+	ofAddListener(node_->unhandledMessageReceived, this, &ofxSNNStrokeStream::messageReceived);
+}
+
+ofxSNNStrokeStream::Quantized ofxSNNStrokeStream::quantize(const ofVec3f &pos) const
+{
+	const float limit = numeric_limits<int32_t>::max()/2;
+	Quantized ret{{0,0,0}};
+	for(int i = 0; i < settings_.dimensions; ++i) {
+		ret[i] = (int32_t)lround(max(-limit, min(pos[i]/settings_.resolution, limit)));
+	}
+	return ret;
+}
+
+uint32_t ofxSNNStrokeStream::begin(const ofVec3f &pos, const Style &style)
+{
+	if(is_drawing_) {
+		end();
+	}
+	is_drawing_ = true;
+	stroke_ = next_stroke_++;
+	num_points_ = 0;
+	style_ = style;
+	addPoint(pos, true);
+	return stroke_;
+}
+void ofxSNNStrokeStream::add(const ofVec3f &pos)
+{
+	if(!is_drawing_) {
+		return;
+	}
+	addPoint(pos, false);
+}
+void ofxSNNStrokeStream::end(const ofVec3f &pos)
+{
+	add(pos);
+	end();
+}
+void ofxSNNStrokeStream::end()
+{
+	if(!is_drawing_) {
+		return;
+	}
+	getOpenRecord().is_end = true;
+	is_drawing_ = false;
+}
+void ofxSNNStrokeStream::setStyle(const Style &style)
+{
+	if(style == style_) {
+		return;
+	}
+	if(!is_drawing_) {
+		style_ = style;
+		return;
+	}
+	// continue from where the current stroke ends
+	Quantized last = last_point_;
+	end();
+	is_drawing_ = true;
+	stroke_ = next_stroke_++;
+	num_points_ = 0;
+	style_ = style;
+	Record &record = getOpenRecord();
+	record.coords.insert(record.coords.end(), last.begin(), last.begin()+settings_.dimensions);
+	last_point_ = last;
+	++num_points_;
+}
+void ofxSNNStrokeStream::addPoint(const ofVec3f &pos, bool force)
+{
+	Quantized point = quantize(pos);
+	// the pen staying still adds nothing
+	if(!force && num_points_ > 0 && point == last_point_) {
+		return;
+	}
+	Record &record = getOpenRecord();
+	record.coords.insert(record.coords.end(), point.begin(), point.begin()+settings_.dimensions);
+	last_point_ = point;
+	++num_points_;
+}
+ofxSNNStrokeStream::Record& ofxSNNStrokeStream::getOpenRecord()
+{
+	if(pending_.empty() || pending_.back().stroke != stroke_ || pending_.back().is_end) {
+		Record record;
+		record.author = author_;
+		record.stroke = stroke_;
+		record.index = num_points_;
+		record.style = style_;
+		pending_.push_back(record);
+	}
+	return pending_.back();
+}
+
+ofxSNNStrokeStream::Record ofxSNNStrokeStream::makeRecord(uint32_t author, uint32_t stroke, const Style &style, const vector<ofVec3f> &points, bool is_end) const
+{
+	Record record;
+	record.author = author;
+	record.stroke = stroke;
+	record.index = 0;
+	record.style = style;
+	record.is_end = is_end;
+	record.coords.reserve(points.size()*settings_.dimensions);
+	for(auto &p : points) {
+		Quantized point = quantize(p);
+		record.coords.insert(record.coords.end(), point.begin(), point.begin()+settings_.dimensions);
+	}
+	return record;
+}
+void ofxSNNStrokeStream::encode(ofBuffer &buffer, uint32_t author, uint32_t stroke, const Style &style, const vector<ofVec3f> &points, bool is_end) const
+{
+	Record record = makeRecord(author, stroke, style, points, is_end);
+	vector<char> data;
+	if(buffer.size() == 0) {
+		writeHeader(data);
+	}
+	writeRecordHead(data, FLAG_AUTHOR | FLAG_STYLE | (is_end ? FLAG_END : 0), record, 0);
+	putVarint(data, points.size());
+	for(size_t i = 0; i < points.size(); ++i) {
+		writePoint(data, record, i, i == 0);
+	}
+	buffer.append(data.data(), data.size());
+}
+bool ofxSNNStrokeStream::decode(const ofBuffer &buffer, vector<Points> &strokes) const
+{
+	return decode(buffer.getData(), buffer.size(), "", strokes);
+}
+
+void ofxSNNStrokeStream::update(ofEventArgs&)
+{
+	if(pending_.empty()) {
+		return;
+	}
+	send(pending_, "");
+	pending_.clear();
+}
+
+size_t ofxSNNStrokeStream::getDatagramLimit(const string &ip) const
+{
+	size_t size = numeric_limits<size_t>::max();
+	if(ip.empty()) {
+		for(auto &n : node_->getNodes()) {
+			size = min(size, node_->getMaxDatagramSize(n.first));
+		}
+	}
+	if(size == numeric_limits<size_t>::max()) {
+		size = node_->getMaxDatagramSize(ip);
+	}
+	return size > MESSAGE_OVERHEAD ? size-MESSAGE_OVERHEAD : 0;
+}
+void ofxSNNStrokeStream::send(const vector<Record> &records, const string &ip)
+{
+	const size_t dimensions = settings_.dimensions;
+	const size_t limit = getDatagramLimit(ip);
+	const Record *prev = nullptr;
+	datagram_.clear();
+	for(auto &record : records) {
+		const size_t num_points = record.coords.size()/dimensions;
+		size_t offset = 0;
+		do {
+			if(datagram_.empty()) {
+				writeHeader(datagram_);
+				prev = nullptr;
+			}
+			uint8_t flags = 0;
+			if(!prev || prev->author != record.author) {
+				flags |= FLAG_AUTHOR;
+			}
+			if(!prev || prev->style != record.style) {
+				flags |= FLAG_STYLE;
+			}
+			auto &head = head_scratch_;
+			head.clear();
+			writeRecordHead(head, flags, record, record.index+offset);
+			// as many points as fit in the rest of the datagram
+			size_t room = limit > datagram_.size() ? limit-datagram_.size() : 0;
+			auto &body = body_scratch_;
+			body.clear();
+			size_t count = 0;
+			while(offset+count < num_points) {
+				size_t size = body.size();
+				writePoint(body, record, offset+count, count == 0);
+				if(head.size() + getVarintSize(count+1) + body.size() > room) {
+					body.resize(size);
+					break;
+				}
+				++count;
+			}
+			bool is_last = offset+count == num_points;
+			if((!is_last && count == 0) || head.size() + getVarintSize(count) > room) {
+				if(datagram_.size() <= 1+sizeof(float)) {
+					ofLogWarning("ofxSNNStrokeStream") << "datagram size is too small : " << limit;
+					datagram_.clear();
+					return;
+				}
+				sendDatagram(ip);
+				continue;
+			}
+			if(is_last && record.is_end) {
+				head[0] |= FLAG_END;
+			}
+			datagram_.insert(datagram_.end(), head.begin(), head.end());
+			putVarint(datagram_, count);
+			datagram_.insert(datagram_.end(), body.begin(), body.end());
+			offset += count;
+			stats_.points_sent += count;
+			prev = &record;
+		} while(offset < num_points);
+	}
+	if(!datagram_.empty()) {
+		sendDatagram(ip);
+	}
+}
+void ofxSNNStrokeStream::writeHeader(vector<char> &dst) const
+{
+	dst.push_back((char)settings_.dimensions);
+	putFloat(dst, settings_.resolution);
+}
+void ofxSNNStrokeStream::writeRecordHead(vector<char> &dst, uint8_t flags, const Record &record, uint32_t index) const
+{
+	dst.push_back(flags);
+	if(flags & FLAG_AUTHOR) {
+		putVarint(dst, record.author);
+	}
+	putVarint(dst, record.stroke);
+	putVarint(dst, index);
+	if(flags & FLAG_STYLE) {
+		putFloat(dst, record.style.width);
+		dst.push_back(record.style.color.r);
+		dst.push_back(record.style.color.g);
+		dst.push_back(record.style.color.b);
+		dst.push_back(record.style.color.a);
+	}
+}
+void ofxSNNStrokeStream::writePoint(vector<char> &dst, const Record &record, size_t index, bool is_absolute) const
+{
+	const size_t dimensions = settings_.dimensions;
+	const int32_t *point = &record.coords[index*dimensions];
+	for(size_t i = 0; i < dimensions; ++i) {
+		putVarint(dst, zigzag(is_absolute ? point[i] : point[i]-point[i-dimensions]));
+	}
+}
+void ofxSNNStrokeStream::sendDatagram(const string &ip)
+{
+	ofxOscMessage msg;
+	msg.setAddress(address_);
+	ofBuffer blob;
+	blob.set(datagram_.data(), datagram_.size());
+	msg.addBlobArg(blob);
+	if(ip.empty()) {
+		node_->sendMessage(msg);
+	}
+	else {
+		node_->sendMessage(ip, msg);
+	}
+	++stats_.datagrams_sent;
+	stats_.bytes_sent += datagram_.size();
+	datagram_.clear();
+}
+
+void ofxSNNStrokeStream::messageReceived(ofxOscMessage &msg)
+{
+	if(msg.getAddress() != address_) {
+		return;
+	}
+	if(msg.getNumArgs() < 1 || msg.getArgType(0) != OFXOSC_TYPE_BLOB) {
+		ofLogWarning("ofxSNNStrokeStream") << "received broken packet from " << msg.getRemoteHost();
+		return;
+	}
+	const ofBuffer &blob = msg.getArgAsBlob(0);
+	++stats_.datagrams_received;
+	stats_.bytes_received += blob.size();
+	received_.clear();
+	bool ok = decode(blob.getData(), blob.size(), msg.getRemoteHost(), received_);
+	// the records before a broken one are still good
+	for(auto &points : received_) {
+		stats_.points_received += points.points.size();
+		ofNotifyEvent(pointsReceived, points, this);
+	}
+	if(!ok) {
+		ofLogWarning("ofxSNNStrokeStream") << "received broken packet from " << msg.getRemoteHost();
+	}
+}
+bool ofxSNNStrokeStream::decode(const char *data, size_t size, const string &ip, vector<Points> &strokes) const
+{
+	const char *src = data;
+	const char *src_end = src + size;
+	float resolution;
+	if(src == src_end) {
+		return false;
+	}
+	size_t dimensions = (uint8_t)*src++;
+	if((dimensions != 2 && dimensions != 3) || !getFloat(src, src_end, resolution)) {
+		return false;
+	}
+	Points points;
+	points.ip = ip;
+	bool has_author = false;
+	bool has_style = false;
+	while(src < src_end) {
+		uint8_t flags = *src++;
+		bool ok = true;
+		if(flags & FLAG_AUTHOR) {
+			ok = getVarint(src, src_end, points.author);
+			has_author = ok;
+		}
+		ok = ok && getVarint(src, src_end, points.stroke) && getVarint(src, src_end, points.index);
+		if(ok && (flags & FLAG_STYLE)) {
+			ok = getFloat(src, src_end, points.style.width) && src_end-src >= 4;
+			if(ok) {
+				points.style.color = ofColor((uint8_t)src[0], (uint8_t)src[1], (uint8_t)src[2], (uint8_t)src[3]);
+				src += 4;
+			}
+			has_style = ok;
+		}
+		uint32_t count = 0;
+		ok = ok && has_author && has_style && getVarint(src, src_end, count);
+		// every point takes a byte at least
+		if(!ok || count > (size_t)(src_end-src)/dimensions) {
+			return false;
+		}
+		points.is_end = (flags & FLAG_END) != 0;
+		points.points.resize(count);
+		Quantized point{{0,0,0}};
+		for(uint32_t i = 0; i < count; ++i) {
+			for(size_t d = 0; d < dimensions; ++d) {
+				uint32_t value;
+				if(!getVarint(src, src_end, value)) {
+					return false;
+				}
+				point[d] = (i == 0 ? 0 : point[d]) + unzigzag(value);
+			}
+			points.points[i] = ofVec3f(point[0]*resolution, point[1]*resolution, point[2]*resolution);
+		}
+		strokes.push_back(points);
+	}
+	return true;
+}
@@ -0,0 +1,135 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ofEvents.h"
+#include "ofVec3f.h"
+#include "ofColor.h"
+#include "ofxSearchNetworkNode.h"
+#include <array>
+
+// sends strokes as a compact binary stream.
+// points are quantized and delta encoded, and everything drawn within a frame goes out as one datagram from the update event.
+// each datagram can be decoded on its own, so a lost one only loses its own points.
+// a stroke has a single style; changing it while drawing continues in a new stroke.
+class ofxSNNStrokeStream
+{
+public:
+	struct Settings {
+		// 2 for the plane, 3 for the space
+		int dimensions=2;
+		// coordinates are rounded to multiples of this
+		float resolution=0.25f;
+	};
+	struct Style {
+		float width=1;
+		ofColor color=ofColor::black;
+		bool operator==(const Style &style) const { return width == style.width && color == style.color; }
+		bool operator!=(const Style &style) const { return !(*this == style); }
+	};
+	// a run of points of a stroke.
+	// a stroke is identified by author and stroke, and index is the position of the first point in it
+	struct Points {
+		std::string ip;
+		uint32_t author;
+		uint32_t stroke;
+		uint32_t index;
+		Style style;
+		bool is_end;
+		std::vector<ofVec3f> points;
+	};
+	struct Stats {
+		uint64_t points_sent=0;
+		uint64_t datagrams_sent=0;
+		uint64_t bytes_sent=0;
+		uint64_t points_received=0;
+		uint64_t datagrams_received=0;
+		uint64_t bytes_received=0;
+	};
+
+	virtual ~ofxSNNStrokeStream();
+	void setup(ofxSearchNetworkNode &node, const Settings &settings);
+	void setup(ofxSearchNetworkNode &node) { setup(node, Settings()); }
+	const Settings& getSettings() const { return settings_; }
+	// call before setup
+	void setAddress(const std::string &address) { address_ = address; }
+	// chosen at random in setup, so strokes keep their identity when they are relayed by other nodes
+	uint32_t getAuthor() const { return author_; }
+
+	// returns the id of the new stroke
+	uint32_t begin(const ofVec3f &pos, const Style &style);
+	void add(const ofVec3f &pos);
+	void end(const ofVec3f &pos);
+	void end();
+	void setStyle(const Style &style);
+	bool isDrawing() const { return is_drawing_; }
+
+	// appends a stroke in the format of the datagrams but without the size limit, to make a snapshot
+	void encode(ofBuffer &buffer, uint32_t author, uint32_t stroke, const Style &style, const std::vector<ofVec3f> &points, bool is_end) const;
+	// appends every stroke in buffer to strokes. false if it is broken
+	bool decode(const ofBuffer &buffer, std::vector<Points> &strokes) const;
+
+	const Stats& getStats() const { return stats_; }
+
+	ofEvent<const Points> pointsReceived;
+
+	// room for the address, arguments and secret key of the message
+	static const std::size_t MESSAGE_OVERHEAD=64;
+private:
+	ofxSearchNetworkNode *node_=nullptr;
+	Settings settings_;
+	std::string address_="/stroke";
+	uint32_t author_=0;
+	Stats stats_;
+
+	using Quantized = std::array<int32_t, 3>;
+	Quantized quantize(const ofVec3f &pos) const;
+	struct Record {
+		uint32_t author;
+		uint32_t stroke;
+		uint32_t index;
+		Style style;
+		bool is_end=false;
+		// dimensions values per point
+		std::vector<int32_t> coords;
+	};
+	Record makeRecord(uint32_t author, uint32_t stroke, const Style &style, const std::vector<ofVec3f> &points, bool is_end) const;
+	void writeHeader(std::vector<char> &dst) const;
+	void writeRecordHead(std::vector<char> &dst, uint8_t flags, const Record &record, uint32_t index) const;
+	void writePoint(std::vector<char> &dst, const Record &record, std::size_t index, bool is_absolute) const;
+
+	// own stroke
+	bool is_drawing_=false;
+	uint32_t next_stroke_=0;
+	uint32_t stroke_=0;
+	uint32_t num_points_=0;
+	Style style_;
+	Quantized last_point_;
+	void addPoint(const ofVec3f &pos, bool force);
+	// records not yet sent, flushed every update
+	std::vector<Record> pending_;
+	Record& getOpenRecord();
+
+	std::vector<char> datagram_;
+	std::vector<char> head_scratch_;
+	std::vector<char> body_scratch_;
+	std::size_t getDatagramLimit(const std::string &ip) const;
+	// ip is empty to send to every node
+	void send(const std::vector<Record> &records, const std::string &ip);
+	void sendDatagram(const std::string &ip);
+
+	void update(ofEventArgs&);
+	void messageReceived(ofxOscMessage &msg);
+	std::vector<Points> received_;
+	bool decode(const char *data, std::size_t size, const std::string &ip, std::vector<Points> &strokes) const;
+};
@@ -0,0 +1,202 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "ofxSNNWhiteboard.h"
+#include "ofLog.h"
+#include <cstring>
+
+using namespace std;
+
+ofxSNNWhiteboard::~ofxSNNWhiteboard()
+{
+	if(node_) {
+		ofRemoveListener(stream_.pointsReceived, this, &ofxSNNWhiteboard::pointsReceived);
+		ofRemoveListener(log_.opReceived, this, &ofxSNNWhiteboard::opReceived);
+	}
+}
+void ofxSNNWhiteboard::setup(ofxSearchNetworkNode &node, const Settings &settings)
+{
+	if(node_) {
+		ofLogWarning("ofxSNNWhiteboard") << "setup can be called only once";
+		return;
+	}
+	node_ = &node;
+	settings_ = settings;
+	settings_.stream.dimensions = settings_.store.dimensions = settings_.dimensions;
+	stream_.setup(node, settings_.stream);
+	ofAddListener(stream_.pointsReceived, this, &ofxSNNWhiteboard::pointsReceived);
+	store_.setup(settings_.store);
+	mesh_.setup(settings_.mesh);
+	log_.setup(node, settings_.log);
+	ofAddListener(log_.opReceived, this, &ofxSNNWhiteboard::opReceived);
+}
+
+void ofxSNNWhiteboard::erase(const ofVec3f &pos, float radius)
+{
+	vector<ofxSNNStrokeStore::Key> keys;
+	store_.hitTest(pos, radius, keys);
+	if(keys.empty()) {
+		return;
+	}
+	ofBuffer payload;
+	char type = OP_ERASE;
+	payload.append(&type, 1);
+	for(auto &key : keys) {
+		payload.append(reinterpret_cast<const char*>(&key.first), 4);
+		payload.append(reinterpret_cast<const char*>(&key.second), 4);
+	}
+	log_.append(payload);
+}
+void ofxSNNWhiteboard::clear()
+{
+	char type = OP_CLEAR;
+	log_.append(ofBuffer(&type, 1));
+}
+void ofxSNNWhiteboard::addPoints(const ofxSNNStrokeStream::Points &points)
+{
+	size_t added = store_.add(points);
+	const ofVec3f *data = points.points.data() + points.points.size()-added;
+	mesh_.add(points.author, points.stroke, points.style.color, points.style.width, data, added);
+}
+
+void ofxSNNWhiteboard::sync()
+{
+	log_.sync();
+}
+void ofxSNNWhiteboard::reset()
+{
+	log_.reset();
+	cleared_at_ = make_pair(0, 0);
+	clearStrokes();
+}
+
+void ofxSNNWhiteboard::pointsReceived(const ofxSNNStrokeStream::Points &points)
+{
+	ofxSNNStrokeStore::Key key(points.author, points.stroke);
+	const ofxSNNStrokeStore::Stroke *stroke = store_.getStroke(key);
+	bool was_end = stroke && stroke->is_end;
+	addPoints(points);
+	// our own stroke goes in the log once it is complete, as the copy every node ends up with
+	stroke = store_.getStroke(key);
+	if(points.author == stream_.getAuthor() && !was_end && stroke && stroke->is_end && !stroke->is_erased) {
+		appendStroke(*stroke);
+	}
+}
+
+void ofxSNNWhiteboard::opReceived(const ofxSNNReplicatedLog::Op &op)
+{
+	if(op.payload.size() < 1) {
+		return;
+	}
+	const char *data = op.payload.getData();
+	auto at = make_pair(op.lamport, op.author);
+	switch(data[0]) {
+		case OP_STROKE:
+			// a stroke from before the clear is dropped even if its live points came after the clear
+			applyStroke(op.payload, at > cleared_at_);
+			break;
+		case OP_ERASE:
+			for(size_t i = 1; i+8 <= op.payload.size(); i += 8) {
+				uint32_t author, id;
+				memcpy(&author, data+i, 4);
+				memcpy(&id, data+i+4, 4);
+				store_.erase(make_pair(author, id));
+				mesh_.remove(author, id);
+			}
+			break;
+		case OP_CLEAR:
+			if(at <= cleared_at_) {
+				break;
+			}
+			// the board is built again from what the log has after the clear, whenever the clear comes
+			cleared_at_ = at;
+			clearStrokes();
+			log_.forEach([this](const ofxSNNReplicatedLog::Op &op) { opReceived(op); });
+			// nothing before the clear is drawn again, so the log can let it go once everyone has it
+			log_.truncate(op.lamport, op.author);
+			break;
+	}
+}
+
+void ofxSNNWhiteboard::appendStroke(const ofxSNNStrokeStore::Stroke &stroke)
+{
+	vector<ofVec3f> points;
+	store_.getPoints(stroke, points);
+	ofBuffer encoded;
+	stream_.encode(encoded, stroke.author, stroke.id, stroke.style, points, true);
+	char head[5];
+	head[0] = OP_STROKE;
+	memcpy(head+1, &stroke.length, 4);
+	ofBuffer payload(head, sizeof(head));
+	payload.append(encoded.getData(), encoded.size());
+	log_.append(payload);
+}
+
+void ofxSNNWhiteboard::applyStroke(const ofBuffer &payload, bool is_visible)
+{
+	uint32_t length;
+	vector<ofxSNNStrokeStream::Points> strokes;
+	if(payload.size() < 5) {
+		ofLogWarning("ofxSNNWhiteboard") << "received broken stroke";
+		return;
+	}
+	memcpy(&length, payload.getData()+1, 4);
+	if(!stream_.decode(ofBuffer(payload.getData()+5, payload.size()-5), strokes)) {
+		ofLogWarning("ofxSNNWhiteboard") << "received broken stroke";
+		return;
+	}
+	for(auto &points : strokes) {
+		ofxSNNStrokeStore::Key key(points.author, points.stroke);
+		const ofxSNNStrokeStore::Stroke *stroke = store_.getStroke(key);
+		if(!is_visible) {
+			// erased, so the points still coming through the stream are ignored too
+			if(stroke) {
+				store_.erase(key);
+				mesh_.remove(points.author, points.stroke);
+			}
+			continue;
+		}
+		// we got every point through the stream, so we simplified them the same way
+		if(stroke && stroke->is_end && stroke->length == length) {
+			continue;
+		}
+		if(stroke) {
+			store_.reset(key);
+			mesh_.remove(points.author, points.stroke);
+		}
+		addPoints(points);
+	}
+}
+
+void ofxSNNWhiteboard::clearStrokes()
+{
+	// our own stroke being drawn goes in the log after the clear, so it is kept whole.
+	// dropping its start would log only the rest as the copy every node ends up with
+	vector<ofxSNNStrokeStream::Points> open;
+	for(auto &stroke : store_.getStrokes()) {
+		if(stroke.author != stream_.getAuthor() || stroke.is_end || stroke.is_erased) {
+			continue;
+		}
+		ofxSNNStrokeStream::Points points;
+		points.author = stroke.author;
+		points.stroke = stroke.id;
+		points.index = 0;
+		points.style = stroke.style;
+		points.is_end = false;
+		store_.getPoints(stroke, points.points);
+		open.push_back(move(points));
+	}
+	store_.clear();
+	mesh_.clear();
+	for(auto &points : open) {
+		addPoints(points);
+	}
+}
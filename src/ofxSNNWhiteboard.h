@@ -0,0 +1,92 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2018 nariakiiwatani
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "ofxSearchNetworkNode.h"
+#include "ofxSNNStrokeStream.h"
+#include "ofxSNNReplicatedLog.h"
+#include "ofxSNNStrokeStore.h"
+#include "ofxSNNStrokeMesh.h"
+
+// a board of strokes shared by every node.
+// strokes are drawn live through the stroke stream and, once complete, go in the replicated log along with erases and clears.
+// the board is made of the operations in the log alone, so every node ends up drawing the same.
+class ofxSNNWhiteboard
+{
+public:
+	struct Settings {
+		// 2 for the plane, 3 for the space. overrides the ones of the stream and the store
+		int dimensions=2;
+		ofxSNNStrokeStream::Settings stream;
+		ofxSNNStrokeStore::Settings store;
+		ofxSNNStrokeMesh::Settings mesh;
+		ofxSNNReplicatedLog::Settings log;
+	};
+
+	virtual ~ofxSNNWhiteboard();
+	void setup(ofxSearchNetworkNode &node, const Settings &settings);
+	void setup(ofxSearchNetworkNode &node) { setup(node, Settings()); }
+	const Settings& getSettings() const { return settings_; }
+
+	// own strokes, as in ofxSNNStrokeStream
+	uint32_t begin(const ofVec3f &pos, const ofxSNNStrokeStream::Style &style) { return stream_.begin(pos, style); }
+	void add(const ofVec3f &pos) { stream_.add(pos); }
+	void end(const ofVec3f &pos) { stream_.end(pos); }
+	void setStyle(const ofxSNNStrokeStream::Style &style) { stream_.setStyle(style); }
+	bool isDrawing() const { return stream_.isDrawing(); }
+	// erases the strokes passing within radius from pos, on every node
+	void erase(const ofVec3f &pos, float radius);
+	void clear();
+	// draws points on this node only, without sending or logging them
+	void addPoints(const ofxSNNStrokeStream::Points &points);
+
+	// pulls the board from the others
+	void sync();
+	bool isSyncing() const { return log_.isSyncing(); }
+	float getProgress() const { return log_.getProgress(); }
+	// forgets the board, as when leaving it
+	void reset();
+
+	void draw() const { mesh_.draw(); }
+	// skips the buffers whose bounding box is_visible returns false for
+	void draw(const std::function<bool(const ofVec3f &min, const ofVec3f &max)> &is_visible) const { mesh_.draw(is_visible); }
+
+	const ofxSNNStrokeStream& getStream() const { return stream_; }
+	const ofxSNNReplicatedLog& getLog() const { return log_; }
+	const ofxSNNStrokeStore& getStore() const { return store_; }
+	const ofxSNNStrokeMesh& getMesh() const { return mesh_; }
+private:
+	ofxSearchNetworkNode *node_=nullptr;
+	Settings settings_;
+	ofxSNNStrokeStream stream_;
+	ofxSNNReplicatedLog log_;
+	ofxSNNStrokeStore store_;
+	ofxSNNStrokeMesh mesh_;
+
+	// what goes in the log
+	enum OpType : uint8_t {
+		// uint32 points received by the author, then the stroke encoded by the stream
+		OP_STROKE,
+		// pairs of uint32 author and stroke
+		OP_ERASE,
+		OP_CLEAR,
+	};
+	// strokes before the latest clear in the order of the log are gone
+	std::pair<uint64_t,uint32_t> cleared_at_{0,0};
+	void pointsReceived(const ofxSNNStrokeStream::Points &points);
+	void opReceived(const ofxSNNReplicatedLog::Op &op);
+	void appendStroke(const ofxSNNStrokeStore::Stroke &stroke);
+	// a stroke that isn't visible is removed if its live points are on the board
+	void applyStroke(const ofBuffer &payload, bool is_visible);
+	// keeps our own strokes being drawn
+	void clearStrokes();
+};
@@ -12,12 +12,21 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #include "ofxSearchNetworkNode.h"
 #include "ofAppRunner.h"
+#include "ofMath.h"
+#include <random>
+#include <chrono>
+#include <cmath>
 
 using namespace std;
 
+constexpr float ofxSearchNetworkNode::RELIABLE_INITIAL_RTO;
+constexpr float ofxSearchNetworkNode::RELIABLE_MIN_RTO;
+constexpr float ofxSearchNetworkNode::RELIABLE_MAX_RTO;
+
 ofxSearchNetworkNode::ofxSearchNetworkNode()
 :prefix_("ofxSearchNetworkNode")
 ,is_sleep_(true)
+,main_thread_(this_thread::get_id())
 {
 	self_ip_ = NetworkUtils::getIPv4Interface();
 	for_each(begin(self_ip_), end(self_ip_), [this](const NetworkUtils::IPv4Interface &ip) {
@@ -31,6 +40,7 @@ ofxSearchNetworkNode::ofxSearchNetworkNode()
 void ofxSearchNetworkNode::sleep()
 {
 	if(!is_sleep_) {
+		flushSendQueue();
 		ofRemoveListener(ofEvents().update, this, &ofxSearchNetworkNode::update);
 		is_sleep_ = true;
 	}
@@ -101,14 +111,18 @@ void ofxSearchNetworkNode::disconnectFrom(const std::string &ip)
 		ofLogWarning("can't disconnect from unknown node : " + ip);
 		return;
 	}
-	unregisterNode(ip, it->second);
+	// goes out with the queued messages when unregistering
 	sendMessage(ip, createDisconnectMessage());
+	unregisterNode(ip, it->second);
 }
 void ofxSearchNetworkNode::flush()
 {
 	known_nodes_.clear();
+	publishPeers();
 	heartbeat_send_.clear();
 	heartbeat_recv_.clear();
+	path_mtu_.clear();
+	reliable_.clear();
 }
 void ofxSearchNetworkNode::enableSecretMode(const string &key)
 {
@@ -129,7 +143,9 @@ void ofxSearchNetworkNode::update(ofEventArgs&)
 		TimerArgs &timer = h.second;
 		timer.timer += frame_time;
 		if(timer.timer >= timer.limit) {
-			sendMessage(h.first, createHeartbeatMessage());
+			ofxOscMessage heartbeat = createHeartbeatMessage();
+			addAck(h.first, heartbeat);
+			sendMessage(h.first, heartbeat);
 			timer.timer -= timer.limit;
 		}
 	});
@@ -142,6 +158,13 @@ void ofxSearchNetworkNode::update(ofEventArgs&)
 			}
 		});
 	}
+	updateReliable();
+	float now = ofGetElapsedTimef();
+	for(auto &b : batches_) {
+		if(b.second.bundle.getMessageCount() > 0 && now-b.second.queued_at >= batch_delay_) {
+			sendBatch(b.first, b.second);
+		}
+	}
 }
 
 vector<string> ofxSearchNetworkNode::getGroups(const ofxOscMessage &msg, int &index) const
@@ -168,6 +191,7 @@ void ofxSearchNetworkNode::registerNode(const string &ip, const string &name, co
 	Node n{name, group, false};
 	auto result = known_nodes_.insert(make_pair(ip, n));
 	if(result.second) {
+		publishPeers();
 		ofNotifyEvent(nodeFound, *result.first);
 	}
 	else {
@@ -183,6 +207,9 @@ void ofxSearchNetworkNode::registerNode(const string &ip, const string &name, co
 		}
 	}
 	
+	if(path_mtu_.find(ip) == end(path_mtu_)) {
+		path_mtu_[ip] = NetworkUtils::getPathMTU(ip);
+	}
 	if(need_heartbeat_) {
 		heartbeat_recv_[ip] = TimerArgs{0, heartbeat_timeout_};
 	}
@@ -195,8 +222,19 @@ void ofxSearchNetworkNode::unregisterNode(const string &ip, const Node &n)
 {
 	Node cache = n;
 	known_nodes_.erase(ip);
+	publishPeers();
 	heartbeat_send_.erase(ip);
 	heartbeat_recv_.erase(ip);
+	path_mtu_.erase(ip);
+	reliable_.erase(ip);
+	// what was queued before the disconnection still goes out
+	auto batch = batches_.find(ip);
+	if(batch != end(batches_)) {
+		if(batch->second.bundle.getMessageCount() > 0) {
+			sendBatch(ip, batch->second);
+		}
+		batches_.erase(batch);
+	}
 	ofNotifyEvent(nodeDisconnected, make_pair(ip,cache));
 }
 void ofxSearchNetworkNode::lostNode(const string &ip)
@@ -204,6 +242,7 @@ void ofxSearchNetworkNode::lostNode(const string &ip)
 	auto it = known_nodes_.find(ip);
 	if(it != end(known_nodes_) && !it->second.lost) {
 		it->second.lost = true;
+		resetReliable(ip);
 		ofNotifyEvent(nodeLost, *it);
 	}
 }
@@ -227,6 +266,29 @@ string ofxSearchNetworkNode::getSelfIp(const string &an_ip_in_same_netwotk) cons
 	});
 	return it != end(self_ip_) ? it->ip : "";
 }
+size_t ofxSearchNetworkNode::getMaxDatagramSize(const string &ip) const
+{
+	const size_t ip_udp_header = 28;
+	const size_t max_udp_payload = 65507;
+	if(max_datagram_size_ > 0) {
+		return min(max_datagram_size_, max_udp_payload);
+	}
+	unsigned int mtu = 0;
+	auto it = path_mtu_.find(ip);
+	if(it != end(path_mtu_)) {
+		mtu = it->second;
+	}
+	if(mtu == 0) {
+		auto same_network = find_if(begin(self_ip_), end(self_ip_), [&ip](const NetworkUtils::IPv4Interface &me) {
+			return me.isInSameNetwork(ip);
+		});
+		mtu = same_network != end(self_ip_) ? same_network->mtu : 0;
+	}
+	if(mtu <= ip_udp_header) {
+		mtu = 1500;
+	}
+	return min<size_t>(mtu-ip_udp_header, max_udp_payload);
+}
 string ofxSearchNetworkNode::getSelfIpForInterface(const string &interface_name) const
 {
 	auto it = find_if(begin(self_ip_), end(self_ip_), [&interface_name](const NetworkUtils::IPv4Interface &me) {
@@ -289,8 +351,17 @@ void ofxSearchNetworkNode::messageReceived(ofxOscMessage &msg)
 			}
 			unregisterNode(ip, it->second);
 		}
+		else if(method == "reliable") {
+			reliableReceived(msg);
+		}
+		else if(method == "ack") {
+			ackReceived(msg.getRemoteHost(), msg, 0);
+		}
 		else if(method == "heartbeat") {
 			string ip = msg.getRemoteHost();
+			if(msg.getNumArgs() > 0) {
+				ackReceived(ip, msg, 0);
+			}
 			auto it = heartbeat_recv_.find(ip);
 			if(it == end(heartbeat_recv_)) {
 				ofLogWarning("received heartbeat message from unknown node : " + ip);
@@ -345,29 +416,439 @@ ofxOscMessage ofxSearchNetworkNode::createHeartbeatMessage() const
 void ofxSearchNetworkNode::disconnect()
 {
 	sendMessage(createDisconnectMessage());
+	flushSendQueue();
 	flush();
 }
 
+void ofxSearchNetworkNode::publishPeers()
+{
+	auto peers = make_shared<vector<string>>();
+	for(const auto &n : known_nodes_) {
+		peers->push_back(n.first);
+	}
+	atomic_store(&peers_, shared_ptr<const vector<string>>(peers));
+}
+bool ofxSearchNetworkNode::isSimulatedLoss() const
+{
+	float rate = simulated_loss_.load(memory_order_relaxed);
+	if(rate <= 0) {
+		return false;
+	}
+	// ofRandom isn't safe to call from other threads
+	thread_local minstd_rand engine(random_device{}());
+	return uniform_real_distribution<float>(0, 1)(engine) < rate;
+}
 void ofxSearchNetworkNode::sendMessage(const string &ip, ofxOscMessage msg) {
-	ofxOscSender sender;
-	sender.setup(ip, port_);
-	sender.sendMessage(msg);
+	if(shouldQueue()) {
+		queueMessage(ip, msg);
+		return;
+	}
+	sendNow(ip, msg);
 }
 void ofxSearchNetworkNode::sendMessage(ofxOscMessage msg) {
-	for_each(begin(known_nodes_), end(known_nodes_), [this,&msg](const pair<string,Node> &p) {
-		sendMessage(p.first, msg);
+	auto peers = atomic_load(&peers_);
+	if(!peers) {
+		return;
+	}
+	for_each(begin(*peers), end(*peers), [this,&msg](const string &ip) {
+		sendMessage(ip, msg);
 	});
 }
 
 void ofxSearchNetworkNode::sendBundle(const string &ip, ofxOscBundle bundle) {
+	// after what's queued, to keep the order
+	if(shouldQueue()) {
+		auto batch = batches_.find(ip);
+		if(batch != end(batches_) && batch->second.bundle.getMessageCount() > 0) {
+			sendBatch(ip, batch->second);
+		}
+	}
+	sendNow(ip, bundle);
+}
+void ofxSearchNetworkNode::sendBundle(ofxOscBundle bundle) {
+	auto peers = atomic_load(&peers_);
+	if(!peers) {
+		return;
+	}
+	for_each(begin(*peers), end(*peers), [this,&bundle](const string &ip) {
+		sendBundle(ip, bundle);
+	});
+}
+
+void ofxSearchNetworkNode::sendNow(const string &ip, const ofxOscMessage &msg)
+{
+	++messages_sent_;
+	++datagrams_sent_;
+	if(isSimulatedLoss()) {
+		return;
+	}
+	ofxOscSender sender;
+	sender.setup(ip, port_);
+	sender.sendMessage(msg);
+}
+void ofxSearchNetworkNode::sendNow(const string &ip, const ofxOscBundle &bundle)
+{
+	messages_sent_ += bundle.getMessageCount();
+	++datagrams_sent_;
+	if(isSimulatedLoss()) {
+		return;
+	}
 	ofxOscSender sender;
 	sender.setup(ip, port_);
 	sender.sendBundle(bundle);
 }
-void ofxSearchNetworkNode::sendBundle(ofxOscBundle bundle) {
-	for_each(begin(known_nodes_), end(known_nodes_), [this,&bundle](const pair<string,Node> &p) {
-		sendBundle(p.first, bundle);
-	});
+
+void ofxSearchNetworkNode::setBatching(bool batching, float max_delay)
+{
+	if(!batching) {
+		flushSendQueue();
+	}
+	is_batching_ = batching;
+	batch_delay_ = max_delay;
+}
+bool ofxSearchNetworkNode::shouldQueue() const
+{
+	// the thread first, the others are only safe to read on the main thread
+	return this_thread::get_id() == main_thread_ && is_batching_ && !is_sleep_;
+}
+void ofxSearchNetworkNode::queueMessage(const string &ip, const ofxOscMessage &msg)
+{
+	size_t size = getMessageSize(msg);
+	size_t limit = getMaxDatagramSize(ip);
+	auto &batch = batches_[ip];
+	if(batch.bundle.getMessageCount() > 0 && batch.size+size > limit) {
+		sendBatch(ip, batch);
+	}
+	// too large to share a datagram with others
+	if(BUNDLE_HEADER_SIZE+size > limit) {
+		sendNow(ip, msg);
+		return;
+	}
+	if(batch.bundle.getMessageCount() == 0) {
+		batch.size = BUNDLE_HEADER_SIZE;
+		batch.queued_at = ofGetElapsedTimef();
+	}
+	batch.bundle.addMessage(msg);
+	batch.size += size;
+}
+void ofxSearchNetworkNode::sendBatch(const string &ip, Batch &batch)
+{
+	if(batch.bundle.getMessageCount() == 1) {
+		sendNow(ip, batch.bundle.getMessageAt(0));
+	}
+	else {
+		sendNow(ip, batch.bundle);
+	}
+	batch.bundle.clear();
+}
+void ofxSearchNetworkNode::flushSendQueue()
+{
+	for(auto &b : batches_) {
+		if(b.second.bundle.getMessageCount() > 0) {
+			sendBatch(b.first, b.second);
+		}
+	}
+}
+ofxSearchNetworkNode::SendStats ofxSearchNetworkNode::getSendStats() const
+{
+	SendStats stats;
+	stats.messages_sent = messages_sent_.load();
+	stats.datagrams_sent = datagrams_sent_.load();
+	return stats;
+}
+namespace {
+	size_t pad4(size_t size) {
+		return (size+3) & ~(size_t)3;
+	}
+}
+size_t ofxSearchNetworkNode::getMessageSize(const ofxOscMessage &msg)
+{
+	// size prefix, address, type tags with the comma, then the arguments
+	size_t size = 4 + pad4(msg.getAddress().size()+1) + pad4(msg.getNumArgs()+2);
+	for(size_t i = 0; i < msg.getNumArgs(); ++i) {
+		switch(msg.getArgType(i)) {
+			case OFXOSC_TYPE_TRUE:
+			case OFXOSC_TYPE_FALSE:
+			case OFXOSC_TYPE_TRIGGER:
+				break;
+			case OFXOSC_TYPE_INT64:
+			case OFXOSC_TYPE_DOUBLE:
+			case OFXOSC_TYPE_TIMETAG:
+				size += 8;
+				break;
+			case OFXOSC_TYPE_STRING:
+				size += pad4(msg.getArgAsString(i).size()+1);
+				break;
+			case OFXOSC_TYPE_SYMBOL:
+				size += pad4(msg.getArgAsSymbol(i).size()+1);
+				break;
+			case OFXOSC_TYPE_BLOB:
+				size += 4 + pad4(msg.getArgAsBlob(i).size());
+				break;
+			default:
+				size += 4;
+				break;
+		}
+	}
+	return size;
+}
+
+namespace {
+	// copies the arguments from index on, for unwrapping reliable messages
+	void copyArgs(const ofxOscMessage &src, size_t index, ofxOscMessage &dst) {
+		for(; index < src.getNumArgs(); ++index) {
+			switch(src.getArgType(index)) {
+				case OFXOSC_TYPE_INT32: dst.addInt32Arg(src.getArgAsInt32(index)); break;
+				case OFXOSC_TYPE_INT64: dst.addInt64Arg(src.getArgAsInt64(index)); break;
+				case OFXOSC_TYPE_FLOAT: dst.addFloatArg(src.getArgAsFloat(index)); break;
+				case OFXOSC_TYPE_DOUBLE: dst.addDoubleArg(src.getArgAsDouble(index)); break;
+				case OFXOSC_TYPE_STRING: dst.addStringArg(src.getArgAsString(index)); break;
+				case OFXOSC_TYPE_SYMBOL: dst.addSymbolArg(src.getArgAsSymbol(index)); break;
+				case OFXOSC_TYPE_CHAR: dst.addCharArg(src.getArgAsChar(index)); break;
+				case OFXOSC_TYPE_MIDI_MESSAGE: dst.addMidiMessageArg(src.getArgAsMidiMessage(index)); break;
+				case OFXOSC_TYPE_TRUE:
+				case OFXOSC_TYPE_FALSE: dst.addBoolArg(src.getArgAsBool(index)); break;
+				case OFXOSC_TYPE_TRIGGER: dst.addTriggerArg(); break;
+				case OFXOSC_TYPE_TIMETAG: dst.addTimetagArg(src.getArgAsTimetag(index)); break;
+				case OFXOSC_TYPE_BLOB: dst.addBlobArg(src.getArgAsBlob(index)); break;
+				case OFXOSC_TYPE_RGBA_COLOR: dst.addRgbaColorArg(src.getArgAsRgbaColor(index)); break;
+				default:
+					ofLogWarning("ofxSearchNetworkNode") << "can't forward argument of type " << (char)src.getArgType(index) << " in " << src.getAddress();
+					break;
+			}
+		}
+	}
+	// microseconds of the wall clock, so a restarted process starts above the epochs it used before.
+	// always greater than the last one and never 0, which stands for no epoch yet
+	int64_t makeEpoch() {
+		static int64_t last = 0;
+		int64_t now = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+		last = max(now, last+1);
+		return last;
+	}
+}
+
+ofxSearchNetworkNode::ReliableChannel& ofxSearchNetworkNode::getReliableChannel(const string &ip)
+{
+	auto it = reliable_.find(ip);
+	if(it == end(reliable_)) {
+		it = reliable_.insert(make_pair(ip, ReliableChannel())).first;
+		it->second.epoch = makeEpoch();
+	}
+	return it->second;
+}
+void ofxSearchNetworkNode::resetReliable(const string &ip)
+{
+	auto it = reliable_.find(ip);
+	if(it == end(reliable_)) {
+		return;
+	}
+	auto &channel = it->second;
+	channel.epoch = makeEpoch();
+	channel.next_seq = 1;
+	channel.unacked.clear();
+	channel.waiting.clear();
+}
+void ofxSearchNetworkNode::sendReliable(const string &ip, ofxOscMessage msg)
+{
+	if(known_nodes_.find(ip) == end(known_nodes_)) {
+		ofLogWarning("can't send reliable message to unknown node : " + ip);
+		return;
+	}
+	auto &channel = getReliableChannel(ip);
+	if(channel.unacked.size() >= RELIABLE_WINDOW) {
+		if(channel.waiting.size() >= RELIABLE_MAX_WAITING) {
+			ofLogWarning("too many reliable messages waiting for node : " + ip);
+			return;
+		}
+		channel.waiting.push_back(msg);
+		return;
+	}
+	ReliableChannel::Outgoing out{channel.next_seq++, msg, ofGetElapsedTimef(), 0};
+	sendReliableData(ip, channel, out);
+	channel.unacked.push_back(out);
+}
+void ofxSearchNetworkNode::sendReliable(ofxOscMessage msg)
+{
+	for(auto &n : known_nodes_) {
+		sendReliable(n.first, msg);
+	}
+}
+size_t ofxSearchNetworkNode::getNumUnacked(const string &ip) const
+{
+	auto it = reliable_.find(ip);
+	return it == end(reliable_) ? 0 : it->second.unacked.size() + it->second.waiting.size();
+}
+void ofxSearchNetworkNode::sendReliableData(const string &ip, const ReliableChannel &channel, const ReliableChannel::Outgoing &out)
+{
+	ofxOscMessage wrapped;
+	wrapped.setAddress(ofJoinString({"",prefix_,"reliable"},"/"));
+	wrapped.addInt64Arg(channel.epoch);
+	// everything before the oldest unacked one has reached the node, whoever it was
+	wrapped.addInt32Arg(channel.unacked.empty() ? out.seq : channel.unacked.front().seq);
+	wrapped.addInt32Arg(out.seq);
+	wrapped.addStringArg(out.msg.getAddress());
+	copyArgs(out.msg, 0, wrapped);
+	sendMessage(ip, wrapped);
+}
+void ofxSearchNetworkNode::updateReliable()
+{
+	float now = ofGetElapsedTimef();
+	for(auto &r : reliable_) {
+		const string &ip = r.first;
+		auto &channel = r.second;
+		if(channel.ack_pending && now >= channel.ack_at) {
+			ofxOscMessage ack;
+			ack.setAddress(ofJoinString({"",prefix_,"ack"},"/"));
+			addAck(ip, ack);
+			sendMessage(ip, ack);
+		}
+		if(!channel.unacked.empty() && channel.unacked.front().retries >= RELIABLE_MAX_RETRIES) {
+			ofLogWarning("giving up reliable messages to node : " + ip);
+			resetReliable(ip);
+			continue;
+		}
+		// each retry waits twice as long as the one before
+		for(auto &out : channel.unacked) {
+			if(now-out.sent_at >= channel.rto*(1<<min(out.retries, 5))) {
+				sendReliableData(ip, channel, out);
+				out.sent_at = now;
+				++out.retries;
+			}
+		}
+	}
+}
+void ofxSearchNetworkNode::addAck(const string &ip, ofxOscMessage &msg)
+{
+	auto it = reliable_.find(ip);
+	if(it == end(reliable_)) {
+		return;
+	}
+	auto &channel = it->second;
+	if(channel.remote_epoch == 0) {
+		return;
+	}
+	msg.addInt64Arg(channel.remote_epoch);
+	msg.addInt32Arg(channel.delivered);
+	size_t count = 0;
+	for(auto &o : channel.out_of_order) {
+		if(count++ == RELIABLE_MAX_SACK) {
+			break;
+		}
+		msg.addInt32Arg(o.first);
+	}
+	channel.ack_pending = false;
+}
+void ofxSearchNetworkNode::reliableReceived(ofxOscMessage &msg)
+{
+	if(msg.getNumArgs() < 4 || msg.getArgType(0) != OFXOSC_TYPE_INT64 || msg.getArgType(1) != OFXOSC_TYPE_INT32 || msg.getArgType(2) != OFXOSC_TYPE_INT32 || msg.getArgType(3) != OFXOSC_TYPE_STRING) {
+		return;
+	}
+	string ip = msg.getRemoteHost();
+	// not acked, so the sender tries again once it is known
+	if(known_nodes_.find(ip) == end(known_nodes_)) {
+		return;
+	}
+	auto &channel = getReliableChannel(ip);
+	int64_t epoch = msg.getArgAsInt64(0);
+	uint32_t base = msg.getArgAsInt32(1);
+	uint32_t seq = msg.getArgAsInt32(2);
+	// a late retransmit from before the sender reset the channel. acking it would only confuse the sender
+	if(epoch < channel.remote_epoch) {
+		return;
+	}
+	// the sender restarted or reset the channel, or we have never heard from it
+	if(epoch > channel.remote_epoch) {
+		channel.remote_epoch = epoch;
+		channel.delivered = base-1;
+		channel.out_of_order.clear();
+	}
+	if(!channel.ack_pending) {
+		channel.ack_pending = true;
+		channel.ack_at = ofGetElapsedTimef() + ack_delay_;
+	}
+	// already delivered or too far ahead. the ack tells the sender what we have
+	if(seq <= channel.delivered || seq > channel.delivered+RELIABLE_MAX_OUT_OF_ORDER) {
+		return;
+	}
+	ofxOscMessage unwrapped;
+	unwrapped.setAddress(msg.getArgAsString(3));
+	copyArgs(msg, 4, unwrapped);
+	unwrapped.setRemoteEndpoint(ip, msg.getRemotePort());
+	channel.out_of_order.insert(make_pair(seq, unwrapped));
+	// the channel may be gone while notifying, if a listener disconnects the node
+	while(true) {
+		auto it = reliable_.find(ip);
+		if(it == end(reliable_)) {
+			break;
+		}
+		auto &ch = it->second;
+		auto next = ch.out_of_order.find(ch.delivered+1);
+		if(next == end(ch.out_of_order)) {
+			break;
+		}
+		ofxOscMessage deliver = move(next->second);
+		ch.out_of_order.erase(next);
+		++ch.delivered;
+		ofNotifyEvent(unhandledMessageReceived, deliver, this);
+	}
+}
+void ofxSearchNetworkNode::ackReceived(const string &ip, const ofxOscMessage &msg, size_t index)
+{
+	auto it = reliable_.find(ip);
+	if(it == end(reliable_) || index+1 >= msg.getNumArgs() || msg.getArgType(index) != OFXOSC_TYPE_INT64 || msg.getArgType(index+1) != OFXOSC_TYPE_INT32) {
+		return;
+	}
+	auto &channel = it->second;
+	// acks for an epoch we have given up
+	if(msg.getArgAsInt64(index++) != channel.epoch) {
+		return;
+	}
+	float now = ofGetElapsedTimef();
+	uint32_t cumulative = msg.getArgAsInt32(index++);
+	vector<uint32_t> selective;
+	for(; index < msg.getNumArgs(); ++index) {
+		if(msg.getArgType(index) == OFXOSC_TYPE_INT32) {
+			selective.push_back(msg.getArgAsInt32(index));
+		}
+	}
+	uint32_t highest = selective.empty() ? cumulative : *max_element(begin(selective), end(selective));
+	auto &unacked = channel.unacked;
+	auto acked = [&](const ReliableChannel::Outgoing &out) {
+		if(out.seq > cumulative && find(begin(selective), end(selective), out.seq) == end(selective)) {
+			return false;
+		}
+		// Karn's algorithm: a re-sent message says nothing about the round trip
+		if(out.retries == 0) {
+			float rtt = now-out.sent_at;
+			if(channel.srtt < 0) {
+				channel.srtt = rtt;
+				channel.rttvar = rtt/2;
+			}
+			else {
+				channel.rttvar = 0.75f*channel.rttvar + 0.25f*fabs(channel.srtt-rtt);
+				channel.srtt = 0.875f*channel.srtt + 0.125f*rtt;
+			}
+			float granularity = ofGetLastFrameTime();
+			channel.rto = ofClamp(channel.srtt + max(granularity, 4*channel.rttvar) + ack_delay_, RELIABLE_MIN_RTO, RELIABLE_MAX_RTO);
+		}
+		return true;
+	};
+	unacked.erase(remove_if(begin(unacked), end(unacked), acked), end(unacked));
+	// the ones before a selectively acked message were probably lost, no need to wait for the timer
+	for(auto &out : unacked) {
+		if(out.seq < highest && channel.srtt >= 0 && now-out.sent_at >= channel.srtt) {
+			sendReliableData(ip, channel, out);
+			out.sent_at = now;
+			++out.retries;
+		}
+	}
+	while(!channel.waiting.empty() && unacked.size() < RELIABLE_WINDOW) {
+		ReliableChannel::Outgoing out{channel.next_seq++, channel.waiting.front(), now, 0};
+		channel.waiting.pop_front();
+		sendReliableData(ip, channel, out);
+		unacked.push_back(out);
+	}
 }
 
 namespace {
@@ -15,6 +15,10 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include "ofEvents.h"
 #include "ofxOsc.h"
 #include "NetworkUtils.h"
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <thread>
 
 class ofxSearchNetworkNode
 {
@@ -28,12 +32,46 @@ public:
 	const std::string& getName() const { return name_; }
 	const std::vector<std::string>& getGroup() const { return group_; }
 	
+	// these can be called from any thread.
+	// the ones without ip send to the nodes known when the call starts
+	// with batching, messages sent from the main thread are queued per node and
+	// packed into bundles up to the datagram size. the ones from other threads go out at once.
 	void sendMessage(const std::string &ip, ofxOscMessage msg);
 	void sendMessage(ofxOscMessage msg);
 	void sendBundle(const std::string &ip, ofxOscBundle bundle);
 	void sendBundle(ofxOscBundle bundle);
 	
+	// queued messages go out at the end of update, or once the oldest has waited max_delay seconds.
+	// a longer delay packs more messages into a datagram at the cost of latency.
+	void setBatching(bool batching, float max_delay=0);
+	bool isBatching() const { return is_batching_; }
+	// sends the queued messages now
+	void flushSendQueue();
+	struct SendStats {
+		uint64_t messages_sent=0;
+		uint64_t datagrams_sent=0;
+	};
+	// counts what went through sendMessage, sendBundle and sendReliable, including retries and the node's own messages
+	SendStats getSendStats() const;
+	// bytes the message takes in a bundle, with its size prefix
+	static std::size_t getMessageSize(const ofxOscMessage &msg);
+	// "#bundle" and the time tag
+	static const std::size_t BUNDLE_HEADER_SIZE=16;
+	
+	// for messages that must not get lost, such as chat lines and control messages.
+	// they are numbered per node, re-sent until acked and handed to unhandledMessageReceived once each, in the order sent.
+	// acks ride on the heartbeats if one goes out within the ack delay.
+	// messages to a node that is lost, or that stays unacked for too many retries, are dropped along with the ones behind them.
+	// unlike sendMessage these must be called from the main thread.
+	void sendReliable(const std::string &ip, ofxOscMessage msg);
+	void sendReliable(ofxOscMessage msg);
+	// sent to the node and not acked yet, including the ones waiting for room in the window
+	std::size_t getNumUnacked(const std::string &ip) const;
+	// seconds an ack may wait for a heartbeat to carry it
+	void setAckDelay(float seconds) { ack_delay_ = seconds; }
+	
 	void setTargetIp(const std::string &ip) { target_ip_ = ofSplitString(ip,",",true); }
+	const std::vector<std::string>& getTargetIp() const { return target_ip_; }
 	void setAllowLoopback(bool allow) { allow_loopback_ = allow; }
 	void setPrefix(const std::string &prefix) { prefix_ = prefix; }
 	
@@ -72,6 +110,8 @@ public:
 	
 	const std::map<std::string, Node>& getNodes() const { return known_nodes_; }
 	bool isSelfIp(const std::string &ip) const;
+	// the ip of this node in the network of the given one. empty if there's no such interface
+	std::string getSelfIp(const std::string &an_ip_in_same_netwotk) const;
 	std::string getSelfIpForInterface(const std::string &interface_name) const;
 	
 	void setRequestHeartbeat(bool heartbeat, float request_interval=1, float timeout=3) {
@@ -83,6 +123,15 @@ public:
 	void enableSecretMode(const std::string &key);
 	void disableSecretMode() { is_secret_mode_=false; }
 	
+	// largest UDP payload that reaches the peer without IP fragmentation.
+	// uses the path MTU where the OS reports it, otherwise the MTU of the interface in the same network.
+	// setMaxDatagramSize overrides the discovery. pass 0 to go back to automatic.
+	void setMaxDatagramSize(std::size_t size) { max_datagram_size_ = size; }
+	std::size_t getMaxDatagramSize(const std::string &ip) const;
+	
+	// drop outgoing packets at random, for testing transfers under loss
+	void setSimulatedPacketLoss(float rate) { simulated_loss_ = rate; }
+	
 private:
 	void update(ofEventArgs&);
 	void registerNode(const std::string &ip, const std::string &name, const std::vector<std::string> &group, bool heartbeat_required, float heartbeat_interval);
@@ -112,6 +161,9 @@ private:
 	std::string prefix_;
 	
 	std::map<std::string, Node> known_nodes_;
+	// ips of known_nodes_ for senders on other threads. replaced as a whole, never modified
+	std::shared_ptr<const std::vector<std::string>> peers_;
+	void publishPeers();
 	std::vector<NetworkUtils::IPv4Interface> self_ip_;
 	
 	bool need_heartbeat_=true;
@@ -124,7 +176,75 @@ private:
 	std::map<std::string, TimerArgs> heartbeat_send_;
 	std::map<std::string, TimerArgs> heartbeat_recv_;
 	
+	std::size_t max_datagram_size_=0;
+	std::map<std::string, unsigned int> path_mtu_;
+	std::atomic<float> simulated_loss_{0};
+	bool isSimulatedLoss() const;
+	
+	bool is_batching_=false;
+	float batch_delay_=0;
+	std::thread::id main_thread_;
+	struct Batch {
+		ofxOscBundle bundle;
+		std::size_t size;
+		float queued_at;
+	};
+	std::map<std::string, Batch> batches_;
+	bool shouldQueue() const;
+	void queueMessage(const std::string &ip, const ofxOscMessage &msg);
+	void sendBatch(const std::string &ip, Batch &batch);
+	void sendNow(const std::string &ip, const ofxOscMessage &msg);
+	void sendNow(const std::string &ip, const ofxOscBundle &bundle);
+	std::atomic<uint64_t> messages_sent_{0};
+	std::atomic<uint64_t> datagrams_sent_{0};
+	
+	static constexpr float RELIABLE_INITIAL_RTO=0.5f;
+	static constexpr float RELIABLE_MIN_RTO=0.1f;
+	static constexpr float RELIABLE_MAX_RTO=4;
+	// messages in flight per node
+	static const std::size_t RELIABLE_WINDOW=64;
+	// out of order messages kept per node, and the most of them listed in an ack
+	static const std::size_t RELIABLE_MAX_OUT_OF_ORDER=256;
+	static const std::size_t RELIABLE_MAX_SACK=16;
+	// beyond the window, before sendReliable refuses more
+	static const std::size_t RELIABLE_MAX_WAITING=1024;
+	static const int RELIABLE_MAX_RETRIES=16;
+	struct ReliableChannel {
+		// sending side. a newer epoch tells the receiver to start over from the base sent along, an older one is stale
+		int64_t epoch;
+		struct Outgoing {
+			uint32_t seq;
+			ofxOscMessage msg;
+			float sent_at;
+			int retries;
+		};
+		uint32_t next_seq=1;
+		std::deque<Outgoing> unacked;
+		// beyond the window, sent as acks make room
+		std::deque<ofxOscMessage> waiting;
+		// smoothed round trip time and retransmission timeout as in RFC 6298
+		float srtt=-1;
+		float rttvar=0;
+		float rto=RELIABLE_INITIAL_RTO;
+		// receiving side. remote_epoch is 0 until the first message
+		int64_t remote_epoch=0;
+		uint32_t delivered=0;
+		std::map<uint32_t, ofxOscMessage> out_of_order;
+		bool ack_pending=false;
+		float ack_at=0;
+	};
+	std::map<std::string, ReliableChannel> reliable_;
+	float ack_delay_=0.05f;
+	ReliableChannel& getReliableChannel(const std::string &ip);
+	// forgets what is being sent to the node and starts a new epoch
+	void resetReliable(const std::string &ip);
+	void updateReliable();
+	void sendReliableData(const std::string &ip, const ReliableChannel &channel, const ReliableChannel::Outgoing &out);
+	void reliableReceived(ofxOscMessage &msg);
+	void ackReceived(const std::string &ip, const ofxOscMessage &msg, std::size_t index);
+	// epoch, cumulative ack and the ones received beyond it
+	void addAck(const std::string &ip, ofxOscMessage &msg);
+	
 	bool is_secret_mode_=false;
 	std::string secret_key_;
-	std::string getSelfIp(const std::string &an_ip_in_same_netwotk) const;
 };